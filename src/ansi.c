@@ -37,14 +37,18 @@
 #include "screen.h"
 #include "winmsg.h"
 
+#include "charscan.h"
 #include "encoding.h"
 #include "fileio.h"
 #include "help.h"
+#include "histpack.h"
+#include "linepool.h"
 #include "logfile.h"
 #include "mark.h"
 #include "misc.h"
 #include "process.h"
 #include "resize.h"
+#include "vtparse.h"
 
 /* widths for Z0/Z1 switching */
 const int Z0width = 132;
@@ -121,7 +125,8 @@ static void InsertChar(int);
 static void DeleteChar(int);
 static void DeleteLine(int);
 static void InsertLine(int);
-static void Scroll(char *, int, int, char *);
+static void ReverseLines(struct mline *, int);
+static void RotateLines(struct mline *, int, int);
 static void ForwardTab(void);
 static void BackwardTab(void);
 static void ClearScreen(void);
@@ -139,7 +144,7 @@ static void FillWithEs(void);
 static void FindAKA(void);
 static void Report(char *, int, int);
 static void ScrollRegion(int);
-static void WAddLineToHist(Window *, struct mline *);
+static int WAddLinesToHist(Window *, int, int, int);
 static void WLogString(Window *, char *, size_t);
 static void WReverseVideo(Window *, int);
 static void MFixLine(Window *, int, struct mchar *);
@@ -148,8 +153,13 @@ static void MScrollV(Window *, int, int, int, int);
 static void MClearArea(Window *, int, int, int, int, int);
 static void MInsChar(Window *, struct mchar *, int, int);
 static void MPutChar(Window *, struct mchar *, int, int);
+static void MPutDwRight(Window *, struct mchar *, int, int);
+static void MPutStr(Window *, char *, int, struct mchar *, int, int);
+static int PlainRun(char *, size_t);
+static void PutPlain(char *, int);
 static void MWrapChar(Window *, struct mchar *, int, int, int, bool);
 static void MBceLine(Window *, int, int, int, int);
+static void WalkStyles(void (*)(uint32_t *, int));
 
 void ResetAnsiState(Window *win)
 {
@@ -216,7 +226,8 @@ void SetCharsets(Window *win, char *s)
  */
 void WriteString(Window *win, char *buf, size_t len)
 {
-	int c;
+	int c, n, e, state;
+	size_t k;
 	int font;
 	Canvas *cv;
 
@@ -239,128 +250,92 @@ void WriteString(Window *win, char *buf, size_t len)
 
 	if (cols > 0 && rows > 0) {
 		do {
+			if (curr->w_state == LIT && (n = PlainRun(buf, len)) > 0) {
+				PutPlain(buf, n);
+				buf += n;
+				len -= n - 1;	/* the loop condition takes the last one */
+				continue;
+			}
 			c = (unsigned char)*buf++;
 			if (!curr->w_mbcs)
 				curr->w_rend.font = curr->w_FontL;	/* Default: GL */
 
 			if (curr->w_encoding == UTF8) {
-				c = FromUtf8(c, &curr->w_decodestate);
-				if (c == -1)
-					continue;
-				if (c == -2) {
-					c = UCS_REPL;
-					/* try char again */
-					buf--;
-					len++;
+				if (c >= 0xc2 && !curr->w_decodestate
+				    && (n = charscan_utf8(buf - 1, len, &c, 1, &k)) > 1) {
+					/* a whole character at once */
+					buf += n - 1;
+					len -= n - 1;
+				} else {
+					c = FromUtf8(c, &curr->w_decodestate);
+					if (c == -1)
+						continue;
+					if (c == -2) {
+						c = UCS_REPL;
+						/* try char again */
+						buf--;
+						len++;
+					}
 				}
 			}
 
  tryagain:
-			switch (curr->w_state) {
-			case PRIN:
-				switch (c) {
-				case '\033':
-					curr->w_state = PRINESC;
-					break;
-				default:
-					PrintChar(c);
-				}
+			state = curr->w_state;
+			e = vtparse(state, c);
+			curr->w_state = VT_STATE(e);
+			switch (VT_ACTION(e)) {
+			case VTA_NONE:
 				break;
-			case PRINESC:
-				switch (c) {
-				case '[':
-					curr->w_state = PRINCSI;
-					break;
-				default:
-					PrintChar('\033');
-					PrintChar(c);
-					curr->w_state = PRIN;
-				}
+			case VTA_REDO:
+				goto tryagain;
+			case VTA_EXEC:
+				curr->w_mbcs = 0;
+				Special(c);
 				break;
-			case PRINCSI:
-				switch (c) {
-				case '4':
-					curr->w_state = PRIN4;
-					break;
-				default:
-					PrintChar('\033');
-					PrintChar('[');
-					PrintChar(c);
-					curr->w_state = PRIN;
-				}
+			case VTA_ESCAPE:
+				curr->w_mbcs = 0;
+				curr->w_intermediate = 0;
+				if (curr->w_autoaka < 0)
+					curr->w_autoaka = 0;
 				break;
-			case PRIN4:
-				switch (c) {
-				case 'i':
-					curr->w_state = LIT;
-					PrintFlush();
-					if (curr->w_pdisplay && curr->w_pdisplay->d_printfd >= 0) {
-						close(curr->w_pdisplay->d_printfd);
-						curr->w_pdisplay->d_printfd = -1;
-					}
-					curr->w_pdisplay = 0;
-					break;
-				default:
-					PrintChar('\033');
-					PrintChar('[');
-					PrintChar('4');
-					PrintChar(c);
-					curr->w_state = PRIN;
+			case VTA_ESCCOLLECT:
+				if (curr->w_intermediate) {
+					if (curr->w_intermediate == '$')
+						c |= '$' << 8;
+					else
+						c = -1;
 				}
+				curr->w_intermediate = c;
 				break;
-			case ASTR:
-				if (c == 0)
-					break;
-				if (c == '\033') {
-					curr->w_state = STRESC;
-					break;
-				}
-				/* special xterm hack: accept SetStatus sequence. Yucc! */
-				/* allow ^E for title escapes */
-				if (!(curr->w_StringType == OSC && c < ' ' && c != '\005'))
-					if (!curr->w_c1 || c != ('\\' ^ 0xc0)) {
-						StringChar(c);
-						break;
-					}
-				c = '\\';
-				/* FALLTHROUGH */
-			case STRESC:
-				switch (c) {
-				case '\\':
-					if (StringEnd() == 0 || len <= 1)
-						break;
-					/* check if somewhere a status is displayed */
-					for (cv = curr->w_layer.l_cvlist; cv; cv = cv->c_lnext) {
-						display = cv->c_display;
-						if (D_status == STATUS_ON_WIN)
-							break;
-					}
-					if (cv) {
-						if (len > IOSIZE + 1)
-							len = IOSIZE + 1;
-						curr->w_outlen = len - 1;
-						memmove(curr->w_outbuf, buf, len - 1);
-						return;	/* wait till status is gone */
-					}
-					break;
-				case '\033':
-					StringChar('\033');
-					break;
-				default:
-					curr->w_state = ASTR;
-					StringChar('\033');
-					StringChar(c);
-					break;
+			case VTA_ESCDISPATCH:
+				DoESC(c, curr->w_intermediate);
+				break;
+			case VTA_CSIENTRY:
+				curr->w_NumArgs = 0;
+				curr->w_intermediate = 0;
+				memset((char *)curr->w_args, 0, MAXARGS * sizeof(int));
+				break;
+			case VTA_PARAM:
+				if (curr->w_NumArgs >= 0 && curr->w_NumArgs < MAXARGS) {
+					if (curr->w_args[curr->w_NumArgs] < 100000000)
+						curr->w_args[curr->w_NumArgs] =
+						    10 * curr->w_args[curr->w_NumArgs] + (c - '0');
 				}
 				break;
-			case ESC:
+			case VTA_NEXTPARAM:
+				if (curr->w_NumArgs < MAXARGS)
+					curr->w_NumArgs++;
+				break;
+			case VTA_CSICOLLECT:
+				curr->w_intermediate = vtparse_collect(curr->w_intermediate, c);
+				break;
+			case VTA_CSIDISPATCH:
+				if (curr->w_NumArgs < MAXARGS)
+					curr->w_NumArgs++;
+				DoCSI(c, curr->w_intermediate);
+				break;
+			case VTA_STRSTART:
 				switch (c) {
-				case '[':
-					curr->w_NumArgs = 0;
-					curr->w_intermediate = 0;
-					memset((char *)curr->w_args, 0, MAXARGS * sizeof(int));
-					curr->w_state = CSI;
-					break;
 				case ']':
 					StringStart(OSC);
 					break;
@@ -376,88 +351,67 @@ void WriteString(Window *win, char *buf, size_t len)
 				case '!':
 					StringStart(GM);
 					break;
-				case '"':
-				case 'k':
+				default:	/* '"' and 'k' */
 					StringStart(AKA);
 					break;
-				default:
-					if (Special(c)) {
-						curr->w_state = LIT;
-						break;
-					}
-					if (c >= ' ' && c <= '/') {
-						if (curr->w_intermediate) {
-							if (curr->w_intermediate == '$')
-								c |= '$' << 8;
-							else
-								c = -1;
-						}
-						curr->w_intermediate = c;
-					} else if (c >= '0' && c <= '~') {
-						DoESC(c, curr->w_intermediate);
-						curr->w_state = LIT;
-					} else {
-						curr->w_state = LIT;
-						goto tryagain;
-					}
 				}
 				break;
-			case CSI:
-				switch (c) {
-				case '0':
-				case '1':
-				case '2':
-				case '3':
-				case '4':
-				case '5':
-				case '6':
-				case '7':
-				case '8':
-				case '9':
-					if (curr->w_NumArgs >= 0 && curr->w_NumArgs < MAXARGS) {
-						if (curr->w_args[curr->w_NumArgs] < 100000000)
-							curr->w_args[curr->w_NumArgs] =
-							    10 * curr->w_args[curr->w_NumArgs] + (c - '0');
-					}
+			case VTA_STRPUT:
+				StringChar(c);
+				break;
+			case VTA_STRCTL:
+			case VTA_STRST:
+				/* special xterm hack: accept SetStatus sequence. Yucc! */
+				/* allow ^E for title escapes */
+				if (VT_ACTION(e) == VTA_STRCTL ? curr->w_StringType != OSC : !curr->w_c1) {
+					StringChar(c);
 					break;
-				case ';':
-				case ':':
-					if (curr->w_NumArgs < MAXARGS)
-						curr->w_NumArgs++;
+				}
+				/* FALLTHROUGH */
+			case VTA_STREND:
+				if (StringEnd() == 0 || len <= 1)
 					break;
-				default:
-					if (Special(c))
+				/* check if somewhere a status is displayed */
+				for (cv = curr->w_layer.l_cvlist; cv; cv = cv->c_lnext) {
+					display = cv->c_display;
+					if (D_status == STATUS_ON_WIN)
 						break;
-					if (c >= '@' && c <= '~') {
-						if (curr->w_NumArgs < MAXARGS)
-							curr->w_NumArgs++;
-						DoCSI(c, curr->w_intermediate);
-						if (curr->w_state != PRIN)
-							curr->w_state = LIT;
-					} else if ((c >= ' ' && c <= '/') || (c >= '<' && c <= '?'))
-						curr->w_intermediate = curr->w_intermediate ? -1 : c;
-					else {
-						curr->w_state = LIT;
-						goto tryagain;
-					}
+				}
+				if (cv) {
+					if (len > IOSIZE + 1)
+						len = IOSIZE + 1;
+					curr->w_outlen = len - 1;
+					memmove(curr->w_outbuf, buf, len - 1);
+					return;	/* wait till status is gone */
 				}
 				break;
-			case LIT:
-			default:
-				if (curr->w_mbcs)
-					if (c <= ' ' || c == 0x7f || (c >= 0x80 && c < 0xa0 && curr->w_c1))
-						curr->w_mbcs = 0;
-				if (c < ' ') {
-					if (c == '\033') {
-						curr->w_intermediate = 0;
-						curr->w_state = ESC;
-						if (curr->w_autoaka < 0)
-							curr->w_autoaka = 0;
-					} else
-						Special(c);
-					break;
+			case VTA_STRESC:
+				StringChar('\033');
+				if (c != '\033')
+					StringChar(c);
+				break;
+			case VTA_PRINTPUT:
+				PrintChar(c);
+				break;
+			case VTA_PRINTREPLAY:
+				PrintChar('\033');
+				if (state != PRINESC)
+					PrintChar('[');
+				if (state == PRIN4)
+					PrintChar('4');
+				PrintChar(c);
+				break;
+			case VTA_PRINTEND:
+				PrintFlush();
+				if (curr->w_pdisplay && curr->w_pdisplay->d_printfd >= 0) {
+					close(curr->w_pdisplay->d_printfd);
+					curr->w_pdisplay->d_printfd = -1;
 				}
-				if (c >= 0x80 && c < 0xa0 && curr->w_c1)
+				curr->w_pdisplay = 0;
+				break;
+			case VTA_C1:
+				if (curr->w_c1) {
+					curr->w_mbcs = 0;
 					if ((curr->w_FontR & 0xf0) != 0x20 || curr->w_encoding == UTF8) {
 						switch (c) {
 						case 0xc0 ^ 'D':
@@ -484,7 +438,11 @@ void WriteString(Window *win, char *buf, size_t len)
 						}
 						break;
 					}
-
+				}
+				/* FALLTHROUGH */
+			case VTA_PRINT:
+				if (curr->w_mbcs && (c == ' ' || c == 0x7f))
+					curr->w_mbcs = 0;
 				if (!curr->w_mbcs) {
 					if (c < 0x80 || curr->w_gr == 0)
 						curr->w_rend.font = curr->w_FontL;
@@ -532,6 +490,7 @@ void WriteString(Window *win, char *buf, size_t len)
 						utf8_handle_comb(c, &omc);
 						MFixLine(curr, oy, &omc);
 						copy_mchar2mline(&omc, &curr->w_mlines[oy], ox);
+						WinTouchRows(curr, oy, oy);
 						LPutChar(&curr->w_layer, &omc, ox, oy);
 						LGotoPos(&curr->w_layer, curr->w_x, curr->w_y);
 					}
@@ -662,6 +621,41 @@ void WriteString(Window *win, char *buf, size_t len)
 	}
 	if (!printcmd && curr->w_state == PRIN)
 		PrintFlush();
+	if (mstyle_gcdue)
+		mstyle_gc(WalkStyles);
+}
+
+/*
+ * The number of characters at the start of buf that WriteString can put
+ * as one string: printable ASCII in the default charset while nothing
+ * else is pending (a wrap, double width or combining characters, insert
+ * mode or a single shift). The run ends before the last column, which
+ * needs the wrap handling.
+ */
+static int PlainRun(char *buf, size_t len)
+{
+	size_t max;
+
+	if (curr->w_mbcs || curr->w_insert || curr->w_ss || curr->w_FontL != ASCII
+	    || (curr->w_encoding == UTF8 && curr->w_decodestate) || curr->w_x >= cols - 1)
+		return 0;
+	max = cols - 1 - curr->w_x;
+	if (len > max)
+		len = max;
+	return charscan_ascii(buf, len);
+}
+
+/* Put a PlainRun of n characters at the cursor. */
+static void PutPlain(char *buf, int n)
+{
+	curr->w_rend.image = (unsigned char)buf[n - 1];
+	curr->w_rend.font = ASCII;
+	if (curr->w_encoding == UTF8)
+		curr->w_rend.fontx = 0;
+	curr->w_rend.mbcs = 0;
+	MPutStr(curr, buf, n, &curr->w_rend, curr->w_x, curr->w_y);
+	LPutStr(&curr->w_layer, buf, n, &curr->w_rend, curr->w_x, curr->w_y);
+	curr->w_x += n;
 }
 
 static void WLogString(Window *win, char *buf, size_t len)
@@ -985,6 +979,7 @@ static void DoCSI(int c, int intermediate)
 					memmove(curr->w_inbuf + curr->w_inlen + 3, curr->w_title, a1);
 					memmove(curr->w_inbuf + curr->w_inlen + 3 + a1, "\033\\", 2);
 					curr->w_inlen += 5 + a1;
+					evunblock(&curr->w_writeev);
 				}
 				break;
 			case 8:
@@ -1190,9 +1185,35 @@ static void DoCSI(int c, int intermediate)
 				curr->w_bracketed = i ? true : false;
 				LBracketedPasteMode(&curr->w_layer, curr->w_bracketed);
 				break;
+			case 2026:	/* synchronized output */
+				WinSyncUpdate(curr, i);
+				break;
 			}
 		}
 		break;
+	case '?' << 8 | '$':
+		if (c != 'p')
+			break;
+		/* DECRQM: 1 set, 2 reset, 0 not recognized */
+		switch (a1) {
+		case 1000:
+		case 1001:
+		case 1002:
+		case 1003:
+			i = curr->w_mouse == a1 ? 1 : 2;
+			break;
+		case 2004:
+			i = curr->w_bracketed ? 1 : 2;
+			break;
+		case 2026:
+			i = curr->w_sync ? 1 : 2;
+			break;
+		default:
+			i = 0;
+			break;
+		}
+		Report("\033[?%d;%d$y", a1, i);
+		break;
 	case '>':
 		switch (c) {
 		case 'c':	/* secondary DA */
@@ -1311,7 +1332,7 @@ static int StringEnd()
 		}
 		return -1;
 	case DCS:
-		LAY_DISPLAYS(&curr->w_layer, AddStr(curr->w_string));
+		LAY_DISPLAYS(&curr->w_layer, AddStr(curr->w_string); DisplayForget());
 		break;
 	case AKA:
 		if (curr->w_title == curr->w_akabuf && !*curr->w_string)
@@ -1790,6 +1811,7 @@ static void FillWithEs()
 		while (p < ep)
 			*p++ = 'E';
 	}
+	WinTouchRows(curr, 0, rows - 1);
 	LRefreshAll(&curr->w_layer, 1);
 }
 
@@ -1883,11 +1905,13 @@ static void Report(char *fmt, int n1, int n2)
 		if ((unsigned)(curr->w_pwin->p_inlen + len) <= sizeof(curr->w_pwin->p_inbuf)) {
 			memmove(curr->w_pwin->p_inbuf + curr->w_pwin->p_inlen, rbuf, len);
 			curr->w_pwin->p_inlen += len;
+			evunblock(&curr->w_pwin->p_writeev);
 		}
 	} else {
 		if ((unsigned)(curr->w_inlen + len) <= sizeof(curr->w_inbuf)) {
 			memmove(curr->w_inbuf + curr->w_inlen, rbuf, len);
 			curr->w_inlen += len;
+			evunblock(&curr->w_writeev);
 		}
 	}
 }
@@ -1906,40 +1930,18 @@ static void Report(char *fmt, int n1, int n2)
 static void MFixLine(Window *win, int y, struct mchar *mc)
 {
 	struct mline *ml = &win->w_mlines[y];
-	if (mc->attr && ml->attr == null) {
-		if ((ml->attr = calloc(win->w_width + 1, 4)) == 0) {
-			ml->attr = null;
+	if (ml->style == null && mstyle_of(mc)) {
+		if ((ml->style = linepool_alloc(win->w_width + 1)) == 0) {
+			ml->style = null;
+			if (mc->font) {
+				win->w_FontL = win->w_charsets[win->w_ss ? win->w_ss : win->w_Charset] = 0;
+				win->w_FontR = win->w_charsets[win->w_ss ? win->w_ss : win->w_CharsetR] = 0;
+			}
 			mc->attr = win->w_rend.attr = 0;
-			WMsg(win, 0, "Warning: no space for attr - turned off");
-		}
-	}
-	if (mc->font && ml->font == null) {
-		if ((ml->font = calloc(win->w_width + 1, 4)) == 0) {
-			ml->font = null;
-			win->w_FontL = win->w_charsets[win->w_ss ? win->w_ss : win->w_Charset] = 0;
-			win->w_FontR = win->w_charsets[win->w_ss ? win->w_ss : win->w_CharsetR] = 0;
 			mc->font = mc->fontx = win->w_rend.font = 0;
-			WMsg(win, 0, "Warning: no space for font - turned off");
-		}
-	}
-	if (mc->fontx && ml->fontx == null) {
-		if ((ml->fontx = calloc(win->w_width + 1, 4)) == 0) {
-			ml->fontx = null;
-			mc->fontx = 0;
-		}
-	}
-	if (mc->colorbg && ml->colorbg == null) {
-		if ((ml->colorbg = calloc(win->w_width + 1, 4)) == 0) {
-			ml->colorbg = null;
 			mc->colorbg = win->w_rend.colorbg = 0;
-			WMsg(win, 0, "Warning: no space for color background - turned off");
-		}
-	}
-	if (mc->colorfg && ml->colorfg == null) {
-		if ((ml->colorfg = calloc(win->w_width + 1, 4)) == 0) {
-			ml->colorfg = null;
 			mc->colorfg = win->w_rend.colorfg = 0;
-			WMsg(win, 0, "Warning: no space for color foreground - turned off");
+			WMsg(win, 0, "Warning: no space for attributes - turned off");
 		}
 	}
 }
@@ -1967,6 +1969,7 @@ static void MScrollH(Window *win, int n, int y, int xs, int xe, int bce)
 
 	if (n == 0)
 		return;
+	WinTouchRows(win, y, y);
 	ml = &win->w_mlines[y];
 	MKillDwRight(win, ml, xs);
 	MKillDwLeft(win, ml, xe);
@@ -1994,8 +1997,6 @@ static void MScrollH(Window *win, int n, int y, int xs, int xe, int bce)
 
 static void MScrollV(Window *win, int n, int ys, int ye, int bce)
 {
-	int cnt1, cnt2;
-	struct mline tmp[256];
 	struct mline *ml;
 
 	if (n == 0)
@@ -2003,10 +2004,6 @@ static void MScrollV(Window *win, int n, int ys, int ye, int bce)
 	if (n > 0) {
 		if (ye - ys + 1 < n)
 			n = ye - ys + 1;
-		if (n > 256) {
-			MScrollV(win, n - 256, ys, ye, bce);
-			n = 256;
-		}
 		if (compacthist) {
 			ye = MFindUsedLine(win, ye, ys);
 			if (ye - ys + 1 < n)
@@ -2014,86 +2011,50 @@ static void MScrollV(Window *win, int n, int ys, int ye, int bce)
 			if (n <= 0)
 				return;
 		}
-		/* Clear lines */
-		ml = win->w_mlines + ys;
-		for (int i = ys; i < ys + n; i++, ml++) {
-			if (ys == win->w_top)
-				WAddLineToHist(win, ml);
-			if (ml->attr != null)
-				free(ml->attr);
-			ml->attr = null;
-			if (ml->font != null)
-				free(ml->font);
-			ml->font = null;
-			if (ml->fontx != null)
-				free(ml->fontx);
-			ml->fontx = null;
-			if (ml->colorbg != null)
-				free(ml->colorbg);
-			ml->colorbg = null;
-			if (ml->colorfg != null)
-				free(ml->colorfg);
-			ml->colorfg = null;
-			memmove(ml->image, blank, (win->w_width + 1) * 4);
-			if (bce)
-				MBceLine(win, i, 0, win->w_width, bce);
-		}
-		/* switch 'em over */
-		cnt1 = n * sizeof(struct mline);
-		cnt2 = (ye - ys + 1 - n) * sizeof(struct mline);
-		if (cnt1 && cnt2)
-			Scroll((char *)(win->w_mlines + ys), cnt1, cnt2, (char *)tmp);
+		/* switch 'em over, without memory for the history the lines are lost */
+		if (ys != win->w_top || WAddLinesToHist(win, n, ys, ye))
+			RotateLines(win->w_mlines + ys, ye - ys + 1, n);
+		WinScrollRows(win, ys, ye, n);
+		ys = ye - n + 1;
 	} else {
 		n = -n;
 		if (ye - ys + 1 < n)
 			n = ye - ys + 1;
-		if (n > 256) {
-			MScrollV(win, - (n - 256), ys, ye, bce);
-			n = 256;
-		}
+		RotateLines(win->w_mlines + ys, ye - ys + 1, ye - ys + 1 - n);
+		WinScrollRows(win, ys, ye, -n);
+		ye = ys + n - 1;
+	}
+	/* Clear lines */
+	ml = win->w_mlines + ys;
+	for (int i = ys; i <= ye; i++, ml++) {
+		if (ml->style != null)
+			linepool_free(ml->style);
+		ml->style = null;
+		memmove(ml->image, blank, (win->w_width + 1) * 4);
+		if (bce)
+			MBceLine(win, i, 0, win->w_width, bce);
+	}
+}
 
-		ml = win->w_mlines + ye;
-		/* Clear lines */
-		for (int i = ye; i > ye - n; i--, ml--) {
-			if (ml->attr != null)
-				free(ml->attr);
-			ml->attr = null;
-			if (ml->font != null)
-				free(ml->font);
-			ml->font = null;
-			if (ml->fontx != null)
-				free(ml->fontx);
-			ml->fontx = null;
-			if (ml->colorbg != null)
-				free(ml->colorbg);
-			ml->colorbg = null;
-			if (ml->colorfg != null)
-				free(ml->colorfg);
-			ml->colorfg = null;
-			memmove(ml->image, blank, (win->w_width + 1) * 4);
-			if (bce)
-				MBceLine(win, i, 0, win->w_width, bce);
-		}
-		cnt1 = n * sizeof(struct mline);
-		cnt2 = (ye - ys + 1 - n) * sizeof(struct mline);
-		if (cnt1 && cnt2)
-			Scroll((char *)(win->w_mlines + ys), cnt2, cnt1, (char *)tmp);
+static void ReverseLines(struct mline *ml, int n)
+{
+	struct mline t;
+
+	for (struct mline *e = ml + n - 1; ml < e; ml++, e--) {
+		t = *ml;
+		*ml = *e;
+		*e = t;
 	}
 }
 
-static void Scroll(char *cp, int cnt1, int cnt2, char *tmp)
+/* Move the first n of the len lines at ml to the end. */
+static void RotateLines(struct mline *ml, int len, int n)
 {
-	if (!cnt1 || !cnt2)
+	if (n <= 0 || n >= len)
 		return;
-	if (cnt1 <= cnt2) {
-		memmove(tmp, cp, cnt1);
-		memmove(cp, cp + cnt1, cnt2);
-		memmove(cp + cnt2, tmp, cnt1);
-	} else {
-		memmove(tmp, cp + cnt1, cnt2);
-		memmove(cp + cnt2, cp, cnt1);
-		memmove(cp, tmp, cnt2);
-	}
+	ReverseLines(ml, n);
+	ReverseLines(ml + n, len - n);
+	ReverseLines(ml, len);
 }
 
 static void MClearArea(Window *win, int xs, int ys, int xe, int ye, int bce)
@@ -2112,6 +2073,7 @@ static void MClearArea(Window *win, int xs, int ys, int xe, int ye, int bce)
 	if (xe >= win->w_width)
 		xe = win->w_width - 1;
 
+	WinTouchRows(win, ys, ye);
 	MKillDwRight(win, win->w_mlines + ys, xs);
 	MKillDwLeft(win, win->w_mlines + ye, xe);
 
@@ -2133,6 +2095,7 @@ static void MInsChar(Window *win, struct mchar *c, int x, int y)
 	struct mline *ml;
 
 	MFixLine(win, y, c);
+	WinTouchRows(win, y, y);
 	ml = win->w_mlines + y;
 	n = win->w_width - x - 1;
 	MKillDwRight(win, ml, x);
@@ -2146,14 +2109,7 @@ static void MInsChar(Window *win, struct mchar *c, int x, int y)
 			MKillDwRight(win, ml, win->w_width - 1);
 			copy_mline(ml, x + 1, x + 2, n);
 		}
-		copy_mchar2mline(c, ml, x + 1);
-		ml->image[x + 1] = c->mbcs;
-		if (win->w_encoding != UTF8)
-			ml->font[x + 1] |= 0x80;
-		else if (win->w_encoding == UTF8 && c->mbcs) {
-			ml->font[x + 1] = c->mbcs;
-			ml->fontx[x + 1] = 0;
-		}
+		MPutDwRight(win, c, x + 1, y);
 	}
 }
 
@@ -2162,20 +2118,51 @@ static void MPutChar(Window *win, struct mchar *c, int x, int y)
 	struct mline *ml;
 
 	MFixLine(win, y, c);
+	WinTouchRows(win, y, y);
 	ml = &win->w_mlines[y];
 	MKillDwRight(win, ml, x);
 	MKillDwLeft(win, ml, x);
 	copy_mchar2mline(c, ml, x);
 	if (c->mbcs) {
 		MKillDwLeft(win, ml, x + 1);
-		copy_mchar2mline(c, ml, x + 1);
-		ml->image[x + 1] = c->mbcs;
-		if (win->w_encoding != UTF8)
-			ml->font[x + 1] |= 0x80;
-		else if (win->w_encoding == UTF8 && c->mbcs) {
-			ml->font[x + 1] = c->mbcs;
-			ml->fontx[x + 1] = 0;
-		}
+		MPutDwRight(win, c, x + 1, y);
+	}
+}
+
+/* Put the second half of the double width character c at x, y. */
+static void MPutDwRight(Window *win, struct mchar *c, int x, int y)
+{
+	struct mchar mc = *c;
+
+	mc.image = c->mbcs;
+	if (win->w_encoding != UTF8)
+		mc.font |= 0x80;
+	else {
+		mc.font = c->mbcs;
+		mc.fontx = 0;
+	}
+	MFixLine(win, y, &mc);
+	WinTouchRows(win, y, y);
+	copy_mchar2mline(&mc, &win->w_mlines[y], x);
+}
+
+/* Like n calls of MPutChar, for single width characters with rendition r. */
+static void MPutStr(Window *win, char *s, int n, struct mchar *r, int x, int y)
+{
+	struct mline *ml;
+
+	MFixLine(win, y, r);
+	WinTouchRows(win, y, y);
+	ml = &win->w_mlines[y];
+	MKillDwRight(win, ml, x);
+	MKillDwLeft(win, ml, x + n - 1);
+	for (int i = 0; i < n; i++)
+		ml->image[x + i] = (unsigned char)s[i];
+	if (ml->style != null) {
+		uint32_t st = mstyle_of(r);
+
+		for (int i = 0; i < n; i++)
+			ml->style[x + i] = st;
 	}
 }
 
@@ -2186,6 +2173,7 @@ static void MWrapChar(Window *win, struct mchar *c, int y, int top, int bot, boo
 
 	bce = c->colorbg;
 	MFixLine(win, y, c);
+	WinTouchRows(win, y, y);
 	ml = &win->w_mlines[y];
 	copy_mchar2mline(&mchar_null, ml, win->w_width);
 	if (y == bot)
@@ -2206,63 +2194,116 @@ static void MBceLine(Window *win, int y, int xs, int xe, int bce)
 	mc = mchar_null;
 	mc.colorbg = bce;
 	MFixLine(win, y, &mc);
+	WinTouchRows(win, y, y);
 	ml = win->w_mlines + y;
-	if (mc.attr)
-		for (int x = xs; x <= xe; x++)
-			ml->attr[x] = mc.attr;
-	if (mc.colorbg)
-		for (int x = xs; x <= xe; x++)
-			ml->colorbg[x] = mc.colorbg;
-	if (mc.colorfg)
+	if (ml->style != null) {
+		uint32_t st = mstyle_of(&mc);
+
 		for (int x = xs; x <= xe; x++)
-			ml->colorfg[x] = mc.colorfg;
+			ml->style[x] = st;
+	}
 }
 
-static void WAddLineToHist(Window *win, struct mline *ml)
+/*
+ * Make sure win has rows for at least n lines, growing them geometrically
+ * so that a history filling up line by line is copied only a few times.
+ */
+static int WGrowRows(Window *win, int n)
 {
-	uint32_t *q, *o;
-	struct mline *hml;
+	struct mline *rows;
+	int len = win->w_histheight - win->w_histcold + win->w_height;
+	int nrows = 2 * win->w_nrows;
 
-	if (win->w_histheight == 0)
-		return;
-	hml = &win->w_hlines[win->w_histidx];
-	q = ml->image;
-	ml->image = hml->image;
-	hml->image = q;
-
-	q = ml->attr;
-	o = hml->attr;
-	hml->attr = q;
-	ml->attr = null;
-	if (o != null)
-		free(o);
-	q = ml->font;
-	o = hml->font;
-	hml->font = q;
-	ml->font = null;
-	if (o != null)
-		free(o);
-	q = ml->fontx;
-	o = hml->fontx;
-	hml->fontx = q;
-	ml->fontx = null;
-	if (o != null)
-		free(o);
-	q = ml->colorbg;
-	o = hml->colorbg;
-	hml->colorbg = q;
-	ml->colorbg = null;
-	if (o != null)
-		free(o);
-	q = ml->colorfg;
-	o = hml->colorfg;
-	hml->colorfg = q;
-	ml->colorfg = null;
-	if (o != null)
-		free(o);
-
-	if (++win->w_histidx >= win->w_histheight)
-		win->w_histidx = 0;
+	if (n <= win->w_nrows)
+		return 0;
+	if (nrows < n)
+		nrows = n;
+	if ((rows = calloc(nrows, sizeof(struct mline))) == NULL)
+		return -1;
+	memmove(rows, win->w_hlines, len * sizeof(struct mline));
+	free(win->w_rows);
+	win->w_rows = rows;
+	win->w_nrows = nrows;
+	win->w_mlines = rows + (win->w_mlines - win->w_hlines);
+	win->w_hlines = rows;
+	return 0;
+}
+
+/*
+ * Move the n lines from ys on into the history and the lines below them
+ * up to ye up. Rather than moving the lines, the rows slide along by n:
+ * the rows of the n oldest lines come back as the last n lines of the
+ * region, for the caller to clear. Returns -1 if there is no memory for
+ * it, without having changed anything.
+ */
+static int WAddLinesToHist(Window *win, int n, int ys, int ye)
+{
+	struct mline *rows, *spare;
+	int hot = win->w_histheight - win->w_histcold;
+	int maxhot = win->w_histheight < HOTHISTHEIGHT ? win->w_histheight : HOTHISTHEIGHT;
+	int len = hot + win->w_height;
+	int grow = maxhot - hot < n ? maxhot - hot : n;
+	int i;
+
+	/* until the history is filled, it takes new lines instead of moving on */
+	if (grow && WGrowRows(win, len + grow + win->w_height))
+		grow = 0;
+	rows = win->w_hlines;
+	if (rows + len + n > win->w_rows + win->w_nrows) {
+		memmove(win->w_rows, rows, len * sizeof(struct mline));
+		rows = win->w_hlines = win->w_rows;
+		win->w_mlines = rows + hot;
+	}
+	for (i = 0; i < grow; i++) {
+		if ((rows[len + i].image = linepool_alloc(win->w_width + 1)) == NULL)
+			break;
+		rows[len + i].style = null;
+	}
+	grow = i;
+	/*
+	 * Otherwise the oldest rows are reused. Those still at the width
+	 * of an earlier size get new images, set aside in the spare rows
+	 * they are going to be moved to.
+	 */
+	spare = rows + len + grow;
+	for (i = 0; i < n - grow; i++) {
+		spare[i].image = NULL;
+		if (i < hot && linepool_len(rows[i].image) != win->w_width + 1
+		    && (spare[i].image = linepool_alloc(win->w_width + 1)) == NULL)
+			break;
+	}
+	if (i < n - grow) {
+		while (i-- > 0)
+			linepool_free(spare[i].image);
+		for (i = 0; i < grow; i++)
+			linepool_free(rows[len + i].image);
+		return -1;
+	}
+
+	RotateLines(win->w_mlines, ys + n, ys);
+	n -= grow;
+	if (n && win->w_histheight > maxhot) {
+		/* a line that cannot be packed is lost like one beyond the history */
+		for (i = 0; i < n; i++)
+			histpack_push(&win->w_cold, &rows[i], linepool_len(rows[i].image) - 1);
+		if (win->w_cold.lines > win->w_histheight - maxhot)
+			histpack_drop(&win->w_cold, win->w_cold.lines - (win->w_histheight - maxhot));
+	}
+	for (i = 0; i < n; i++)
+		if (spare[i].image) {
+			linepool_free(rows[i].image);
+			if (rows[i].style != null)
+				linepool_free(rows[i].style);
+			rows[i].image = spare[i].image;
+			rows[i].style = null;
+		}
+	memmove(rows + len + grow, rows, n * sizeof(struct mline));
+	win->w_hlines = rows + n;
+	win->w_mlines = win->w_hlines + hot + grow;
+	win->w_histcold -= grow;
+	n += grow;
+	RotateLines(win->w_mlines + ye - n + 1, win->w_height - ye - 1 + n, win->w_height - ye - 1);
+	return 0;
 }
 
 int MFindUsedLine(Window *win, int ye, int ys)
@@ -2273,22 +2314,41 @@ int MFindUsedLine(Window *win, int ye, int ys)
 	for (y = ye; y >= ys; y--, ml--) {
 		if (memcmp(ml->image, blank, win->w_width * 4))
 			break;
-		if (ml->attr != null && memcmp(ml->attr, null, win->w_width * 4))
+		if (ml->style != null && memcmp(ml->style, null, win->w_width * 4))
 			break;
-		if (ml->colorbg != null && memcmp(ml->colorbg, null, win->w_width * 4))
-			break;
-		if (ml->colorfg != null && memcmp(ml->colorfg, null, win->w_width * 4))
-			break;
-		if (win->w_encoding == UTF8) {
-			if (ml->font != null && memcmp(ml->font, null, win->w_width))
-				break;
-			if (ml->fontx != null && memcmp(ml->fontx, null, win->w_width))
-				break;
-		}
 	}
 	return y;
 }
 
+static void WalkLines(struct mline *ml, int n, int width, void (*fn)(uint32_t *, int))
+{
+	for (int y = 0; y < n; y++, ml++)
+		if (ml->style && ml->style != null)
+			fn(ml->style, width);
+}
+
+/* Like WalkLines for window rows, which need not all be of one width. */
+static void WalkRows(struct mline *ml, int n, void (*fn)(uint32_t *, int))
+{
+	for (int y = 0; y < n; y++, ml++)
+		if (ml->style && ml->style != null)
+			fn(ml->style, linepool_len(ml->style));
+}
+
+/* Call fn on every style array of the windows and displays. */
+static void WalkStyles(void (*fn)(uint32_t *, int))
+{
+	for (Window *p = windows; p; p = p->w_next) {
+		WalkRows(p->w_mlines, p->w_height, fn);
+		WalkRows(p->w_hlines, p->w_histheight - p->w_histcold, fn);
+		WalkRows(p->w_alt.mlines, p->w_alt.height, fn);
+		WalkRows(p->w_alt.hlines, p->w_alt.histheight - p->w_alt.histcold, fn);
+	}
+	histpack_walk(fn);
+	for (Display *d = displays; d; d = d->d_next)
+		WalkLines(d->d_shadow.lines, d->d_shadow.height, d->d_shadow.width, fn);
+}
+
 /*
  *====================================================================*
  *====================================================================*
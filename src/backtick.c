@@ -156,7 +156,7 @@ void setbacktick(int num, int lifespan, int tick, char **cmdv)
 char *runbacktick(Backtick *bt, int *tickp, time_t now)
 {
 	int f, i, l, j;
-	time_t now2;
+	struct timeval now2;
 
 	if (bt->tick && (!*tickp || bt->tick < *tickp))
 		*tickp = bt->tick;
@@ -187,8 +187,8 @@ char *runbacktick(Backtick *bt, int *tickp, time_t now)
 		i--;
 	bt->result[i] = 0;
 	backtick_filter(bt);
-	(void)time(&now2);
-	bt->bestbefore = now2 + bt->lifespan;
+	GetTime(&now2);
+	bt->bestbefore = now2.tv_sec + bt->lifespan;
 	return bt->result;
 }
 
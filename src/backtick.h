@@ -42,7 +42,7 @@ typedef struct backtick {
 	int num;
 	int tick;
 	int lifespan;
-	time_t bestbefore;
+	time_t bestbefore;	/* in GetTime() seconds */
 	char result[MAXSTR];  /* TODO: not re-entrant */
 	char **cmdv;
 	Event ev;
@@ -0,0 +1,141 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include "config.h"
+
+#include "charscan.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * Scanners for runs of input that need no per-character processing.
+ * They look at 16 bytes at a time where SSE2 is available.
+ */
+
+/* Length of the printable ASCII (0x20-0x7e) prefix of s[0..n). */
+size_t charscan_ascii(const char *s, size_t n)
+{
+	size_t i = 0;
+
+#ifdef __SSE2__
+	const __m128i lo = _mm_set1_epi8(0x1f);
+	const __m128i hi = _mm_set1_epi8(0x7f);
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+		/* signed compares, so bytes >= 0x80 fail the first one */
+		__m128i ok = _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi));
+		unsigned int mask = _mm_movemask_epi8(ok);
+
+		if (mask != 0xffff)
+			return i + __builtin_ctz(~mask);
+	}
+#endif
+	while (i < n && s[i] >= 0x20 && s[i] < 0x7f)
+		i++;
+	return i;
+}
+
+/*
+ * Decode the UTF-8 at the start of s[0..n) into at most max code points
+ * in out, the count going to *nout. Only characters that FromUtf8 would
+ * decode as they are get decoded: the scan stops before an invalid,
+ * overlong or unfinished sequence, before surrogates, U+FFFE and U+FFFF,
+ * and before 5 and 6 byte forms, so the caller can hand those to the
+ * state machine. Returns the number of bytes used.
+ */
+size_t charscan_utf8(const char *s, size_t n, int *out, size_t max, size_t *nout)
+{
+	const unsigned char *p = (const unsigned char *)s;
+	size_t i = 0, k = 0;
+	int c;
+
+	for (;;) {
+#if defined(__AVX2__)
+		/* runs of ASCII go 32 bytes at a time */
+		while (i + 32 <= n && k + 32 <= max) {
+			__m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+
+			if (_mm256_movemask_epi8(v))
+				break;
+			for (int j = 0; j < 32; j += 8)
+				_mm256_storeu_si256((__m256i *)(out + k + j),
+						    _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(p + i + j))));
+			i += 32;
+			k += 32;
+		}
+#elif defined(__SSE2__)
+		/* runs of ASCII go 16 bytes at a time */
+		while (i + 16 <= n && k + 16 <= max) {
+			const __m128i zero = _mm_setzero_si128();
+			__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+			__m128i lo, hi;
+
+			if (_mm_movemask_epi8(v))
+				break;
+			lo = _mm_unpacklo_epi8(v, zero);
+			hi = _mm_unpackhi_epi8(v, zero);
+			_mm_storeu_si128((__m128i *)(out + k), _mm_unpacklo_epi16(lo, zero));
+			_mm_storeu_si128((__m128i *)(out + k + 4), _mm_unpackhi_epi16(lo, zero));
+			_mm_storeu_si128((__m128i *)(out + k + 8), _mm_unpacklo_epi16(hi, zero));
+			_mm_storeu_si128((__m128i *)(out + k + 12), _mm_unpackhi_epi16(hi, zero));
+			i += 16;
+			k += 16;
+		}
+#endif
+		if (i >= n || k >= max)
+			break;
+		c = p[i];
+		if (c < 0x80) {
+			out[k++] = c;
+			i++;
+			continue;
+		}
+		if (c < 0xc2 || c > 0xf7)
+			break;
+		if (c < 0xe0) {
+			if (i + 2 > n || (p[i + 1] & 0xc0) != 0x80)
+				break;
+			c = (c & 0x1f) << 6 | (p[i + 1] & 0x3f);
+			i += 2;
+		} else if (c < 0xf0) {
+			if (i + 3 > n || (p[i + 1] & 0xc0) != 0x80 || (p[i + 2] & 0xc0) != 0x80)
+				break;
+			c = (c & 0x0f) << 12 | (p[i + 1] & 0x3f) << 6 | (p[i + 2] & 0x3f);
+			if (c < 0x800 || (c >= 0xd800 && c <= 0xdfff) || c >= 0xfffe)
+				break;
+			i += 3;
+		} else {
+			if (i + 4 > n || (p[i + 1] & 0xc0) != 0x80 || (p[i + 2] & 0xc0) != 0x80
+			    || (p[i + 3] & 0xc0) != 0x80)
+				break;
+			c = (c & 0x07) << 18 | (p[i + 1] & 0x3f) << 12 | (p[i + 2] & 0x3f) << 6 | (p[i + 3] & 0x3f);
+			if (c < 0x10000)
+				break;
+			i += 4;
+		}
+		out[k++] = c;
+	}
+	*nout = k;
+	return i;
+}
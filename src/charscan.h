@@ -0,0 +1,28 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#ifndef SCREEN_CHARSCAN_H
+#define SCREEN_CHARSCAN_H
+
+#include <stddef.h>
+
+size_t charscan_ascii(const char *, size_t);
+size_t charscan_utf8(const char *, size_t, int *, size_t, size_t *);
+
+#endif /* SCREEN_CHARSCAN_H */
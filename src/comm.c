@@ -82,6 +82,7 @@ struct comm comms[RC_LAST + 1] =
   { "defencoding",	ARGS_1,				{NULL} },
   { "defescape",	ARGS_1,				{NULL} },
   { "defflow",		ARGS_12,			{NULL} },
+  { "defframedrop",	ARGS_1,				{NULL} },
   { "defgr",		ARGS_1,				{NULL} },
   { "defhstatus",	ARGS_01,			{NULL} },
   { "defkanji",		ARGS_1,				{NULL} },
@@ -89,6 +90,7 @@ struct comm comms[RC_LAST + 1] =
 #if defined(ENABLE_UTMP)
   { "deflogin",		ARGS_1,				{NULL} },
 #endif
+  { "defmaxfps",	ARGS_1,				{NULL} },
   { "defmode",		ARGS_1,				{NULL} },
   { "defmonitor",	ARGS_1,				{NULL} },
   { "defmousetrack",	ARGS_1,				{NULL} },
@@ -115,6 +117,7 @@ struct comm comms[RC_LAST + 1] =
   { "flow",		NEED_FORE|ARGS_01,		{NULL} },
   { "focus",		NEED_DISPLAY|ARGS_01,		{NULL} },
   { "focusminsize",	ARGS_02,			{NULL} },
+  { "framedrop",	NEED_DISPLAY|ARGS_1,		{NULL} },
   { "gr",		NEED_FORE|ARGS_01,		{NULL} },
   { "group",            NEED_FORE|ARGS_01,		{NULL} },
   { "hardcopy",		NEED_FORE|ARGS_012,		{NULL} },
@@ -124,6 +127,8 @@ struct comm comms[RC_LAST + 1] =
   { "height",		ARGS_0123,			{NULL} },
   { "help",		NEED_LAYER|ARGS_02,		{NULL} },
   { "history",		NEED_DISPLAY|NEED_FORE|ARGS_0,	{NULL} },
+  { "histspill",	ARGS_1,				{NULL} },
+  { "histsync",		ARGS_1,				{NULL} },
   { "hstatus",		NEED_FORE|ARGS_1,		{NULL} },
   { "idle",		ARGS_0|ARGS_ORMORE,		{NULL} },
   { "ignorecase",	ARGS_01,			{NULL} },
@@ -144,6 +149,7 @@ struct comm comms[RC_LAST + 1] =
   { "mapnotnext",	NEED_DISPLAY|ARGS_0,		{NULL} },
   { "maptimeout",	ARGS_01,			{NULL} },
   { "markkeys",		ARGS_1,				{NULL} },
+  { "maxfps",		NEED_DISPLAY|ARGS_01,		{NULL} },
   { "maxwin",		ARGS_01,			{NULL} },
   { "meta",		NEED_LAYER|ARGS_0,		{NULL} },
   { "monitor",		NEED_FORE|ARGS_01,		{NULL} },
@@ -0,0 +1,136 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include "config.h"
+
+#include "damage.h"
+
+#include <stdlib.h>
+
+/* Make room for lines up to y. */
+static int grow(Damage *dmg, int y)
+{
+	int o = dmg->lines;
+	int n = y + 32;
+	int *l, *r;
+
+	if (o > y)
+		return 0;
+	if (!(l = realloc(dmg->left, sizeof(int) * n)))
+		return -1;
+	dmg->left = l;
+	if (!(r = realloc(dmg->right, sizeof(int) * n)))
+		return -1;
+	dmg->right = r;
+	dmg->lines = n;
+	while (o < n) {
+		dmg->left[o] = dmg->right[o] = -1;
+		o++;
+	}
+	return 0;
+}
+
+/*
+ * Mark columns xs..xe of lines ys..ye as damaged. The caller clips the
+ * region. Returns -1 if no memory is available, nothing is recorded
+ * then.
+ */
+int damage_add(Damage *dmg, int xs, int xe, int ys, int ye)
+{
+	if (ys < 0)
+		ys = 0;
+	if (ys > ye || xs > xe)
+		return 0;
+	if (grow(dmg, ye))
+		return -1;
+	if (dmg->top == -1 || dmg->top > ys)
+		dmg->top = ys;
+	if (dmg->bottom < ye)
+		dmg->bottom = ye;
+	while (ys <= ye) {
+		if (dmg->left[ys] == -1 || dmg->left[ys] > xs)
+			dmg->left[ys] = xs;
+		if (dmg->right[ys] < xe)
+			dmg->right[ys] = xe;
+		ys++;
+	}
+	return 0;
+}
+
+/*
+ * Move the damage of lines ys..ye along with their content when they
+ * scroll up by n lines, or down for negative n. Lines scrolled in are
+ * clean, what leaves the region is dropped. Returns -1 if no memory
+ * is available, the damage is unchanged then.
+ */
+int damage_scroll(Damage *dmg, int ys, int ye, int n)
+{
+	int top = dmg->top, bottom = dmg->bottom;
+
+	if (ys < 0)
+		ys = 0;
+	if (top == -1 || n == 0 || ys > ye)
+		return 0;
+	if (grow(dmg, ye))
+		return -1;
+	for (int i = 0; i <= ye - ys; i++) {
+		int y = n > 0 ? ys + i : ye - i;
+
+		if (y + n >= ys && y + n <= ye) {
+			dmg->left[y] = dmg->left[y + n];
+			dmg->right[y] = dmg->right[y + n];
+		} else
+			dmg->left[y] = dmg->right[y] = -1;
+	}
+	/* damage is still within the old bounds or the scrolled lines */
+	if (ys < top)
+		top = ys;
+	if (ye > bottom)
+		bottom = ye;
+	dmg->top = dmg->bottom = -1;
+	for (int y = top; y <= bottom; y++)
+		if (dmg->left[y] != -1) {
+			if (dmg->top == -1)
+				dmg->top = y;
+			dmg->bottom = y;
+		}
+	return 0;
+}
+
+bool damage_empty(const Damage *dmg)
+{
+	return dmg->top == -1;
+}
+
+/* Forget all damage, the line arrays are kept for reuse. */
+void damage_clear(Damage *dmg)
+{
+	for (int y = dmg->top; y >= 0 && y <= dmg->bottom && y < dmg->lines; y++)
+		dmg->left[y] = dmg->right[y] = -1;
+	dmg->top = dmg->bottom = -1;
+}
+
+void damage_free(Damage *dmg)
+{
+	free(dmg->left);
+	free(dmg->right);
+	dmg->left = dmg->right = 0;
+	dmg->lines = 0;
+	dmg->top = dmg->bottom = -1;
+}
@@ -0,0 +1,42 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#ifndef SCREEN_DAMAGE_H
+#define SCREEN_DAMAGE_H
+
+#include <stdbool.h>
+
+/*
+ * Lines that need to be redrawn, each with the leftmost and rightmost
+ * column touched. Clean lines have left == right == -1, top and bottom
+ * are -1 if nothing is damaged at all.
+ */
+typedef struct Damage {
+	int *left, *right;
+	int top, bottom;
+	int lines;		/* allocated entries in left and right */
+} Damage;
+
+int  damage_add(Damage *, int, int, int, int);
+int  damage_scroll(Damage *, int, int, int);
+bool damage_empty(const Damage *);
+void damage_clear(Damage *);
+void damage_free(Damage *);
+
+#endif /* SCREEN_DAMAGE_H */
@@ -34,6 +34,7 @@
 #include <signal.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <poll.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -41,6 +42,7 @@
 #include "winmsg.h"
 
 #include "canvas.h"
+#include "charscan.h"
 #include "encoding.h"
 #include "mark.h"
 #include "misc.h"
@@ -60,13 +62,32 @@ static void disp_status_fn(Event *, void *);
 static void disp_hstatus_fn(Event *, void *);
 static void disp_blocked_fn(Event *, void *);
 static void disp_map_fn(Event *, void *);
+static void disp_frame_fn(Event *, void *);
+static bool DisplaySynced(void);
+static void SyncOutput(bool);
 static void disp_idle_fn(Event *, void *);
 static void disp_blanker_fn(Event *, void *);
 static void WriteLP(int, int);
+static bool ScrollLR(int, int, int, int, int, int);
+static void QueryMode(int);
 static void INSERTCHAR(int);
 static void RAW_PUTCHAR(int);
+static void AddBuf(char *, int);
 static void SetBackColor(int);
+static Shadow *GetShadow(void);
+static struct mchar *ShadowBlank(struct mchar *);
+static bool ShadowKnown(int, int);
+static bool ShadowAnyKnown(int, int);
+static bool ShadowBlankLine(int, int, int, int);
+static void ShadowForget(int, int);
+static void ShadowErase(int, int, int);
+static void ShadowScroll(int, int, int);
+static void ShadowScrollCols(int, int, int, int, int);
+static void ShadowPutc(int, bool);
 static void RemoveStatusMinWait(void);
+static void WaitDone(void);
+static void WakeWaitingWindows(void);
+static void FlushPending(bool);
 
 Display *display, *displays;
 
@@ -74,9 +95,11 @@ Display *display, *displays;
  *  The default values
  */
 bool defautonuke = false;
+bool defframedrop = false;
 
 int defobuflimit = OBUF_MAX;
 int defnonblock = -1;
+int defmaxfps = 0;
 int defmousetrack = 0;
 int defbracketed = 0;
 int defcursorstyle = 0;
@@ -170,6 +193,7 @@ Display *MakeDisplay(char *uname, char *utty, char *term, int fd, pid_t pid, str
 	displays = display;
 	D_flow = 1;
 	D_nonblock = defnonblock;
+	D_framedrop = defframedrop;
 	D_userfd = fd;
 	D_readev.fd = D_writeev.fd = fd;
 	D_readev.type = EV_READ;
@@ -178,9 +202,7 @@ Display *MakeDisplay(char *uname, char *utty, char *term, int fd, pid_t pid, str
 	D_readev.handler = disp_readev_fn;
 	D_writeev.handler = disp_writeev_fn;
 	evenq(&D_readev);
-	D_writeev.condpos = &D_obuflen;
-	D_writeev.condneg = &D_obuffree;
-	evenq(&D_writeev);
+	evenq(&D_writeev);	/* blocks itself once everything is written */
 	D_statusev.type = EV_TIMEOUT;
 	D_statusev.data = (char *)display;
 	D_statusev.handler = disp_status_fn;
@@ -190,11 +212,14 @@ Display *MakeDisplay(char *uname, char *utty, char *term, int fd, pid_t pid, str
 	D_blockedev.type = EV_TIMEOUT;
 	D_blockedev.data = (char *)display;
 	D_blockedev.handler = disp_blocked_fn;
-	D_blockedev.condpos = &D_obuffree;
-	D_blockedev.condneg = &D_obuflenmax;
 	D_mapev.type = EV_TIMEOUT;
 	D_mapev.data = (char *)display;
 	D_mapev.handler = disp_map_fn;
+	D_frameev.type = EV_TIMEOUT;
+	D_frameev.data = (char *)display;
+	D_frameev.handler = disp_frame_fn;
+	D_maxfps = defmaxfps;
+	damage_clear(&D_damage);
 	D_idleev.type = EV_TIMEOUT;
 	D_idleev.data = (char *)display;
 	D_idleev.handler = disp_idle_fn;
@@ -206,9 +231,8 @@ Display *MakeDisplay(char *uname, char *utty, char *term, int fd, pid_t pid, str
 	D_status_obuffree = -1;
 	Resize_obuf();		/* Allocate memory for buffer */
 	D_obufmax = defobuflimit;
-	D_obuflenmax = D_obuflen - D_obufmax;
+	D_obufchunk = OUTPUT_BLOCK_SIZE;
 	D_auto_nuke = defautonuke;
-	D_obufp = D_obuf;
 	D_printfd = -1;
 	D_userpid = pid;
 	strncpy(D_usertty, utty, sizeof(D_usertty) - 1);
@@ -250,6 +274,9 @@ void FreeDisplay()
 	evdeq(&D_writeev);
 	evdeq(&D_blockedev);
 	evdeq(&D_mapev);
+	evdeq(&D_frameev);
+	damage_free(&D_damage);
+	shadow_free(&D_shadow);
 	if (D_kmaps) {
 		free(D_kmaps);
 		D_kmaps = 0;
@@ -267,8 +294,7 @@ void FreeDisplay()
 			break;
 	if (D_status_lastmsg)
 		free(D_status_lastmsg);
-	if (D_obuf)
-		free(D_obuf);
+	obuf_free(&D_obuf);
 	*dp = display->d_next;
 
 	while (D_canvas.c_slperp)
@@ -280,8 +306,8 @@ void FreeDisplay()
 			p->w_pdisplay = 0;
 		if (p->w_lastdisp == display)
 			p->w_lastdisp = 0;
-		if (p->w_readev.condneg == (int *)&D_status || p->w_readev.condneg == &D_obuflenmax)
-			p->w_readev.condpos = p->w_readev.condneg = 0;
+		if (p->w_waitdisp == display)
+			WakeWindow(p);
 	}
 	for (Window *p = windows; p; p = p->w_next)
 		if (p->w_zdisplay == display)
@@ -319,8 +345,17 @@ void InitTerm(int adapt)
 	if (adapt == 0)
 		ResizeDisplay(D_defwidth, D_defheight);
 	ChangeScrollRegion(0, D_height - 1);
+	/* once per display, the answers do not change */
+	if (!D_modequery) {
+		D_modequery = true;
+		if (D_CML && D_CMC && !D_CLR)
+			QueryMode(0);
+		if (!D_CSY)
+			QueryMode(1);
+	}
 	D_x = D_y = 0;
 	Flush(3);
+	DisplayForget();
 	ClearAll();
 	/* In case the size was changed by a init sequence */
 	CheckScreenSize((adapt) ? 2 : 0);
@@ -359,6 +394,7 @@ void FinitTerm()
 
 static void INSERTCHAR(int c)
 {
+	ShadowForget(D_y, D_y);		/* the rest of the line moves */
 	if (!D_insert && D_x < D_width - 1) {
 		if (D_IC || D_CIC) {
 			if (D_IC)
@@ -400,6 +436,7 @@ void PUTCHARLP(int c)
 		return;
 	}
 	D_lp_missing = 1;
+	ShadowForget(D_y, D_y);
 	D_rend.image = c;
 	D_lpchar = D_rend;
 	/* XXX -> PutChar ? */
@@ -411,6 +448,29 @@ void PUTCHARLP(int c)
 	}
 }
 
+/*
+ * Like n calls of PUTCHARLP. Plain ASCII that doesn't reach the last
+ * column is copied to the output buffer in one go.
+ */
+void PUTSTRLP(char *s, int n)
+{
+	Shadow *sh;
+
+	if (D_x < 0 || D_x + n >= D_width || D_mbcs || D_rend.font || D_rend.fontx
+	    || (D_encoding && D_encoding != UTF8) || (D_xtable && D_xtable[0])
+	    || charscan_ascii(s, n) != (size_t)n) {
+		while (n-- > 0)
+			PUTCHARLP(*s++);
+		return;
+	}
+	if (D_insert)
+		InsertMode(false);
+	if ((sh = GetShadow()) && D_y >= 0)
+		shadow_putstr(sh, D_x, D_y, s, n, &D_rend);
+	AddBuf(s, n);
+	D_x += n;
+}
+
 /*
  * RAW_PUTCHAR() is for all text that will be displayed.
  * NOTE: charset Nr. 0 has a conversion table, but c1, c2, ... don't.
@@ -418,6 +478,7 @@ void PUTCHARLP(int c)
 
 static void RAW_PUTCHAR(int c)
 {
+	ShadowPutc(c, !D_mbcs && !is_dw_font(D_rend.font));
 
 	if (D_encoding == UTF8) {
 		c = (c & 255) | (unsigned char)D_rend.font << 8 | (unsigned char)D_rend.fontx << 16;
@@ -486,6 +547,28 @@ static void RAW_PUTCHAR(int c)
 	}
 }
 
+/* AddChar for n bytes at once. */
+static void AddBuf(char *s, int n)
+{
+	int l;
+
+	while (n > 0) {
+		/* keep the last free byte, AddChar needs it to call Resize_obuf */
+		if ((l = D_obuffree - 1) <= 0) {
+			AddChar(*s++);
+			n--;
+			continue;
+		}
+		if (l > n)
+			l = n;
+		memcpy(D_obufp, s, l);
+		D_obufp += l;
+		D_obuffree -= l;
+		s += l;
+		n -= l;
+	}
+}
+
 static int DoAddChar(int c)
 {
 	/* this is for ESC-sequences only (AddChar is a macro) */
@@ -585,6 +668,17 @@ void MouseMode(int mode)
 	}
 }
 
+/*
+ * Have a terminal that supports synchronized output, mode 2026, show
+ * what is sent between on and off at once. It says so with SY or in its
+ * answer to QueryMode.
+ */
+static void SyncOutput(bool on)
+{
+	if (D_CSY)
+		AddStr(on ? "\033[?2026h" : "\033[?2026l");
+}
+
 void BracketedPasteMode(bool mode)
 {
 	if (!display)
@@ -639,6 +733,64 @@ int CalcCost(char *s)
 		return EXPENSIVE;
 }
 
+/* Number of decimal digits of n >= 0. */
+static int Digits(int n)
+{
+	int d = 1;
+
+	while (n >= 10) {
+		n /= 10;
+		d++;
+	}
+	return d;
+}
+
+/* What moving the cursor to x, y costs by absolute addressing. */
+static int CMCost(int x, int y)
+{
+	if (D_HO && !x && !y)
+		return D_HOcost;
+	if (D_CMansi)
+		return 4 + Digits(y + 1) + Digits(x + 1);
+	return CalcCost(tgoto(D_CM, x, y));
+}
+
+/* The cost of the counted move s by n, from the table costs if n is small. */
+static int MoveCost(short *costs, char *s, int n)
+{
+	return n < MOVECOSTS ? costs[n] : CalcCost(tgoto(s, 0, n));
+}
+
+/* Put the decimal digits of n >= 0 at p, returns where they end. */
+static char *PutNum(char *p, int n)
+{
+	char *e = p + Digits(n), *q = e;
+
+	do
+		*--q = '0' + n % 10;
+	while ((n /= 10));
+	return e;
+}
+
+/* Move the cursor to x, y by absolute addressing. */
+static void GotoCM(int x, int y)
+{
+	char buf[32], *p = buf;
+
+	if (D_HO && !x && !y)
+		AddCStr(D_HO);
+	else if (D_CMansi) {
+		*p++ = '\033';
+		*p++ = '[';
+		p = PutNum(p, y + 1);
+		*p++ = ';';
+		p = PutNum(p, x + 1);
+		*p++ = 'H';
+		AddBuf(buf, p - buf);
+	} else
+		AddCStr(tgoto(D_CM, x, y));
+}
+
 void GotoPos(int x2, int y2)
 {
 	int dy, dx, x1, y1;
@@ -672,10 +824,7 @@ void GotoPos(int x2, int y2)
 	    || (y2 > D_bot && y1 <= D_bot)	/* have to cross border */
 	    ||(y2 < D_top && y1 >= D_top)) {	/* of scrollregion ?    */
  DoCM:
-		if (D_HO && !x2 && !y2)
-			AddCStr(D_HO);
-		else
-			AddCStr(tgoto(D_CM, x2, y2));
+		GotoCM(x2, y2);
 		D_x = x2;
 		D_y = y2;
 		return;
@@ -687,19 +836,14 @@ void GotoPos(int x2, int y2)
 	if ((y1 > D_bot && y2 > y1) || (y1 < D_top && y2 < y1))
 		goto DoCM;
 
-	/* Calculate CMcost */
-	if (D_HO && !x2 && !y2)
-		s = D_HO;
-	else
-		s = tgoto(D_CM, x2, y2);
-	CMcost = CalcCost(s);
+	CMcost = CMCost(x2, y2);
 
 	/* Calculate the cost to move the cursor to the right x position */
 	costx = EXPENSIVE;
 	if (x1 >= 0) {		/* relativ x positioning only if we know where we are */
 		if (dx > 0) {
 			if (D_CRI && (dx > 1 || !D_ND)) {
-				costx = CalcCost(tgoto(D_CRI, 0, dx));
+				costx = MoveCost(D_CRIcost, D_CRI, dx);
 				xm = M_CRI;
 			}
 			if ((m = D_NDcost * dx) < costx) {
@@ -708,7 +852,7 @@ void GotoPos(int x2, int y2)
 			}
 		} else if (dx < 0) {
 			if (D_CLE && (dx < -1 || !D_BC)) {
-				costx = CalcCost(tgoto(D_CLE, 0, -dx));
+				costx = MoveCost(D_CLEcost, D_CLE, -dx);
 				xm = M_CLE;
 			}
 			if ((m = -dx * D_LEcost) < costx) {
@@ -731,7 +875,7 @@ void GotoPos(int x2, int y2)
 	costy = EXPENSIVE;
 	if (dy > 0) {
 		if (D_CDO && dy > 1) {	/* DO & NL are always != 0 */
-			costy = CalcCost(tgoto(D_CDO, 0, dy));
+			costy = MoveCost(D_CDOcost, D_CDO, dy);
 			ym = M_CDO;
 		}
 		if ((m = dy * ((x2 == 0) ? D_NLcost : D_DOcost)) < costy) {
@@ -740,7 +884,7 @@ void GotoPos(int x2, int y2)
 		}
 	} else if (dy < 0) {
 		if (D_CUP && (dy < -1 || !D_UP)) {
-			costy = CalcCost(tgoto(D_CUP, 0, -dy));
+			costy = MoveCost(D_CUPcost, D_CUP, -dy);
 			ym = M_CUP;
 		}
 		if ((m = -dy * D_UPcost) < costy) {
@@ -835,6 +979,8 @@ void ClearArea(int x1, int y1, int xs, int xe, int x2, int y2, int bce, int usel
 		if (x1 == 0 && y1 == 0 && D_CL) {
 			AddCStr(D_CL);
 			D_y = D_x = 0;
+			for (int y = 0; y < D_height; y++)
+				ShadowErase(0, D_width - 1, y);
 			return;
 		}
 		/*
@@ -844,12 +990,16 @@ void ClearArea(int x1, int y1, int xs, int xe, int x2, int y2, int bce, int usel
 		if (D_CD && (y1 < y2 || !D_CE)) {
 			GotoPos(x1, y1);
 			AddCStr(D_CD);
+			ShadowErase(x1, D_width - 1, y1);
+			for (int y = y1 + 1; y < D_height; y++)
+				ShadowErase(0, D_width - 1, y);
 			return;
 		}
 	}
 	if (x1 == 0 && xs == 0 && (xe == D_width - 1 || y1 == y2) && y1 == 0 && D_CCD && (!bce || D_BE)) {
 		GotoPos(x1, y1);
 		AddCStr(D_CCD);
+		ShadowForget(0, D_height - 1);
 		return;
 	}
 	xxe = xe;
@@ -859,11 +1009,13 @@ void ClearArea(int x1, int y1, int xs, int xe, int x2, int y2, int bce, int usel
 		if (x1 == 0 && D_CB && (xxe != D_width - 1 || (D_x == xxe && D_y == y)) && (!bce || D_BE)) {
 			GotoPos(xxe, y);
 			AddCStr(D_CB);
+			ShadowErase(0, xxe, y);
 			continue;
 		}
 		if (xxe == D_width - 1 && D_CE && (!bce || D_BE)) {
 			GotoPos(x1, y);
 			AddCStr(D_CE);
+			ShadowErase(x1, D_width - 1, y);
 			continue;
 		}
 		if (uselayfn) {
@@ -904,6 +1056,7 @@ void ClearArea(int x1, int y1, int xs, int xe, int x2, int y2, int bce, int usel
  */
 void Redisplay(int cur_only)
 {
+	SyncOutput(true);
 	/* XXX do em all? */
 	InsertMode(false);
 	ChangeScrollRegion(0, D_height - 1);
@@ -916,15 +1069,22 @@ void Redisplay(int cur_only)
 	SetRendition(&mchar_null);
 	SetFlow(FLOW_ON);
 
-	ClearAll();
-	RefreshXtermOSC();
-	if (cur_only > 0 && D_fore)
-		RefreshArea(0, D_fore->w_y, D_width - 1, D_fore->w_y, 1);
-	else
-		RefreshAll(1);
+	if (cur_only <= 0 && D_CE && ShadowAnyKnown(0, D_height - 1)) {
+		/* only send what differs from the terminal */
+		RefreshXtermOSC();
+		RefreshAll(0);
+	} else {
+		ClearAll();
+		RefreshXtermOSC();
+		if (cur_only > 0 && D_fore)
+			RefreshArea(0, D_fore->w_y, D_width - 1, D_fore->w_y, 1);
+		else
+			RefreshAll(1);
+	}
 	RefreshHStatus();
 	CV_CALL(D_forecv, LayRestore();
 		LaySetCursor());
+	SyncOutput(false);
 }
 
 void RedisplayDisplays(int cur_only)
@@ -949,6 +1109,7 @@ void ScrollH(int y, int xs, int xe, int n, int bce, struct mline *oml)
 		/* UpdateLine(oml, y, xs, xe); */
 		return;
 	}
+	ShadowForget(y, y);
 	GotoPos(xs, y);
 	if (D_UT)
 		SetRendition(&mchar_null);
@@ -1024,7 +1185,8 @@ void ScrollV(int xs, int ys, int xe, int ye, int n, int bce)
 		return;
 	}
 	if (xs > D_vpxmin || xe < D_vpxmax) {
-		RefreshArea(xs, ys, xe, ye, 0);
+		if (!ScrollLR(xs, ys, xe, ye, n, bce))
+			RefreshArea(xs, ys, xe, ye, 0);
 		return;
 	}
 
@@ -1107,6 +1269,7 @@ void ScrollV(int xs, int ys, int xe, int ye, int n, int bce)
 		RefreshArea(xs, ys, xe, ye, 0);
 		return;
 	}
+	ShadowScroll(ys, ye, up ? n : -n);
 	if (bce && !D_BE) {
 		if (up)
 			ClearArea(xs, ye - n + 1, xs, xe, xe, ye, bce, 0);
@@ -1122,6 +1285,52 @@ void ScrollV(int xs, int ys, int xe, int ye, int n, int bce)
 */
 }
 
+/*
+ * Whether ScrollV can move lines of columns xs..xe, which leave out
+ * part of the display, by n lines without redrawing them.
+ */
+bool CanScrollCols(int xs, int xe, int n)
+{
+	if (xs <= D_vpxmin && xe >= D_vpxmax)
+		return false;
+	if (!D_CML || !D_CMC || !(D_lrmargins || D_CLR) || !D_CS || D_lp_missing)
+		return false;
+	return n > 0 || D_SR;
+}
+
+/*
+ * ScrollV for a region that leaves out columns of the display, with
+ * DEC left/right margins (DECSLRM) around it for the time of the
+ * scroll. Returns false if the terminal can't do that.
+ */
+static bool ScrollLR(int xs, int ys, int xe, int ye, int n, int bce)
+{
+	bool up = n > 0;
+
+	if (!CanScrollCols(xs, xe, n))
+		return false;
+	ChangeScrollRegion(ys, ye);
+	AddCStr(tgoto(D_CML, xe, xs));
+	D_x = D_y = -1;		/* the cursor went home */
+	if (D_UT)
+		SetRendition(&mchar_null);
+	if (D_BE)
+		SetBackColor(bce);
+	GotoPos(xs, up ? ye : ys);
+	for (int i = up ? n : -n; i-- > 0;)
+		AddCStr(up ? D_NL : D_SR);
+	AddCStr(D_CMC);
+	D_x = D_y = -1;
+	ShadowScrollCols(xs, xe, ys, ye, n);
+	if (bce && !D_BE) {
+		if (up)
+			ClearArea(xs, ye - n + 1, xs, xe, xe, ye, bce, 0);
+		else
+			ClearArea(xs, ys, xs, xe, xe, ys - n - 1, bce, 0);
+	}
+	return true;
+}
+
 void SetAttr(int new)
 {
 	int i, j, old, typ;
@@ -1364,21 +1573,66 @@ void SetColor(uint32_t foreground, uint32_t background)
 	}
 }
 
+/* color c as the display can show it, for the SGR sequence */
+static uint32_t SGRColor(uint32_t c)
+{
+	if (!(c & 0x01000000) || (c & 0xff) < 16 || D_CCO == 256)
+		return c;
+	return 0x01000000 | (D_CCO == 88 ? color256to88(c & 0xff) : color256to16(c & 0xff));
+}
+
+/*
+ * Attributes and colors in one sequence, for terminals where they are
+ * all ANSI SGR parameters (D_SGRansi).
+ */
+static void SetSGR(uint32_t attr, uint32_t fg, uint32_t bg)
+{
+	struct mstyle from, to;
+	char buf[SGRMAX];
+	SGR sgr;
+	int n;
+
+	if (D_rend.attr == attr && D_rend.colorfg == fg && D_rend.colorbg == bg)
+		return;
+	sgr = D_sgr;
+	if (hastruecolor)
+		sgr.flags |= SGR_DIRECT;
+	from.attr = D_rend.attr;
+	from.colorfg = SGRColor(D_rend.colorfg);
+	from.colorbg = SGRColor(D_rend.colorbg);
+	to.attr = attr;
+	to.colorfg = SGRColor(fg);
+	to.colorbg = SGRColor(bg);
+	if ((n = sgr_encode(&sgr, &from, &to, buf)))
+		AddBuf(buf, n);
+	D_rend.attr = attr;
+	D_rend.colorfg = fg;
+	D_rend.colorbg = bg;
+	D_atyp = attr ? ATYP_M : 0;
+}
+
 static void SetBackColor(int new)
 {
 	if (!display)
 		return;
-	SetColor(D_rend.colorfg, new);
+	if (D_SGRansi)
+		SetSGR(D_rend.attr, D_rend.colorfg, new);
+	else
+		SetColor(D_rend.colorfg, new);
 }
 
 void SetRendition(struct mchar *mc)
 {
 	if (!display)
 		return;
-	if (D_rend.attr != mc->attr)
-		SetAttr(mc->attr);
-	if (D_rend.colorbg != mc->colorbg || D_rend.colorfg != mc->colorfg)
-		SetColor(mc->colorfg, mc->colorbg);
+	if (D_SGRansi)
+		SetSGR(mc->attr, mc->colorfg, mc->colorbg);
+	else {
+		if (D_rend.attr != mc->attr)
+			SetAttr(mc->attr);
+		if (D_rend.colorbg != mc->colorbg || D_rend.colorfg != mc->colorfg)
+			SetColor(mc->colorfg, mc->colorbg);
+	}
 	if (D_rend.font != mc->font)
 		SetFont(mc->font);
 	if (D_encoding == UTF8)
@@ -1387,20 +1641,23 @@ void SetRendition(struct mchar *mc)
 
 void SetRenditionMline(struct mline *ml, int x)
 {
+	struct mstyle st;
+
 	if (!display)
 		return;
-	if (D_rend.attr != ml->attr[x])
-		SetAttr(ml->attr[x]);
-	if (D_rend.colorbg != ml->colorbg[x]
-	    || D_rend.colorfg != ml->colorfg[x]) {
-		struct mchar mc;
-		copy_mline2mchar(&mc, ml, x);
-		SetColor(mc.colorfg, mc.colorbg);
+	st = *mline_style(ml, x);
+	if (D_SGRansi)
+		SetSGR(st.attr, st.colorfg, st.colorbg);
+	else {
+		if (D_rend.attr != st.attr)
+			SetAttr(st.attr);
+		if (D_rend.colorbg != st.colorbg || D_rend.colorfg != st.colorfg)
+			SetColor(st.colorfg, st.colorbg);
 	}
-	if (D_rend.font != ml->font[x])
-		SetFont(ml->font[x]);
+	if (D_rend.font != st.font)
+		SetFont(st.font);
 	if (D_encoding == UTF8)
-		D_rend.fontx = ml->fontx[x];
+		D_rend.fontx = st.fontx;
 }
 
 void MakeStatus(char *msg)
@@ -1466,6 +1723,7 @@ void MakeStatus(char *msg)
 		SetRendition(&mchar_so);
 		InsertMode(false);
 		AddStr(msg);
+		ShadowForget(STATLINE(), STATLINE());
 		if (D_status_len < max) {
 			/* Wayne Davison: add extra space for readability */
 			D_status_len++;
@@ -1484,7 +1742,7 @@ void MakeStatus(char *msg)
 		ShowHStatus(msg);
 	}
 
-	D_status_obufpos = D_obufp - D_obuf;
+	D_status_obufpos = obuf_len(&D_obuf);
 
 	if (D_status == STATUS_ON_WIN) {
 		Display *olddisplay = display;
@@ -1516,7 +1774,6 @@ void RemoveStatus()
 		return;
 
 	if (D_status_obuffree >= 0) {
-		D_obuflen = D_status_obuflen;
 		D_obuffree = D_status_obuffree;
 		D_status_obuffree = -1;
 	}
@@ -1524,6 +1781,9 @@ void RemoveStatus()
 	D_status_obufpos = 0;
 	D_status_bell = 0;
 	evdeq(&D_statusev);
+	if (obuf_len(&D_obuf))
+		evunblock(&D_writeev);
+	WakeWaitingWindows();
 	olddisplay = display;
 	oldflayer = flayer;
 	if (where == STATUS_ON_WIN) {
@@ -1548,7 +1808,7 @@ static void RemoveStatusMinWait()
 	if (!D_status_bell && !D_status_obufpos) {
 		struct timeval now;
 		int ti;
-		gettimeofday(&now, NULL);
+		GetTime(&now);
 		ti = (now.tv_sec - D_status_time.tv_sec) * 1000 + (now.tv_usec - D_status_time.tv_usec) / 1000;
 		if (ti < MsgMinWait)
 			DisplaySleep1000(MsgMinWait - ti, 0);
@@ -1556,6 +1816,34 @@ static void RemoveStatusMinWait()
 	RemoveStatus();
 }
 
+/*
+ * All output has been written since D_waitstart, when windows had to wait
+ * for the display or it got redrawn after a drop. Remember whether that
+ * took so long that framedrop should throw away output, see muchpending.
+ */
+static void WaitDone()
+{
+	struct timeval now;
+
+	if (!timerisset(&D_waitstart))
+		return;
+	GetTime(&now);
+	timersub(&now, &D_waitstart, &now);
+	D_lagging = now.tv_sec * 1000 + now.tv_usec / 1000 >= FRAMEDROP_LAG;
+	timerclear(&D_waitstart);
+}
+
+/* let windows read again which stopped to wait for this display */
+static void WakeWaitingWindows()
+{
+	if (!D_waitwins)
+		return;
+	D_waitwins = false;
+	for (Window *p = windows; p; p = p->w_next)
+		if (p->w_waitdisp == display)
+			WakeWindow(p);
+}
+
 static int strlen_onscreen(char *c, char *end)
 {
 	int len = 0;
@@ -1590,6 +1878,8 @@ static int PrePutWinMsg(char *s, int start, int max)
 		D_x -= (max - chars);	/* Yak! But this is necessary to count for
 					   the fact that not every byte represents a
 					   character. */
+		if (chars != max - start)
+			ShadowForget(D_y, D_y);	/* it saw bytes, not characters */
 		return start + chars;
 	} else {
 		PutWinMsg(s, start, max);
@@ -1712,7 +2002,7 @@ void RefreshAll(int isblank)
 void RefreshArea(int xs, int ys, int xe, int ye, int isblank)
 {
 	int y;
-	if (!isblank && xs == 0 && xe == D_width - 1 && ye == D_height - 1 && (ys == 0 || D_CD)) {
+	if (!isblank && xs == 0 && xe == D_width - 1 && ye == D_height - 1 && (ys == 0 || D_CD) && !ShadowAnyKnown(ys, ye)) {
 		ClearArea(xs, ys, xs, xe, xe, ye, 0, 0);
 		isblank = 1;
 	}
@@ -1735,7 +2025,7 @@ void RefreshLine(int y, int from, int to, int isblank)
 		return;		/* can't refresh status */
 	}
 
-	if (isblank == 0 && D_CE && to == D_width - 1 && from < to && D_status != STATUS_ON_HS) {
+	if (isblank == 0 && D_CE && to == D_width - 1 && from < to && D_status != STATUS_ON_HS && !ShadowKnown(y, y)) {
 		GotoPos(from, y);
 		if (D_UT || D_BE)
 			SetRendition(&mchar_null);
@@ -1882,6 +2172,8 @@ void ClearLine(struct mline *oml, int y, int from, int to, int bce)
 	int x;
 	struct mchar bcechar;
 
+	if (ShadowBlankLine(y, from, to, bce))
+		return;		/* nothing to do */
 	if (D_UT)		/* Safe to erase ? */
 		SetRendition(&mchar_null);
 	if (D_BE)
@@ -1889,11 +2181,13 @@ void ClearLine(struct mline *oml, int y, int from, int to, int bce)
 	if (from == 0 && D_CB && (to != D_width - 1 || (D_x == to && D_y == y)) && (!bce || D_BE)) {
 		GotoPos(to, y);
 		AddCStr(D_CB);
+		ShadowErase(0, to, y);
 		return;
 	}
 	if (to == D_width - 1 && D_CE && (!bce || D_BE)) {
 		GotoPos(from, y);
 		AddCStr(D_CE);
+		ShadowErase(from, D_width - 1, y);
 		return;
 	}
 	if (oml == 0)
@@ -1909,11 +2203,144 @@ void ClearLine(struct mline *oml, int y, int from, int to, int bce)
 	DisplayLine(oml, &mline_old, y, from, to);
 }
 
+/*
+ * Whether clearing to the end of the line and drawing what is not blank
+ * beats overwriting every cell that differs between oml and ml.
+ */
+static bool CheaperToClear(struct mline *oml, struct mline *ml, int from, int to)
+{
+	int differ = 0, used = 3;	/* the clear sequence itself */
+
+	for (int x = from; x <= to; x++) {
+		if (!cmp_mline(oml, ml, x))
+			differ++;
+		if (!cmp_mchar_mline(&mchar_blank, ml, x))
+			used++;
+	}
+	return used < differ;
+}
+
+/* Whether the terminal can repeat the character in cell x of ml with REP. */
+static bool CanRepeat(struct mline *ml, int x)
+{
+	const struct mstyle *st = mline_style(ml, x);
+	uint32_t c = ml->image[x];
+
+	if (D_xtable && D_xtable[st->font & 255])
+		return false;	/* may be sent as a string */
+	if (D_encoding == UTF8) {
+		c = (c & 255) | (st->font & 255) << 8 | (st->fontx & 255) << 16;
+		if (c >= 0xd800 && c < 0xe000)
+			return false;	/* combined, sent as two */
+		return c >= 0xa0 || (c >= 32 && c < 0x7f) ? !utf8_isdouble(c) : false;
+	}
+	return !D_encoding && !is_dw_font(st->font) && (c >= 0xa0 || (c >= 32 && c < 0x7f));
+}
+
+/* The bytes one copy of the character in cell x of ml takes, about. */
+static int CharCost(struct mline *ml, int x)
+{
+	const struct mstyle *st = mline_style(ml, x);
+	uint32_t c;
+
+	if (D_encoding != UTF8)
+		return 1;
+	c = (ml->image[x] & 255) | (st->font & 255) << 8 | (st->fontx & 255) << 16;
+	return c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+}
+
+/*
+ * Draw cells x.. of ml that all show the same with fewer bytes than
+ * cell by cell: blanks are erased with EL or ECH, anything else is put
+ * once and then repeated with REP. The run ends at the last cell that
+ * differs from oml. Returns how many cells were drawn, 0 if that
+ * doesn't pay.
+ */
+static int DisplayRun(struct mline *oml, struct mline *ml, int y, int x, int to)
+{
+	struct mchar mc;
+	int n, cost, m;
+	Shadow *sh;
+	char buf[16], *p = buf;
+
+	n = shadow_run(oml, ml, x, to);
+	if (x + n == D_width && ml->image[D_width])
+		n--;		/* the last column is written for the wrap */
+	if (n < 4)
+		return 0;
+	copy_mline2mchar(&mc, ml, x);
+	if (mc.image == ' ' && !mc.attr && !mc.font && !mc.fontx && !mc.colorfg && (!mc.colorbg || D_BE)) {
+		if (x + n == D_width && D_CE && (D_CLP || y != D_bot) && CalcCost(D_CE) < n) {
+			GotoPos(x, y);
+			SetRendition(&mc);
+			AddCStr(D_CE);
+			ShadowErase(x, D_width - 1, y);
+			return n;
+		}
+		/* the cursor stays, moving on is extra */
+		cost = CMCost(x + n, y);
+		if ((m = D_CRI ? MoveCost(D_CRIcost, D_CRI, n) : n * D_NDcost) < cost)
+			cost = m;
+		if (D_EC && CalcCost(tgoto(D_EC, 0, n)) + cost < n) {
+			GotoPos(x, y);
+			SetRendition(&mc);
+			AddCStr2(D_EC, n);
+			ShadowErase(x, x + n - 1, y);
+			return n;
+		}
+	}
+	if (!D_RP || !CanRepeat(ml, x))
+		return 0;
+	if (n > D_width - 1 - x)
+		n = D_width - 1 - x;	/* keep off the last column */
+	if (n < 2 || 3 + Digits(n - 1) >= (n - 1) * CharCost(ml, x))
+		return 0;
+	GotoPos(x, y);
+	SetRenditionMline(ml, x);
+	PUTCHAR(ml->image[x]);
+	*p++ = '\033';
+	*p++ = '[';
+	p = PutNum(p, n - 1);
+	*p++ = 'b';
+	AddBuf(buf, p - buf);
+	if ((sh = GetShadow())) {
+		mc = D_rend;
+		mc.image = ml->image[x];
+		shadow_fill(sh, D_x, D_x + n - 2, y, &mc);
+	}
+	D_x += n - 1;
+	return n;
+}
+
 void DisplayLine(struct mline *oml, struct mline *ml, int y, int from, int to)
 {
-	int x;
+	DisplayLineGen(oml, ml, y, from, to, 0);
+}
+
+/*
+ * DisplayLine for ml with generation gen, see WinRowGen, or 0. A whole
+ * line last drawn from the same generation needs nothing sent, unless
+ * its last column is rewritten for a wrap or the lower right corner.
+ */
+void DisplayLineGen(struct mline *oml, struct mline *ml, int y, int from, int to, uint64_t gen)
+{
+	int x, n;
 	int last2flag = 0, delete_lp = 0;
+	bool full = from == 0 && to == D_width - 1;
+	Shadow *sh;
 
+	if (gen && full && ml && ml->image[to + 1] && !D_mbcs && (D_CLP || y != D_bot || !D_lp_missing)
+	    && (sh = GetShadow()) && shadow_gen(sh, y) == gen)
+		return;
+	if ((sh = GetShadow()) && shadow_line(sh, y)) {
+		oml = shadow_line(sh, y);	/* what is really there */
+		if (ml && to == D_width - 1 && D_CE && (D_CLP || y != D_bot) && CheaperToClear(oml, ml, from, to)) {
+			GotoPos(from, y);
+			SetRendition(&mchar_null);
+			AddCStr(D_CE);
+			ShadowErase(from, to, y);
+		}
+	}
 	if (!D_CLP && y == D_bot && to == D_width - 1) {
 		if (D_lp_missing || !cmp_mline(oml, ml, to)) {
 			if ((D_IC || D_IM) && from < to && !dw_left(ml, to, D_encoding)) {
@@ -1939,6 +2366,10 @@ void DisplayLine(struct mline *oml, struct mline *ml, int y, int from, int to)
 			if ((x < to || x != D_width - 1 || ml->image[x + 1]))
 				if (cmp_mline(oml, ml, x))
 					continue;
+			if ((n = DisplayRun(oml, ml, y, x, to))) {
+				x += n - 1;
+				continue;
+			}
 			GotoPos(x, y);
 			if (dw_right(ml, x, D_encoding)) {
 				if (x > 0) {
@@ -1973,6 +2404,10 @@ void DisplayLine(struct mline *oml, struct mline *ml, int y, int from, int to)
 		else if (D_CE)
 			AddCStr(D_CE);
 	}
+	if (full && x > to && !delete_lp && !D_lp_missing && (sh = GetShadow())) {
+		shadow_setline(sh, y, ml);
+		shadow_setgen(sh, y, gen);
+	}
 }
 
 void PutChar(struct mchar *c, int x, int y)
@@ -1995,6 +2430,7 @@ void InsChar(struct mchar *c, int x, int xe, int y, struct mline *oml)
 		if (x == D_width - 1) {
 			D_lp_missing = 1;
 			D_lpchar = *c;
+			ShadowForget(y, y);
 			return;
 		}
 		if (xe == D_width - 1)
@@ -2011,6 +2447,7 @@ void InsChar(struct mchar *c, int x, int xe, int y, struct mline *oml)
 		/* UpdateLine(oml, y, x, xe); */
 		return;
 	}
+	ShadowForget(y, y);
 	InsertMode(true);
 	if (!D_insert) {
 		if (c->mbcs && D_IC)
@@ -2035,6 +2472,7 @@ void InsChar(struct mchar *c, int x, int xe, int y, struct mline *oml)
 void WrapChar(struct mchar *c, int x, int y, int xs, int ys, int xe, int ye, bool ins)
 {
 	int bce;
+	bool wraps;
 
 	bce = c->colorbg;
 	if (xs != 0 || x != D_width || !D_AM) {
@@ -2073,9 +2511,16 @@ void WrapChar(struct mchar *c, int x, int y, int xs, int ys, int xe, int ye, boo
 		InsChar(c, 0, xe, y, 0);
 		return;
 	}
+	wraps = D_x == D_width && D_y == y;	/* the terminal moves on by itself */
 	D_y = y;
 	D_x = 0;
 	SetRendition(c);
+	if (wraps) {
+		if (y == D_bot)
+			ShadowScroll(D_top, D_bot, 1);
+		else
+			ShadowForget(0, D_height - 1);
+	}
 	RAW_PUTCHAR(c->image);
 	if (c->mbcs) {
 		if (D_encoding == UTF8)
@@ -2197,31 +2642,25 @@ void AddStrn(char *str, int n)
 
 void Flush(int progress)
 {
-	int l;
-	int wr;
-	char *p;
+	struct iovec iov[OUTPUT_IOV_MAX];
+	int n;
+	ssize_t wr;
 
-	l = D_obufp - D_obuf;
-	if (l == 0)
+	if (!obuf_len(&D_obuf))
 		return;
 	if (D_userfd < 0) {
-		D_obuffree += l;
-		D_obufp = D_obuf;
+		obuf_consume(&D_obuf, obuf_len(&D_obuf));
 		return;
 	}
-	p = D_obuf;
 	if (!progress) {
 		fcntl(D_userfd, F_SETFL, 0);
 	}
-	while (l) {
+	while ((n = obuf_iov(&D_obuf, iov, OUTPUT_IOV_MAX, OUTPUT_CHUNK_MAX))) {
 		if (progress) {
-			fd_set w;
-			FD_ZERO(&w);
-			FD_SET(D_userfd, &w);
-			struct timeval t;
-			t.tv_sec = progress;
-			t.tv_usec = 0;
-			wr = select(FD_SETSIZE, (fd_set *) 0, &w, (fd_set *) 0, &t);
+			struct pollfd pfd;
+			pfd.fd = D_userfd;
+			pfd.events = POLLOUT;
+			wr = poll(&pfd, 1, progress * 1000);
 			if (wr == -1) {
 				if (errno == EINTR)
 					continue;
@@ -2232,24 +2671,23 @@ void Flush(int progress)
 				break;
 			}
 		}
-		wr = write(D_userfd, p, l);
+		wr = writev(D_userfd, iov, n);
 		if (wr <= 0) {
-			if (errno == EINTR)
+			if (wr < 0 && errno == EINTR)
 				continue;
 			break;
 		}
-		D_obuffree += wr;
-		p += wr;
-		l -= wr;
+		obuf_consume(&D_obuf, wr);
 	}
-	D_obuffree += l;
-	D_obufp = D_obuf;
+	/* whatever could not be written is lost */
+	obuf_consume(&D_obuf, obuf_len(&D_obuf));
 	if (!progress) {
 		fcntl(D_userfd, F_SETFL, FNBLOCK);
 	}
 	if (D_blocked == 1)
 		D_blocked = 0;
 	D_blocked_fuzz = 0;
+	WakeWaitingWindows();
 }
 
 void freetty()
@@ -2257,15 +2695,28 @@ void freetty()
 	if (D_userfd >= 0)
 		close(D_userfd);
 	D_userfd = -1;
-	D_obufp = 0;
-	D_obuffree = 0;
-	if (D_obuf)
-		free(D_obuf);
-	D_obuf = 0;
-	D_obuflen = 0;
-	D_obuflenmax = -D_obufmax;
+	obuf_free(&D_obuf);
 	D_blocked = 0;
 	D_blocked_fuzz = 0;
+	WakeWaitingWindows();
+}
+
+/*
+ * The display can't keep up with its windows and is in framedrop mode.
+ * Throw away the output it has not seen yet and stop drawing to it, so
+ * the windows keep running at full speed. Once the terminal has taken
+ * what is left, disp_writeev_fn redraws it from the current window
+ * contents.
+ */
+void DropPending()
+{
+	if (D_status)
+		RemoveStatus();
+	FlushPending(true);
+	DisplayForget();
+	D_status_obufpos = 0;
+	D_blocked = 1;
+	D_blocked_fuzz = 0;
 }
 
 /*
@@ -2275,35 +2726,20 @@ void freetty()
 
 void Resize_obuf()
 {
-	int ind;
-
 	if (D_status_obuffree >= 0) {
 		RemoveStatusMinWait();
 		if (--D_obuffree > 0)	/* redo AddChar decrement */
 			return;
 	}
-	if (D_obuflen && D_obuf) {
-		ind = D_obufp - D_obuf;
-		D_obuflen += GRAIN;
-		D_obuffree += GRAIN;
-		D_obuf = realloc(D_obuf, D_obuflen);
-	} else {
-		ind = 0;
-		D_obuflen = GRAIN;
-		D_obuffree = GRAIN;
-		D_obuf = malloc(D_obuflen);
-	}
-	if (!D_obuf)
+	/* the tail is full, continue in a new segment */
+	if (obuf_grow(&D_obuf))
 		Panic(0, "Out of memory");
-	D_obufp = D_obuf + ind;
-	D_obuflenmax = D_obuflen - D_obufmax;
 }
 
 void DisplaySleep1000(int n, int eat)
 {
 	char buf;
-	fd_set r;
-	struct timeval t;
+	struct pollfd pfd;
 
 	if (n <= 0)
 		return;
@@ -2311,19 +2747,25 @@ void DisplaySleep1000(int n, int eat)
 		sleep1000(n);
 		return;
 	}
-	t.tv_usec = (n % 1000) * 1000;
-	t.tv_sec = n / 1000;
-	FD_ZERO(&r);
-	FD_SET(D_userfd, &r);
-	if (select(FD_SETSIZE, &r, (fd_set *) 0, (fd_set *) 0, &t) > 0) {
+	pfd.fd = D_userfd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, n) > 0) {
 		if (eat)
 			read(D_userfd, &buf, 1);
 	}
 }
 
 void NukePending()
-{				/* Nuke pending output in current display, clear screen */
-	int len;
+{
+	FlushPending(false);
+}
+
+/*
+ * Nuke pending output in current display, clear screen. With cancel the
+ * terminal gets CAN first, for a sequence we may have cut in half.
+ */
+static void FlushPending(bool cancel)
+{
 	int oldtop = D_top, oldbot = D_bot;
 	struct mchar oldrend;
 	int oldkeypad = D_keypad, oldcursorkeys = D_cursorkeys;
@@ -2333,13 +2775,14 @@ void NukePending()
 	int oldcursorstyle = D_cursorstyle;
 
 	oldrend = D_rend;
-	len = D_obufp - D_obuf;
 
 	/* Throw away any output that we can... */
 	tcflush(D_userfd, TCOFLUSH);
 
-	D_obufp = D_obuf;
-	D_obuffree += len;
+	obuf_consume(&D_obuf, obuf_len(&D_obuf));
+	WakeWaitingWindows();
+	if (cancel)
+		AddChar(030);
 	D_top = D_bot = -1;
 	AddCStr(D_IS);
 	AddCStr(D_TI);
@@ -2399,37 +2842,40 @@ static void disp_writeev_eagain(Event *event, void *data)
 
 static void disp_writeev_fn(Event *event, void *data)
 {
-	int len, size = OUTPUT_BLOCK_SIZE;
+	struct iovec iov[OUTPUT_IOV_MAX];
+	int n, size;
+	ssize_t wr;
 
 	(void)event; /* unused */
 
 	display = (Display *)data;
-	len = D_obufp - D_obuf;
-	if (len < size)
-		size = len;
+	size = D_obufchunk;
 	if (D_status_obufpos && size > D_status_obufpos)
 		size = D_status_obufpos;
-	size = write(D_userfd, D_obuf, size);
-	if (size >= 0) {
-		len -= size;
-		if (len) {
-			memmove(D_obuf, D_obuf + size, len);
-		}
-		D_obufp -= size;
-		D_obuffree += size;
+	n = obuf_iov(&D_obuf, iov, OUTPUT_IOV_MAX, size);
+	wr = n ? writev(D_userfd, iov, n) : 0;
+	if (wr >= 0) {
+		/* grow the chunk while the tty keeps up, shrink it when it doesn't */
+		if (wr == size && D_obufchunk < OUTPUT_CHUNK_MAX)
+			D_obufchunk *= 2;
+		else if (wr < size)
+			D_obufchunk = wr > OUTPUT_BLOCK_SIZE ? wr : OUTPUT_BLOCK_SIZE;
+		size = wr;
+		obuf_consume(&D_obuf, size);
 		if (D_status_obufpos) {
 			D_status_obufpos -= size;
 			if (!D_status_obufpos) {
 				/* we're finished displaying the message! */
 				if (D_status == STATUS_ON_WIN) {
 					/* setup continue trigger */
-					D_status_obuflen = D_obuflen;
 					D_status_obuffree = D_obuffree;
 					/* setting obbuffree to 0 will make AddChar call
 					 * ResizeObuf */
-					D_obuffree = D_obuflen = 0;
+					D_obuffree = 0;
+					/* RemoveStatus() restarts us */
+					evblock(&D_writeev);
 				}
-				gettimeofday(&D_status_time, NULL);
+				GetTime(&D_status_time);
 				SetTimeout(&D_statusev, MsgWait);
 				evenq(&D_statusev);
 			}
@@ -2440,17 +2886,24 @@ static void disp_writeev_fn(Event *event, void *data)
 				D_blocked_fuzz = 0;
 		}
 		if (D_blockedev.queued) {
-			if (D_obufp - D_obuf > D_obufmax / 2) {
+			if (obuf_len(&D_obuf) > (size_t)D_obufmax / 2) {
 				SetTimeout(&D_blockedev, D_nonblock);
 			} else {
 				evdeq(&D_blockedev);
 			}
 		}
-		if (D_blocked == 1 && D_obuf == D_obufp) {
+		if (D_blocked == 1 && !obuf_len(&D_obuf)) {
 			/* empty again, restart output */
 			D_blocked = 0;
 			Activate(D_fore ? D_fore->w_norefresh : 0);
-			D_blocked_fuzz = D_obufp - D_obuf;
+			D_blocked_fuzz = obuf_len(&D_obuf);
+			GetTime(&D_waitstart);	/* see how fast the redraw drains */
+		}
+		if (obuf_len(&D_obuf) < (size_t)D_obufmax)
+			WakeWaitingWindows();
+		if (!obuf_len(&D_obuf)) {
+			WaitDone();
+			evblock(&D_writeev);	/* serv_select_fn restarts us */
 		}
 	} else {
 		/* linux flow control is badly broken */
@@ -2469,14 +2922,52 @@ static void disp_writeev_fn(Event *event, void *data)
 	}
 }
 
+static const int querymodes[] = { 69, 2026 };	/* DEC private modes QueryMode asks about */
+
+/*
+ * Ask the terminal with DECRQM about mode querymodes[q]. The answer,
+ * ESC [ ? mode ; Ps $ y, is taken out of the input with the key maps,
+ * so it is recognized even if it is read in pieces, see ModeReply.
+ */
+static void QueryMode(int q)
+{
+	char buf[20];
+
+	for (int ps = 0; ps <= 4; ps++) {
+		sprintf(buf, "\033[?%d;%d$y", querymodes[q], ps);
+		mapseq(buf, KMAP_MODES + q * 8 + ps, true);
+	}
+	sprintf(buf, "\033[?%d$p", querymodes[q]);
+	AddStr(buf);
+}
+
+/* The terminal answered QueryMode, key nr tells what. */
+void ModeReply(int nr)
+{
+	char buf[20];
+	int q = (nr - KMAP_MODES) / 8, ps = (nr - KMAP_MODES) % 8;
+	bool on = ps == 1 || ps == 2;	/* the mode is there, set or reset */
+
+	switch (querymodes[q]) {
+	case 69:
+		D_lrmargins = on;
+		break;
+	case 2026:
+		D_CSY = on;
+		break;
+	}
+	for (ps = 0; ps <= 4; ps++) {
+		sprintf(buf, "\033[?%d;%d$y", querymodes[q], ps);
+		mapseq(buf, 0, false);
+	}
+}
+
 static void disp_readev_fn(Event *event, void *data)
 {
 	ssize_t size;
 	char buf[IOSIZE];
 	Canvas *cv;
 
-	(void)event; /* unused */
-
 	display = (Display *)data;
 
 	/* Hmmmm... a bit ugly... */
@@ -2536,6 +3027,8 @@ static void disp_readev_fn(Event *event, void *data)
 				bufp = buf;
 				while (size > 0)
 					LayProcess(&bufp, (size_t*)&size);
+				if (p->w_inlen >= IOSIZE)
+					evblock(event);	/* until win_writeev_fn made room */
 				return;
 			}
 		zmodem_abort(0, display);
@@ -2592,24 +3085,23 @@ static void disp_readev_fn(Event *event, void *data)
 		}
 	}
 	if (D_encoding != (D_forecv ? D_forecv->c_layer->l_encoding : 0)) {
-		int i, j, c, enc;
+		int i, j, k, n, c, enc;
 		char buf2[IOSIZE * 2 + 10];
+		int dec[256];
 		enc = D_forecv ? D_forecv->c_layer->l_encoding : 0;
-		for (i = j = 0; i < size; i++) {
-			c = ((unsigned char *)buf)[i];
-			c = DecodeChar(c, D_encoding, &D_decodestate);
-			if (c == -2)
-				i--;	/* try char again */
-			if (c < 0)
-				continue;
-			if (pastefont) {
-				int font = 0;
-				j += EncodeChar(buf2 + j, c, enc, &font);
-				j += EncodeChar(buf2 + j, -1, enc, &font);
-			} else
-				j += EncodeChar(buf2 + j, c, enc, 0);
-			if (j > (int)sizeof(buf2) - 10)	/* just in case... */
-				break;
+		for (i = j = 0; i < size && j <= (int)sizeof(buf2) - 10;) {
+			i += DecodeBuf((unsigned char *)buf + i, size - i, D_encoding, &D_decodestate, dec, 256, &n);
+			for (k = 0; k < n; k++) {
+				c = dec[k];
+				if (pastefont) {
+					int font = 0;
+					j += EncodeChar(buf2 + j, c, enc, &font);
+					j += EncodeChar(buf2 + j, -1, enc, &font);
+				} else
+					j += EncodeChar(buf2 + j, c, enc, 0);
+				if (j > (int)sizeof(buf2) - 10)	/* just in case... */
+					break;
+			}
 		}
 		(*D_processinput) (buf2, j);
 		return;
@@ -2639,18 +3131,15 @@ static void disp_hstatus_fn(Event *event, void *data)
 
 static void disp_blocked_fn(Event *event, void *data)
 {
-	Window *p;
-
 	(void)event; /* unused */
 
 	display = (Display *)data;
-	if (D_obufp - D_obuf > D_obufmax + D_blocked_fuzz) {
+	if (obuf_len(&D_obuf) > (size_t)(D_obufmax + D_blocked_fuzz)) {
+		if (D_framedrop)
+			DropPending();
 		D_blocked = 1;
 		/* re-enable all windows */
-		for (p = windows; p; p = p->w_next)
-			if (p->w_readev.condneg == &D_obuflenmax) {
-				p->w_readev.condpos = p->w_readev.condneg = 0;
-			}
+		WakeWaitingWindows();
 	}
 }
 
@@ -2683,6 +3172,279 @@ static void disp_map_fn(Event *event, void *data)
 	ProcessInput(p, l);
 }
 
+/*
+ * Frame rate limiting. Layer output that arrives while the current
+ * frame is still running is not drawn but recorded as damage. When the
+ * frame interval is over, the damaged part of the display is redrawn
+ * from the layers in one go, so a window that changes many times per
+ * frame costs only the difference between two frames.
+ */
+
+static void disp_frame_fn(Event *event, void *data)
+{
+	(void)event; /* unused */
+
+	display = (Display *)data;
+	GetTime(&D_framestart);
+	if (D_maxfps)
+		SetTimeout(&D_frameev, 1000 / D_maxfps);
+	DisplayFrame();
+}
+
+/* Whether a window shown on the current display is in a synchronized update. */
+static bool DisplaySynced()
+{
+	for (Canvas *cv = D_cvlist; cv; cv = cv->c_next) {
+		Layer *l = cv->c_layer ? cv->c_layer->l_bottom : NULL;
+
+		if (l && l->l_layfn == &WinLf && ((Window *)l->l_data)->w_sync)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Draw the damage of the current display. It is held while a window on
+ * the display is in a synchronized update, which draws it when it ends.
+ */
+void DisplayFrame()
+{
+	int xs, xe;
+
+	if (D_blocked) {
+		damage_clear(&D_damage);	/* gets a full redraw anyway */
+		return;
+	}
+	if (damage_empty(&D_damage) || DisplaySynced())
+		return;
+	SyncOutput(true);
+	for (int y = D_damage.top; y >= 0 && y <= D_damage.bottom && y < D_height; y++) {
+		if ((xs = D_damage.left[y]) < 0)
+			continue;
+		xe = D_damage.right[y];
+		/* take a neighbour along in case a double width char got split */
+		if (xs > 0)
+			xs--;
+		if (++xe >= D_width)
+			xe = D_width - 1;
+		RefreshLine(y, xs, xe, 0);
+	}
+	damage_clear(&D_damage);
+	if (D_forecv && D_forecv->c_layer) {
+		Canvas *cv = D_forecv;
+		int cx = cv->c_layer->l_x + cv->c_xoff;
+		int cy = cv->c_layer->l_y + cv->c_yoff;
+
+		if (cx < cv->c_xs)
+			cx = cv->c_xs;
+		if (cy < cv->c_ys)
+			cy = cv->c_ys;
+		if (cx > cv->c_xe)
+			cx = cv->c_xe;
+		if (cy > cv->c_ye)
+			cy = cv->c_ye;
+		GotoPos(cx, cy);
+	}
+	SyncOutput(false);
+}
+
+/*
+ * Whether layer output for the current display has to wait for the next
+ * frame. Everything drawn within one iteration of the main loop belongs
+ * to the same frame. The first output after the frame interval is over
+ * starts a new frame and is drawn immediately, so a lone keystroke echo
+ * is never delayed.
+ */
+bool DisplayDeferred()
+{
+	struct timeval now;
+
+	if (!D_maxfps)
+		return false;
+	if (D_frameev.queued)
+		return true;
+	GetTime(&now);
+	if (timercmp(&now, &D_framestart, ==))
+		return false;
+	if (timercmp(&now, &D_frameev.timeout, <)) {
+		evenq(&D_frameev);
+		return true;
+	}
+	D_framestart = now;
+	SetTimeout(&D_frameev, 1000 / D_maxfps);
+	return false;
+}
+
+/* Remember a region of the display to redraw at the next frame. */
+int DisplayDamage(int xs, int xe, int ys, int ye)
+{
+	if (xe >= D_width)
+		xe = D_width - 1;
+	if (ye >= D_height)
+		ye = D_height - 1;
+	return damage_add(&D_damage, xs, xe, ys, ye);
+}
+
+/*
+ * The shadow framebuffer. Output primitives keep it up to date with
+ * what they send, so a redisplay can diff against it and send only what
+ * actually differs on the terminal. Output we cannot follow makes the
+ * affected lines unknown, and unknown lines are drawn in full.
+ */
+
+/* The shadow of the current display, NULL if there is none. */
+static Shadow *GetShadow()
+{
+	if (D_shadow.width != D_width || D_shadow.height != D_height)
+		if (shadow_resize(&D_shadow, D_width, D_height))
+			return NULL;
+	return D_shadow.mem ? &D_shadow : NULL;
+}
+
+/* What erasing shows with the current rendition, NULL if we can't tell. */
+static struct mchar *ShadowBlank(struct mchar *mc)
+{
+	if (D_rend.attr || (D_rend.colorbg && !D_BE))
+		return NULL;
+	*mc = mchar_blank;
+	mc->colorbg = D_rend.colorbg;
+	return mc;
+}
+
+static bool ShadowKnown(int ys, int ye)
+{
+	Shadow *sh;
+
+	return (sh = GetShadow()) && shadow_known(sh, ys, ye);
+}
+
+static bool ShadowAnyKnown(int ys, int ye)
+{
+	Shadow *sh;
+
+	if (!(sh = GetShadow()))
+		return false;
+	for (int y = ys; y <= ye; y++)
+		if (shadow_line(sh, y))
+			return true;
+	return false;
+}
+
+/* Whether columns from..to of line y are known to be blank already. */
+static bool ShadowBlankLine(int y, int from, int to, int bce)
+{
+	Shadow *sh;
+	struct mline *ml;
+	struct mchar mc;
+
+	if (!(sh = GetShadow()) || !(ml = shadow_line(sh, y)))
+		return false;
+	mc = mchar_blank;
+	mc.colorbg = bce;
+	for (int x = from; x <= to; x++)
+		if (!cmp_mchar_mline(&mc, ml, x))
+			return false;
+	return true;
+}
+
+static void ShadowForget(int ys, int ye)
+{
+	Shadow *sh;
+
+	if ((sh = GetShadow()))
+		shadow_forget(sh, ys, ye);
+}
+
+/* Erasing columns xs..xe of line y with the current rendition. */
+static void ShadowErase(int xs, int xe, int y)
+{
+	Shadow *sh;
+	struct mchar mc;
+
+	if (!(sh = GetShadow()))
+		return;
+	if (ShadowBlank(&mc))
+		shadow_fill(sh, xs, xe, y, &mc);
+	else
+		shadow_forget(sh, y, y);
+}
+
+/* The terminal scrolled lines ys..ye by n. */
+static void ShadowScroll(int ys, int ye, int n)
+{
+	Shadow *sh;
+	struct mchar mc;
+
+	if ((sh = GetShadow()))
+		shadow_scroll(sh, ys, ye, n, ShadowBlank(&mc));
+}
+
+/* The terminal scrolled columns xs..xe of lines ys..ye by n. */
+static void ShadowScrollCols(int xs, int xe, int ys, int ye, int n)
+{
+	Shadow *sh;
+	struct mchar mc;
+
+	if ((sh = GetShadow()))
+		shadow_scrollcols(sh, xs, xe, ys, ye, n, ShadowBlank(&mc));
+}
+
+/*
+ * Record character c about to be written at the cursor. It follows the
+ * wrapping logic of RAW_PUTCHAR. Characters that don't fill exactly one
+ * cell are not tracked, their line becomes unknown.
+ */
+static void ShadowPutc(int c, bool whole)
+{
+	Shadow *sh;
+	struct mchar mc;
+	int x = D_x, y = D_y;
+
+	if (!(sh = GetShadow()) || y < 0 || y >= D_height)
+		return;
+	if (x >= D_width) {
+		/* a pending wrap, the character lands on the next line */
+		if (!D_AM)
+			x = D_width - 1;
+		else {
+			x = 0;
+			if (y == D_bot)
+				ShadowScroll(D_top, D_bot, 1);
+			else if (y < D_height - 1)
+				y++;
+			else {
+				shadow_forget(sh, 0, D_height - 1);
+				return;
+			}
+		}
+	}
+	if (D_encoding == UTF8 && whole)
+		whole = !utf8_isdouble((c & 255) | (unsigned char)D_rend.font << 8 | (unsigned char)D_rend.fontx << 16);
+	if (!whole || D_insert)
+		shadow_forget(sh, y, y);
+	else {
+		mc = D_rend;
+		mc.image = c;
+		shadow_put(sh, x, y, &mc);
+	}
+	if (D_AM && !D_CLP && x == D_width - 1) {
+		/* the terminal wraps right away */
+		if (y == D_bot)
+			ShadowScroll(D_top, D_bot, 1);
+		else if (y == D_height - 1)
+			shadow_forget(sh, 0, D_height - 1);
+	}
+}
+
+/* The terminal shows something we don't know, e.g. passed through output. */
+void DisplayForget()
+{
+	Shadow *sh;
+
+	if (display && (sh = GetShadow()))
+		shadow_forget(sh, 0, D_height - 1);
+}
+
 static void disp_idle_fn(Event *event, void *data)
 {
 	Display *olddisplay;
@@ -2836,6 +3598,7 @@ void RunBlanker(char **cmdv)
 	D_blankerpid = pid;
 	evenq(&D_blankerev);
 	D_blocked = 4;
+	DisplayForget();
 	ClearAll();
 	if (slave != -1)
 		close(slave);
@@ -34,13 +34,20 @@
 #include "canvas.h"
 #include "viewport.h"
 #include "comm.h"
+#include "damage.h"
 #include "image.h"
+#include "obuf.h"
 #include "screen.h"
+#include "sgr.h"
+#include "shadow.h"
 
 #define KMAP_KEYS (T_OCAPS-T_CAPS)
 #define KMAP_AKEYS (T_OCAPS-T_CURSOR)
 
 #define KMAP_NOTIMEOUT 0x4000
+#define KMAP_MODES 0x3f00	/* keys that are replies to DECRQM, see QueryMode */
+
+#define MOVECOSTS	256	/* counted cursor moves with their cost at hand */
 
 struct kmap_ext {
 	char *str;
@@ -90,6 +97,9 @@ struct Display {
 	Window *d_other;		/* pointer to other window */
 	int   d_nonblock;		/* -1 don't block if obufmax reached */
 					/* >0: block after nonblock secs */
+	bool  d_framedrop;		/* drop stale output instead of blocking */
+	struct timeval d_waitstart;	/* output has to drain since, see WaitDone */
+	bool  d_lagging;		/* that took over FRAMEDROP_LAG last time */
 	char  d_termname[MAXTERMLEN + 1]; /* $TERM */
 	char	*d_tentry;		/* buffer for tgetstr */
 	char	d_tcinited;		/* termcap inited flag */
@@ -116,6 +126,8 @@ struct Display {
 					   does not */
 	int   d_bracketed;		/* bracketed paste mode */
 	int   d_cursorstyle;		/* cursor style */
+	bool	d_lrmargins;		/* terminal said it has DEC left/right margins */
+	bool	d_modequery;		/* asked about modes, see InitTerm */
 	int   d_xtermosc[4];		/* osc used */
 	struct mchar d_lpchar;		/* missing char */
 	struct timeval d_status_time;	/* time of status display */
@@ -126,7 +138,6 @@ struct Display {
 	int   d_status_buflen;		/* last message buffer len */
 	int	d_status_lastx;		/* position of the cursor */
 	int	d_status_lasty;		/*   before status was displayed */
-	int   d_status_obuflen;		/* saved obuflen */ 
 	int   d_status_obuffree;	/* saved obuffree */ 
 	int	d_status_obufpos;	/* end of status position in obuf */
 	Event d_statusev;	/* timeout event */
@@ -143,12 +154,14 @@ struct Display {
 	struct mode d_NewMode;		/* New tty mode */
 	int	d_flow;			/* tty's flow control on/off flag*/
 	int   d_intrc;			/* current intr when flow is on */
-	char *d_obuf;			/* output buffer */
-	int   d_obuflen;		/* len of buffer */
+	OutBuf d_obuf;			/* output buffer */
 	int	d_obufmax;		/* len where we are blocking the pty */
-	int	d_obuflenmax;		/* len - max */
-	char *d_obufp;			/* pointer in buffer */
-	int   d_obuffree;		/* free bytes in buffer */
+	int	d_obufchunk;		/* bytes to write at once */
+	int	d_maxfps;		/* frames per second, 0 = unlimited */
+	struct timeval d_framestart;	/* when the current frame began */
+	Event	d_frameev;		/* draws the damage at the next frame */
+	Damage	d_damage;		/* what waits for the next frame */
+	Shadow	d_shadow;		/* what the terminal shows */
 	bool	d_auto_nuke;		/* autonuke flag */
 	int	d_nseqs;		/* number of valid mappings */
 	int	d_aseqs;		/* number of allocated mappings */
@@ -167,6 +180,14 @@ struct Display {
 	char ***d_xtable;		/* char translation table */
 	int	d_UPcost, d_DOcost, d_LEcost, d_NDcost;
 	int	d_CRcost, d_IMcost, d_EIcost, d_NLcost;
+	int	d_HOcost;
+	bool	d_CMansi;		/* CM is ESC [ y ; x H, see GotoPos */
+	short	d_CRIcost[MOVECOSTS];	/* cost of RI, LE, DO and UP with a count of n */
+	short	d_CLEcost[MOVECOSTS];
+	short	d_CDOcost[MOVECOSTS];
+	short	d_CUPcost[MOVECOSTS];
+	bool	d_SGRansi;		/* renditions are ANSI SGR, see SetRendition */
+	SGR	d_sgr;			/* what the SGR sequence understands */
 	int   d_printfd;		/* fd for vt100 print sequence */
 #ifdef ENABLE_UTMP
 	slot_t d_loginslot;		/* offset, where utmp_logintty belongs */
@@ -175,6 +196,7 @@ struct Display {
 #endif
 	int   d_blocked;
 	int   d_blocked_fuzz;
+	bool  d_waitwins;		/* windows wait for us to catch up */
 	Event d_idleev;		/* screen blanker */
 	pid_t   d_blankerpid;
 	Event d_blankerev;
@@ -186,6 +208,8 @@ struct Display {
 #define D_username	(DISPLAY(d_user) ? DISPLAY(d_user)->u_name : 0)
 #define D_bracketed	DISPLAY(d_bracketed)
 #define D_cursorstyle	DISPLAY(d_cursorstyle)
+#define D_lrmargins	DISPLAY(d_lrmargins)
+#define D_modequery	DISPLAY(d_modequery)
 #define D_canvas	DISPLAY(d_canvas)
 #define D_cvlist	DISPLAY(d_cvlist)
 #define D_layout	DISPLAY(d_layout)
@@ -197,6 +221,9 @@ struct Display {
 #define D_fore		DISPLAY(d_fore)
 #define D_other		DISPLAY(d_other)
 #define D_nonblock      DISPLAY(d_nonblock)
+#define D_framedrop	DISPLAY(d_framedrop)
+#define D_waitstart	DISPLAY(d_waitstart)
+#define D_lagging	DISPLAY(d_lagging)
 #define D_termname	DISPLAY(d_termname)
 #define D_tentry	DISPLAY(d_tentry)
 #define D_tcinited	DISPLAY(d_tcinited)
@@ -234,7 +261,6 @@ struct Display {
 #define D_status_buflen	DISPLAY(d_status_buflen)
 #define D_status_lastx	DISPLAY(d_status_lastx)
 #define D_status_lasty	DISPLAY(d_status_lasty)
-#define D_status_obuflen	DISPLAY(d_status_obuflen)
 #define D_status_obuffree	DISPLAY(d_status_obuffree)
 #define D_status_obufpos	DISPLAY(d_status_obufpos)
 #define D_statusev	DISPLAY(d_statusev)
@@ -249,11 +275,15 @@ struct Display {
 #define D_flow		DISPLAY(d_flow)
 #define D_intr		DISPLAY(d_intr)
 #define D_obuf		DISPLAY(d_obuf)
-#define D_obuflen	DISPLAY(d_obuflen)
 #define D_obufmax	DISPLAY(d_obufmax)
-#define D_obuflenmax	DISPLAY(d_obuflenmax)
-#define D_obufp		DISPLAY(d_obufp)
-#define D_obuffree	DISPLAY(d_obuffree)
+#define D_obufchunk	DISPLAY(d_obufchunk)
+#define D_maxfps	DISPLAY(d_maxfps)
+#define D_framestart	DISPLAY(d_framestart)
+#define D_frameev	DISPLAY(d_frameev)
+#define D_damage	DISPLAY(d_damage)
+#define D_shadow	DISPLAY(d_shadow)
+#define D_obufp		DISPLAY(d_obuf.wp)
+#define D_obuffree	DISPLAY(d_obuf.free)
 #define D_auto_nuke	DISPLAY(d_auto_nuke)
 #define D_nseqs		DISPLAY(d_nseqs)
 #define D_aseqs		DISPLAY(d_aseqs)
@@ -277,6 +307,14 @@ struct Display {
 #define D_IMcost	DISPLAY(d_IMcost)
 #define D_EIcost	DISPLAY(d_EIcost)
 #define D_NLcost	DISPLAY(d_NLcost)
+#define D_HOcost	DISPLAY(d_HOcost)
+#define D_CMansi	DISPLAY(d_CMansi)
+#define D_SGRansi	DISPLAY(d_SGRansi)
+#define D_sgr		DISPLAY(d_sgr)
+#define D_CRIcost	DISPLAY(d_CRIcost)
+#define D_CLEcost	DISPLAY(d_CLEcost)
+#define D_CDOcost	DISPLAY(d_CDOcost)
+#define D_CUPcost	DISPLAY(d_CUPcost)
 #define D_printfd	DISPLAY(d_printfd)
 #define D_loginslot	DISPLAY(d_loginslot)
 #define D_utmp_logintty	DISPLAY(d_utmp_logintty)
@@ -288,15 +326,19 @@ struct Display {
 #define D_mapev		DISPLAY(d_mapev)
 #define D_blocked	DISPLAY(d_blocked)
 #define D_blocked_fuzz	DISPLAY(d_blocked_fuzz)
+#define D_waitwins	DISPLAY(d_waitwins)
 #define D_idleev	DISPLAY(d_idleev)
 #define D_blankerev	DISPLAY(d_blankerev)
 #define D_blankerpid	DISPLAY(d_blankerpid)
 
 
-#define GRAIN 4096	/* Allocation grain size for output buffer */
 #define OBUF_MAX 256	/* default for obuflimit */
+#define FRAMEDROP_LAG 50	/* ms output may take to drain before framedrop */
+#define MAXFPS_MAX 1000	/* highest frame rate for maxfps */
 
 #define OUTPUT_BLOCK_SIZE 256  /* Block size of output to tty */
+#define OUTPUT_CHUNK_MAX 65536 /* most we try to write at once */
+#define OUTPUT_IOV_MAX 32      /* enough segments for OUTPUT_CHUNK_MAX */
 
 #define AddChar(c)		\
 do				\
@@ -320,6 +362,7 @@ void  InitTerm (int);
 void  FinitTerm (void);
 void  PUTCHAR (int);
 void  PUTCHARLP (int);
+void  PUTSTRLP (char *, int);
 void  ClearAll (void);
 void  ClearArea (int, int, int, int, int, int, int, int);
 void  ClearLine (struct mline *, int, int, int, int);
@@ -331,10 +374,12 @@ void  RedisplayDisplays (int);
 void  ShowHStatus (char *);
 void  RefreshHStatus (void);
 void  DisplayLine (struct mline *, struct mline *, int, int, int);
+void  DisplayLineGen (struct mline *, struct mline *, int, int, int, uint64_t);
 void  GotoPos (int, int);
 int   CalcCost (char *);
 void  ScrollH (int, int, int, int, int, struct mline *);
 void  ScrollV (int, int, int, int, int, int);
+bool  CanScrollCols (int, int, int);
 void  PutChar (struct mchar *, int, int);
 void  InsChar (struct mchar *, int, int, int, struct mline *);
 void  WrapChar (struct mchar *, int, int, int, int, int, int, bool);
@@ -358,19 +403,27 @@ void  Flush (int);
 void  freetty (void);
 void  Resize_obuf (void);
 void  NukePending (void);
+void  DropPending (void);
 void  ClearAllXtermOSC (void);
 void  SetXtermOSC (int, char *);
 void  ResetIdle (void);
 void  KillBlanker (void);
 void  DisplaySleep1000 (int, int);
 void  ClearScrollbackBuffer (void);
+void  DisplayFrame (void);
+bool  DisplayDeferred (void);
+int   DisplayDamage (int, int, int, int);
+void  DisplayForget (void);
+void  ModeReply (int);
 
 /* global variables */
 
 extern bool defautonuke;
+extern bool defframedrop;
 
 extern int captionalways;
 extern int captiontop;
+extern int defmaxfps;
 extern int defmousetrack;
 extern int defnonblock;
 extern int defobuflimit;
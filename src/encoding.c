@@ -29,7 +29,11 @@
 #include <stdint.h>
 
 #include "screen.h"
+#include "charscan.h"
 #include "fileio.h"
+#include "histpack.h"
+#include "linepool.h"
+#include "unitab.h"
 
 static int encmatch(char *, char *);
 static int recode_char(int, int, int);
@@ -475,6 +479,18 @@ struct mchar *recode_mchar(struct mchar *mc, int from, int to)
 	return &rmc;
 }
 
+/* Give cell x of rl, a copy of a line, the character c of encoding to. */
+static void RecodeCell(struct mline *rl, int x, int c, int to)
+{
+	struct mchar mc;
+
+	copy_mline2mchar(&mc, rl, x);
+	rl->image[x] = c & 255;
+	mc.font = c >> 8 & 255;
+	mc.fontx = to == UTF8 ? c >> 16 & 255 : 0;
+	rl->style[x] = mstyle_of(&mc);
+}
+
 struct mline *recode_mline(struct mline *ml, int w, int from, int to)
 {
 	static int maxlen;
@@ -484,7 +500,7 @@ struct mline *recode_mline(struct mline *ml, int w, int from, int to)
 
 	if (from == to || (from != UTF8 && to != UTF8) || w == 0)
 		return ml;
-	if (ml->font == null && ml->fontx == null && encodings[from].deffont == 0)
+	if (ml->style == null && encodings[from].deffont == 0)
 		return ml;
 	if (w > maxlen) {
 		for (i = 0; i < 2; i++) {
@@ -492,15 +508,11 @@ struct mline *recode_mline(struct mline *ml, int w, int from, int to)
 				rml[i].image = malloc(w * 4);
 			else
 				rml[i].image = realloc(rml[i].image, w * 4);
-			if (rml[i].font == 0)
-				rml[i].font = malloc(w * 4);
-			else
-				rml[i].font = realloc(rml[i].font, w * 4);
-			if (rml[i].fontx == 0)
-				rml[i].fontx = malloc(w * 4);
+			if (rml[i].style == 0)
+				rml[i].style = malloc(w * 4);
 			else
-				rml[i].fontx = realloc(rml[i].fontx, w * 4);
-			if (rml[i].image == 0 || rml[i].font == 0 || rml[i].fontx == 0) {
+				rml[i].style = realloc(rml[i].style, w * 4);
+			if (rml[i].image == 0 || rml[i].style == 0) {
 				maxlen = 0;
 				return ml;	/* sorry */
 			}
@@ -509,13 +521,11 @@ struct mline *recode_mline(struct mline *ml, int w, int from, int to)
 	}
 
 	rl = rml + last;
-	rl->attr = ml->attr;
-	rl->colorbg = ml->colorbg;
-	rl->colorfg = ml->colorfg;
+	memmove(rl->style, ml->style, w * 4);
 	for (i = 0; i < w; i++) {
-		c = ml->image[i] | (ml->font[i] << 8);
+		c = ml->image[i] | (mline_style(ml, i)->font << 8);
 		if (from == UTF8)
-			c |= ml->fontx[i] << 16;
+			c |= mline_style(ml, i)->fontx << 16;
 		if (from != UTF8 && c < 256)
 			c |= encodings[from].deffont << 8;
 		if ((from != UTF8 && (c & 0x1f00) != 0 && (c & 0xe000) == 0) || (from == UTF8 && utf8_isdouble(c))) {
@@ -524,20 +534,14 @@ struct mline *recode_mline(struct mline *ml, int w, int from, int to)
 			else {
 				int c2;
 				i++;
-				c2 = ml->image[i] | (ml->font[i] << 8);
+				c2 = ml->image[i] | (mline_style(ml, i)->font << 8);
 				c = recode_char_dw_to_encoding(c, &c2, to);
-				if (to == UTF8)
-					rl->fontx[i - 1] = c >> 16 & 255;
-				rl->font[i - 1] = c >> 8 & 255;
-				rl->image[i - 1] = c & 255;
+				RecodeCell(rl, i - 1, c, to);
 				c = c2;
 			}
 		} else
 			c = recode_char_to_encoding(c, to);
-		rl->image[i] = c & 255;
-		rl->font[i] = c >> 8 & 255;
-		if (to == UTF8)
-			rl->fontx[i] = c >> 16 & 255;
+		RecodeCell(rl, i, c, to);
 	}
 	last ^= 1;
 	return rl;
@@ -679,10 +683,84 @@ int FromUtf8(int c, int *utf8charp)
 	return c;
 }
 
+/* Store character c of the given encoding at x, keeping the rendition. */
+static void SetCellChar(struct mline *ml, int x, int c, int encoding)
+{
+	struct mchar mc;
+
+	copy_mline2mchar(&mc, ml, x);
+	mc.image = c & 255;
+	mc.font = c >> 8 & 255;
+	mc.fontx = encoding == UTF8 ? c >> 16 & 255 : 0;
+	copy_mchar2mline(&mc, ml, x);
+}
+
+static void RecodeLine(Window *p, struct mline *ml, int encoding)
+{
+	int i, c;
+	int width = linepool_len(ml->image) - 1;	/* history rows may still be at an older one */
+
+	if (ml->style == null && encodings[p->w_encoding].deffont == 0)
+		return;
+	for (i = 0; i < width; i++) {
+		c = ml->image[i] | (mline_style(ml, i)->font << 8);
+		if (p->w_encoding == UTF8)
+			c |= mline_style(ml, i)->fontx << 16;
+		if (p->w_encoding != UTF8 && c < 256)
+			c |= encodings[p->w_encoding].deffont << 8;
+		if (c < 256)
+			continue;
+		if (ml->style == null) {
+			if ((ml->style = linepool_alloc(width + 1)) == 0) {
+				ml->style = null;
+				break;
+			}
+		}
+		if ((p->w_encoding != UTF8 && (c & 0x1f00) != 0 && (c & 0xe000) == 0)
+		    || (p->w_encoding == UTF8 && utf8_isdouble(c))) {
+			if (i + 1 == width)
+				c = '?';
+			else {
+				int c2;
+				i++;
+				c2 = ml->image[i] | (mline_style(ml, i)->font << 8) | (mline_style(ml, i)->fontx << 16);
+				c = recode_char_dw_to_encoding(c, &c2, encoding);
+				SetCellChar(ml, i - 1, c, encoding);
+				c = c2;
+			}
+		} else
+			c = recode_char_to_encoding(c, encoding);
+		SetCellChar(ml, i, c, encoding);
+	}
+}
+
+/* Recode the packed history of p by unpacking and packing it line by line. */
+static void RecodeColdLines(Window *p, int encoding)
+{
+	HistPack hp = { 0 };
+	struct mline tmp, *ml;
+
+	tmp.image = linepool_alloc(p->w_width + 1);
+	tmp.style = linepool_alloc(p->w_width + 1);
+	if (tmp.image && tmp.style) {
+		for (int y = 0; y < p->w_cold.lines; y++) {
+			if (!(ml = histpack_line(&p->w_cold, y, p->w_width)))
+				continue;
+			memmove(tmp.image, ml->image, (p->w_width + 1) * 4);
+			memmove(tmp.style, ml->style, (p->w_width + 1) * 4);
+			RecodeLine(p, &tmp, encoding);
+			histpack_push(&hp, &tmp, p->w_width);
+		}
+		histpack_free(&p->w_cold);
+		p->w_cold = hp;
+	}
+	linepool_free(tmp.image);
+	linepool_free(tmp.style);
+}
+
 void WinSwitchEncoding(Window *p, int encoding)
 {
-	int i, j, c;
-	struct mline *ml;
+	int j;
 	Display *d;
 	Canvas *cv;
 	Layer *oldflayer;
@@ -703,220 +781,26 @@ void WinSwitchEncoding(Window *p, int encoding)
 				}
 			}
 	flayer = oldflayer;
-	for (j = 0; j < p->w_height + p->w_histheight; j++) {
-		ml = j < p->w_height ? &p->w_mlines[j] : &p->w_hlines[j - p->w_height];
-		if (ml->font == null && ml->fontx == 0 && encodings[p->w_encoding].deffont == 0)
-			continue;
-		for (i = 0; i < p->w_width; i++) {
-			c = ml->image[i] | (ml->font[i] << 8);
-			if (p->w_encoding == UTF8)
-				c |= ml->fontx[i] << 16;
-			if (p->w_encoding != UTF8 && c < 256)
-				c |= encodings[p->w_encoding].deffont << 8;
-			if (c < 256)
-				continue;
-			if (ml->font == null) {
-				if ((ml->font = calloc(p->w_width + 1, 4)) == 0) {
-					ml->font = null;
-					break;
-				}
-			}
-			if ((p->w_encoding != UTF8 && (c & 0x1f00) != 0 && (c & 0xe000) == 0)
-			    || (p->w_encoding == UTF8 && utf8_isdouble(c))) {
-				if (i + 1 == p->w_width)
-					c = '?';
-				else {
-					int c2;
-					i++;
-					c2 = ml->image[i] | (ml->font[i] << 8) | (ml->fontx[i] << 16);
-					c = recode_char_dw_to_encoding(c, &c2, encoding);
-					if (encoding == UTF8) {
-						if (c > 0x10000 && ml->fontx == null) {
-							if ((ml->fontx =
-							     calloc(p->w_width + 1, 4)) == 0) {
-								ml->fontx = null;
-								break;
-							}
-						}
-						ml->fontx[i - 1] = c >> 16 & 255;
-					} else
-						ml->fontx = null;
-					ml->font[i - 1] = c >> 8 & 255;
-					ml->image[i - 1] = c & 255;
-					c = c2;
-				}
-			} else
-				c = recode_char_to_encoding(c, encoding);
-			ml->image[i] = c & 255;
-			ml->font[i] = c >> 8 & 255;
-			if (encoding == UTF8) {
-				if (c > 0x10000 && ml->fontx == null) {
-					if ((ml->fontx = calloc(p->w_width + 1, 4)) == 0) {
-						ml->fontx = null;
-						break;
-					}
-				}
-				ml->fontx[i] = c >> 16 & 255;
-			} else
-				ml->fontx = null;
-		}
-	}
+	for (j = 0; j < p->w_height + p->w_histheight - p->w_histcold; j++)
+		RecodeLine(p, j < p->w_height ? &p->w_mlines[j] : &p->w_hlines[j - p->w_height], encoding);
+	WinTouchRows(p, 0, p->w_height - 1);
+	if (p->w_cold.lines)
+		RecodeColdLines(p, encoding);
+
 	p->w_encoding = encoding;
 	return;
 }
 
-struct interval {
-	int first;
-	int last;
-};
-
-/* auxiliary function for binary search in interval table */
-static int bisearch(int ucs, const struct interval *table, int max)
-{
-	int min = 0;
-	int mid;
-
-	if (ucs < table[0].first || ucs > table[max].last)
-		return 0;
-	while (max >= min) {
-		mid = (min + max) / 2;
-		if (ucs > table[mid].last)
-			min = mid + 1;
-		else if (ucs < table[mid].first)
-			max = mid - 1;
-		else
-			return 1;
-	}
-
-	return 0;
-}
-
 int utf8_isdouble(int c)
 {
-	/* sorted list of non-overlapping intervals of East Asian Ambiguous
-	 * characters, generated by "uniset +WIDTH-A -cat=Me -cat=Mn -cat=Cf c" */
-	static const struct interval ambiguous[] = {
-		{0x00A1, 0x00A1}, {0x00A4, 0x00A4}, {0x00A7, 0x00A8},
-		{0x00AA, 0x00AA}, {0x00AE, 0x00AE}, {0x00B0, 0x00B4},
-		{0x00B6, 0x00BA}, {0x00BC, 0x00BF}, {0x00C6, 0x00C6},
-		{0x00D0, 0x00D0}, {0x00D7, 0x00D8}, {0x00DE, 0x00E1},
-		{0x00E6, 0x00E6}, {0x00E8, 0x00EA}, {0x00EC, 0x00ED},
-		{0x00F0, 0x00F0}, {0x00F2, 0x00F3}, {0x00F7, 0x00FA},
-		{0x00FC, 0x00FC}, {0x00FE, 0x00FE}, {0x0101, 0x0101},
-		{0x0111, 0x0111}, {0x0113, 0x0113}, {0x011B, 0x011B},
-		{0x0126, 0x0127}, {0x012B, 0x012B}, {0x0131, 0x0133},
-		{0x0138, 0x0138}, {0x013F, 0x0142}, {0x0144, 0x0144},
-		{0x0148, 0x014B}, {0x014D, 0x014D}, {0x0152, 0x0153},
-		{0x0166, 0x0167}, {0x016B, 0x016B}, {0x01CE, 0x01CE},
-		{0x01D0, 0x01D0}, {0x01D2, 0x01D2}, {0x01D4, 0x01D4},
-		{0x01D6, 0x01D6}, {0x01D8, 0x01D8}, {0x01DA, 0x01DA},
-		{0x01DC, 0x01DC}, {0x0251, 0x0251}, {0x0261, 0x0261},
-		{0x02C4, 0x02C4}, {0x02C7, 0x02C7}, {0x02C9, 0x02CB},
-		{0x02CD, 0x02CD}, {0x02D0, 0x02D0}, {0x02D8, 0x02DB},
-		{0x02DD, 0x02DD}, {0x02DF, 0x02DF}, {0x0391, 0x03A1},
-		{0x03A3, 0x03A9}, {0x03B1, 0x03C1}, {0x03C3, 0x03C9},
-		{0x0401, 0x0401}, {0x0410, 0x044F}, {0x0451, 0x0451},
-		{0x2010, 0x2010}, {0x2013, 0x2016}, {0x2018, 0x2019},
-		{0x201C, 0x201D}, {0x2020, 0x2022}, {0x2024, 0x2027},
-		{0x2030, 0x2030}, {0x2032, 0x2033}, {0x2035, 0x2035},
-		{0x203B, 0x203B}, {0x203E, 0x203E}, {0x2074, 0x2074},
-		{0x207F, 0x207F}, {0x2081, 0x2084}, {0x20AC, 0x20AC},
-		{0x2103, 0x2103}, {0x2105, 0x2105}, {0x2109, 0x2109},
-		{0x2113, 0x2113}, {0x2116, 0x2116}, {0x2121, 0x2122},
-		{0x2126, 0x2126}, {0x212B, 0x212B}, {0x2153, 0x2154},
-		{0x215B, 0x215E}, {0x2160, 0x216B}, {0x2170, 0x2179},
-		{0x2190, 0x2199}, {0x21B8, 0x21B9}, {0x21D2, 0x21D2},
-		{0x21D4, 0x21D4}, {0x21E7, 0x21E7}, {0x2200, 0x2200},
-		{0x2202, 0x2203}, {0x2207, 0x2208}, {0x220B, 0x220B},
-		{0x220F, 0x220F}, {0x2211, 0x2211}, {0x2215, 0x2215},
-		{0x221A, 0x221A}, {0x221D, 0x2220}, {0x2223, 0x2223},
-		{0x2225, 0x2225}, {0x2227, 0x222C}, {0x222E, 0x222E},
-		{0x2234, 0x2237}, {0x223C, 0x223D}, {0x2248, 0x2248},
-		{0x224C, 0x224C}, {0x2252, 0x2252}, {0x2260, 0x2261},
-		{0x2264, 0x2267}, {0x226A, 0x226B}, {0x226E, 0x226F},
-		{0x2282, 0x2283}, {0x2286, 0x2287}, {0x2295, 0x2295},
-		{0x2299, 0x2299}, {0x22A5, 0x22A5}, {0x22BF, 0x22BF},
-		{0x2312, 0x2312}, {0x2460, 0x24E9}, {0x24EB, 0x254B},
-		{0x2550, 0x2573}, {0x2580, 0x258F}, {0x2592, 0x2595},
-		{0x25A0, 0x25A1}, {0x25A3, 0x25A9}, {0x25B2, 0x25B3},
-		{0x25B6, 0x25B7}, {0x25BC, 0x25BD}, {0x25C0, 0x25C1},
-		{0x25C6, 0x25C8}, {0x25CB, 0x25CB}, {0x25CE, 0x25D1},
-		{0x25E2, 0x25E5}, {0x25EF, 0x25EF}, {0x2605, 0x2606},
-		{0x2609, 0x2609}, {0x260E, 0x260F}, {0x2614, 0x2615},
-		{0x261C, 0x261C}, {0x261E, 0x261E}, {0x2640, 0x2640},
-		{0x2642, 0x2642}, {0x2660, 0x2661}, {0x2663, 0x2665},
-		{0x2667, 0x266A}, {0x266C, 0x266D}, {0x266F, 0x266F},
-		{0x273D, 0x273D}, {0x2776, 0x277F}, {0xE000, 0xF8FF},
-		{0xFFFD, 0xFFFD}, {0xF0000, 0xFFFFD}, {0x100000, 0x10FFFD}
-	};
-
-	return ((c >= 0x1100 && (c <= 0x115f ||	/* Hangul Jamo init. consonants */
-				 c == 0x2329 || c == 0x232a || (c >= 0x2e80 && c <= 0xa4cf && c != 0x303f) ||	/* CJK ... Yi */
-				 (c >= 0xac00 && c <= 0xd7a3) ||	/* Hangul Syllables */
-				 (c >= 0xf900 && c <= 0xfaff) ||	/* CJK Compatibility Ideographs */
-				 (c >= 0xfe30 && c <= 0xfe6f) ||	/* CJK Compatibility Forms */
-				 (c >= 0xff00 && c <= 0xff60) ||	/* Fullwidth Forms */
-				 (c >= 0xffe0 && c <= 0xffe6) ||
-				 (c >= 0x20000 && c <= 0x2fffd) ||
-				 (c >= 0x30000 && c <= 0x3fffd))) ||
-		(cjkwidth && bisearch(c, ambiguous, sizeof(ambiguous) / sizeof(struct interval) - 1)));
+	int f = unitab(c);
+
+	return (f & UNI_WIDE) || (cjkwidth && (f & UNI_AMBIGUOUS));
 }
 
 int utf8_iscomb(int c)
 {
-	/* taken from Markus Kuhn's wcwidth */
-	static const struct interval combining[] = {
-		{0x0300, 0x036F}, {0x0483, 0x0486}, {0x0488, 0x0489},
-		{0x0591, 0x05BD}, {0x05BF, 0x05BF}, {0x05C1, 0x05C2},
-		{0x05C4, 0x05C5}, {0x05C7, 0x05C7}, {0x0600, 0x0603},
-		{0x0610, 0x0615}, {0x064B, 0x065E}, {0x0670, 0x0670},
-		{0x06D6, 0x06E4}, {0x06E7, 0x06E8}, {0x06EA, 0x06ED},
-		{0x070F, 0x070F}, {0x0711, 0x0711}, {0x0730, 0x074A},
-		{0x07A6, 0x07B0}, {0x07EB, 0x07F3}, {0x0901, 0x0902},
-		{0x093C, 0x093C}, {0x0941, 0x0948}, {0x094D, 0x094D},
-		{0x0951, 0x0954}, {0x0962, 0x0963}, {0x0981, 0x0981},
-		{0x09BC, 0x09BC}, {0x09C1, 0x09C4}, {0x09CD, 0x09CD},
-		{0x09E2, 0x09E3}, {0x0A01, 0x0A02}, {0x0A3C, 0x0A3C},
-		{0x0A41, 0x0A42}, {0x0A47, 0x0A48}, {0x0A4B, 0x0A4D},
-		{0x0A70, 0x0A71}, {0x0A81, 0x0A82}, {0x0ABC, 0x0ABC},
-		{0x0AC1, 0x0AC5}, {0x0AC7, 0x0AC8}, {0x0ACD, 0x0ACD},
-		{0x0AE2, 0x0AE3}, {0x0B01, 0x0B01}, {0x0B3C, 0x0B3C},
-		{0x0B3F, 0x0B3F}, {0x0B41, 0x0B43}, {0x0B4D, 0x0B4D},
-		{0x0B56, 0x0B56}, {0x0B82, 0x0B82}, {0x0BC0, 0x0BC0},
-		{0x0BCD, 0x0BCD}, {0x0C3E, 0x0C40}, {0x0C46, 0x0C48},
-		{0x0C4A, 0x0C4D}, {0x0C55, 0x0C56}, {0x0CBC, 0x0CBC},
-		{0x0CBF, 0x0CBF}, {0x0CC6, 0x0CC6}, {0x0CCC, 0x0CCD},
-		{0x0CE2, 0x0CE3}, {0x0D41, 0x0D43}, {0x0D4D, 0x0D4D},
-		{0x0DCA, 0x0DCA}, {0x0DD2, 0x0DD4}, {0x0DD6, 0x0DD6},
-		{0x0E31, 0x0E31}, {0x0E34, 0x0E3A}, {0x0E47, 0x0E4E},
-		{0x0EB1, 0x0EB1}, {0x0EB4, 0x0EB9}, {0x0EBB, 0x0EBC},
-		{0x0EC8, 0x0ECD}, {0x0F18, 0x0F19}, {0x0F35, 0x0F35},
-		{0x0F37, 0x0F37}, {0x0F39, 0x0F39}, {0x0F71, 0x0F7E},
-		{0x0F80, 0x0F84}, {0x0F86, 0x0F87}, {0x0F90, 0x0F97},
-		{0x0F99, 0x0FBC}, {0x0FC6, 0x0FC6}, {0x102D, 0x1030},
-		{0x1032, 0x1032}, {0x1036, 0x1037}, {0x1039, 0x1039},
-		{0x1058, 0x1059}, {0x1160, 0x11FF}, {0x135F, 0x135F},
-		{0x1712, 0x1714}, {0x1732, 0x1734}, {0x1752, 0x1753},
-		{0x1772, 0x1773}, {0x17B4, 0x17B5}, {0x17B7, 0x17BD},
-		{0x17C6, 0x17C6}, {0x17C9, 0x17D3}, {0x17DD, 0x17DD},
-		{0x180B, 0x180D}, {0x18A9, 0x18A9}, {0x1920, 0x1922},
-		{0x1927, 0x1928}, {0x1932, 0x1932}, {0x1939, 0x193B},
-		{0x1A17, 0x1A18}, {0x1B00, 0x1B03}, {0x1B34, 0x1B34},
-		{0x1B36, 0x1B3A}, {0x1B3C, 0x1B3C}, {0x1B42, 0x1B42},
-		{0x1B6B, 0x1B73}, {0x1DC0, 0x1DCA}, {0x1DFE, 0x1DFF},
-		{0x200B, 0x200F}, {0x202A, 0x202E}, {0x2060, 0x2063},
-		{0x206A, 0x206F}, {0x20D0, 0x20EF}, {0x302A, 0x302F},
-		{0x3099, 0x309A}, {0xA806, 0xA806}, {0xA80B, 0xA80B},
-		{0xA825, 0xA826}, {0xFB1E, 0xFB1E}, {0xFE00, 0xFE0F},
-		{0xFE20, 0xFE23}, {0xFEFF, 0xFEFF}, {0xFFF9, 0xFFFB},
-		{0x10A01, 0x10A03}, {0x10A05, 0x10A06}, {0x10A0C, 0x10A0F},
-		{0x10A38, 0x10A3A}, {0x10A3F, 0x10A3F}, {0x1D167, 0x1D169},
-		{0x1D173, 0x1D182}, {0x1D185, 0x1D18B}, {0x1D1AA, 0x1D1AD},
-		{0x1D242, 0x1D244}, {0xE0001, 0xE0001}, {0xE0020, 0xE007F},
-		{0xE0100, 0xE01EF}
-	};
-
-	return bisearch(c, combining, sizeof(combining) / sizeof(struct interval) - 1);
+	return (unitab(c) & UNI_COMB) != 0;
 }
 
 static void comb_tofront(int root, int i)
@@ -1171,6 +1055,35 @@ int DecodeChar(int c, int encoding, int *statep)
 	return c | (encodings[encoding].deffont << 16);
 }
 
+/*
+ * DecodeChar over buf[0..len), storing up to max characters in out and
+ * their number in *np. Returns the number of bytes used. UTF-8 without a
+ * pending sequence is decoded in bulk.
+ */
+int DecodeBuf(unsigned char *buf, int len, int encoding, int *statep, int *out, int max, int *np)
+{
+	int i = 0, k = 0, c;
+	size_t n;
+
+	while (i < len && k < max) {
+		if (encoding == UTF8 && !*statep) {
+			i += charscan_utf8((char *)buf + i, len - i, out + k, max - k, &n);
+			for (; n > 0; n--, k++)
+				if (out[k] >= 0x10000)
+					out[k] = (out[k] & 0x7f0000) << 8 | (out[k] & 0xffff);
+			if (i == len || k == max)
+				break;
+		}
+		c = DecodeChar(buf[i], encoding, statep);
+		if (c != -2)
+			i++;	/* else try char again */
+		if (c >= 0)
+			out[k++] = c;
+	}
+	*np = k;
+	return i;
+}
+
 int EncodeChar(char *bp, int c, int encoding, int *fontp)
 {
 	int t, f, l;
@@ -1373,17 +1286,14 @@ int PrepareEncodedChar(int c)
 
 int RecodeBuf(unsigned char *fbuf, int flen, int fenc, int tenc, unsigned char *tbuf)
 {
-	int c, i, j;
+	int i, j, k, n;
 	int decstate = 0, font = 0;
+	int dec[256];
 
-	for (i = j = 0; i < flen; i++) {
-		c = fbuf[i];
-		c = DecodeChar(c, fenc, &decstate);
-		if (c == -2)
-			i--;
-		if (c < 0)
-			continue;
-		j += EncodeChar(tbuf ? (char *)tbuf + j : 0, c, tenc, &font);
+	for (i = j = 0; i < flen;) {
+		i += DecodeBuf(fbuf + i, flen - i, fenc, &decstate, dec, 256, &n);
+		for (k = 0; k < n; k++)
+			j += EncodeChar(tbuf ? (char *)tbuf + j : 0, dec[k], tenc, &font);
 	}
 	j += EncodeChar(tbuf ? (char *)tbuf + j : 0, -1, tenc, &font);
 	return j;
@@ -1391,18 +1301,14 @@ int RecodeBuf(unsigned char *fbuf, int flen, int fenc, int tenc, unsigned char *
 
 int ContainsSpecialDeffont(struct mline *ml, int xs, int xe, int encoding)
 {
-	uint32_t *f, *i;
-	int c, x, dx;
+	int c, x;
 
 	if (encoding == UTF8 || encodings[encoding].deffont == 0)
 		return 0;
-	i = ml->image + xs;
-	f = ml->font + xs;
-	dx = xe - xs + 1;
-	while (dx-- > 0) {
-		if (*f++)
+	for (int i = xs; i <= xe; i++) {
+		if (mline_style(ml, i)->font)
 			continue;
-		c = *i++;
+		c = ml->image[i];
 		x = recode_char_to_encoding(c | (encodings[encoding].deffont << 8), UTF8);
 		if (c != x) {
 			return 1;
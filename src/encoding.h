@@ -23,6 +23,7 @@ int   EncodingDefFont (int);
 void  ResetEncoding (Window *);
 int   CanEncodeFont (int, int);
 int   DecodeChar (int, int, int *);
+int   DecodeBuf (unsigned char *, int, int, int *, int *, int, int *);
 int   RecodeBuf (unsigned char *, int, int, int, unsigned char *);
 int   PrepareEncodedChar (int);
 int   EncodeChar (char *, int, int, int *);
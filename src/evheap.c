@@ -0,0 +1,128 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include "config.h"
+
+#include "evheap.h"
+
+#include <stdlib.h>
+
+#define EVHEAP_SIZE 64
+
+/* Whether event A has to fire before event B. Events with the same timeout
+ * fire in priority order. */
+static bool evheap_before(const Event *a, const Event *b)
+{
+	if (a->timeout.tv_sec != b->timeout.tv_sec)
+		return a->timeout.tv_sec < b->timeout.tv_sec;
+	if (a->timeout.tv_usec != b->timeout.tv_usec)
+		return a->timeout.tv_usec < b->timeout.tv_usec;
+	return a->priority > b->priority;
+}
+
+static void evheap_set(EventHeap *h, int i, Event *ev)
+{
+	h->evs[i] = ev;
+	ev->heapidx = i;
+}
+
+static void evheap_siftup(EventHeap *h, int i)
+{
+	Event *ev = h->evs[i];
+
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (!evheap_before(ev, h->evs[parent]))
+			break;
+		evheap_set(h, i, h->evs[parent]);
+		i = parent;
+	}
+	evheap_set(h, i, ev);
+}
+
+static void evheap_siftdown(EventHeap *h, int i)
+{
+	Event *ev = h->evs[i];
+
+	for (;;) {
+		int child = 2 * i + 1;
+		if (child >= h->len)
+			break;
+		if (child + 1 < h->len && evheap_before(h->evs[child + 1], h->evs[child]))
+			child++;
+		if (!evheap_before(h->evs[child], ev))
+			break;
+		evheap_set(h, i, h->evs[child]);
+		i = child;
+	}
+	evheap_set(h, i, ev);
+}
+
+/* Adds EV to the heap. Returns -1 if memory could not be allocated, leaving
+ * the heap unchanged. */
+int evheap_push(EventHeap *h, Event *ev)
+{
+	if (h->len == h->size) {
+		int size = h->size ? h->size * 2 : EVHEAP_SIZE;
+		Event **evs = realloc(h->evs, size * sizeof(Event *));
+		if (evs == NULL)
+			return -1;
+		h->evs = evs;
+		h->size = size;
+	}
+	evheap_set(h, h->len++, ev);
+	evheap_siftup(h, h->len - 1);
+	return 0;
+}
+
+/* Removes EV, which must be in the heap. */
+void evheap_remove(EventHeap *h, Event *ev)
+{
+	int i = ev->heapidx;
+
+	ev->heapidx = -1;
+	if (--h->len == i)
+		return;
+	evheap_set(h, i, h->evs[h->len]);
+	evheap_update(h, h->evs[i]);
+}
+
+/* Restores heap order after the timeout of EV was changed. */
+void evheap_update(EventHeap *h, Event *ev)
+{
+	int i = ev->heapidx;
+
+	if (i > 0 && evheap_before(ev, h->evs[(i - 1) / 2]))
+		evheap_siftup(h, i);
+	else
+		evheap_siftdown(h, i);
+}
+
+/* Returns the event that fires next or NULL if the heap is empty. */
+Event *evheap_top(const EventHeap *h)
+{
+	return h->len ? h->evs[0] : NULL;
+}
+
+void evheap_free(EventHeap *h)
+{
+	free(h->evs);
+	h->evs = NULL;
+	h->len = h->size = 0;
+}
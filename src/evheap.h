@@ -0,0 +1,38 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#ifndef SCREEN_EVHEAP_H
+#define SCREEN_EVHEAP_H
+
+#include "sched.h"
+
+/* binary min-heap of timeout events, ordered by Event.timeout */
+typedef struct {
+	Event **evs;
+	int     len;
+	int     size;
+} EventHeap;
+
+int    evheap_push(EventHeap *, Event *);
+void   evheap_remove(EventHeap *, Event *);
+void   evheap_update(EventHeap *, Event *);
+Event *evheap_top(const EventHeap *);
+void   evheap_free(EventHeap *);
+
+#endif
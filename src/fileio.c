@@ -187,6 +187,7 @@ int StartRc(char *rcfilename, int nopanic)
 				Msg(0, "%s: 'echo [-n] \"string\"' expected.", rc_name);
 				continue;
 			}
+			DisplayForget();
 			AddStr(args[argc - 1]);
 			if (argc != 3) {
 				AddStr("\r\n");
@@ -402,7 +403,8 @@ void WriteFile(struct acluser *user, char *fn, int dump)
 		if (f == NULL) {
 			UserReturn(0);
 		} else {
-			uint32_t *p, *pf;
+			uint32_t *p;
+			struct mline *ml;
 			switch (dump) {
 			case DUMP_HARDCOPY:
 			case DUMP_SCROLLBACK:
@@ -416,20 +418,20 @@ void WriteFile(struct acluser *user, char *fn, int dump)
 				}
 				if (dump == DUMP_SCROLLBACK) {
 					for (i = 0; i < fore->w_histheight; i++) {
-						p = (WIN(i)->image);
-						pf = WIN(i)->font;
+						ml = WIN(i);
+						p = ml->image;
 						for (k = fore->w_width - 1; k >= 0 && p[k] == ' '; k--) ;
 						for (j = 0; j <= k; j++)
-							putc_encoded(f, p[j], pf[j], fore->w_encoding);
+							putc_encoded(f, p[j], mline_style(ml, j)->font, fore->w_encoding);
 						putc('\n', f);
 					}
 				}
 				for (i = 0; i < fore->w_height; i++) {
-					p = fore->w_mlines[i].image;
-					pf = fore->w_mlines[i].font;
+					ml = &fore->w_mlines[i];
+					p = ml->image;
 					for (k = fore->w_width - 1; k >= 0 && p[k] == ' '; k--) ;
 					for (j = 0; j <= k; j++)
-						putc_encoded(f, p[j], pf[j], fore->w_encoding);
+						putc_encoded(f, p[j], mline_style(ml, j)->font, fore->w_encoding);
 					putc('\n', f);
 				}
 				break;
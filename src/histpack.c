@@ -0,0 +1,735 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include "config.h"
+
+#include "histpack.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "linepool.h"
+#include "lz.h"
+
+/*
+ * A line is encoded as a series of varints: the width it was stored at,
+ * the length without the trailing blanks, the wrap marker stored after
+ * the last column, the number of rendition runs, the characters and then
+ * the runs as a count followed by the rendition. The runs are left out if
+ * the whole line has the default rendition. Renditions are stored by
+ * value, as the indices into mstyles change when they are collected. The
+ * width lets a line that goes on in the next one be rewrapped with its
+ * trailing blanks, see histpack_rewrap.
+ */
+
+struct hpblock {
+	uint32_t rawlen;	/* size of the encoded lines */
+	uint32_t len;		/* size of data, rawlen if they did not compress */
+	uint64_t id;
+	int64_t off;		/* of its record in the spill file, -1 if in data */
+	unsigned char data[];
+};
+
+/*
+ * A spill file is only ever appended to. Each block in it follows a
+ * record with its sizes and a checksum, so a block cut short by a crash
+ * or damaged otherwise is refused instead of decoded. Blocks dropped
+ * from the start are cut off by copying the rest to a new file, which
+ * then replaces the old one with rename.
+ */
+
+#define HPMAGIC		0x31425048	/* "HPB1" */
+#define SPILLCOMPACT	(1 << 20)	/* dropped bytes worth compacting for */
+
+struct hprecord {
+	uint32_t magic;
+	uint32_t rawlen;
+	uint32_t len;
+	uint32_t sum;		/* of the data following */
+	uint64_t id;
+};
+
+struct hpspill {
+	int fd;			/* -1 if the file could not be created */
+	char *path;
+	unsigned char *map;
+	size_t maplen;
+	off_t len;		/* bytes written */
+	off_t dead;		/* bytes of dropped blocks at the start */
+};
+
+size_t histpack_memlimit;
+bool histpack_sync;
+const char *histpack_spillpath;
+
+static unsigned long nspills;	/* spill files created */
+
+/* a block decoded at some width */
+struct hpcache {
+	uint64_t id;		/* 0 if the entry is free */
+	int width;		/* 0: each line at the width it was stored at */
+	int ndecoded;		/* lines decoded, from the first one on */
+	unsigned long used;	/* when the entry was last read */
+	struct mline lines[HISTPACK_BLOCK];
+};
+
+static struct hpcache cache[HISTPACK_CACHE];
+static unsigned long ticks;
+static uint64_t nextid;
+
+static unsigned char *scratch;	/* for compressing and decompressing blocks */
+static size_t scratchmax;
+
+#define WIDTHMAX 0xffff	/* wider lines are taken for corrupt ones */
+
+/* longest encoding of a line of width cells */
+#define LINEBOUND(width) (5 * (4 + 7 * (size_t)(width)))
+
+static unsigned char *put_varint(unsigned char *op, uint32_t v)
+{
+	for (; v >= 128; v >>= 7)
+		*op++ = v | 128;
+	*op++ = v;
+	return op;
+}
+
+static const unsigned char *get_varint(const unsigned char *ip, const unsigned char *end, uint32_t *v)
+{
+	uint32_t r = 0;
+
+	for (int s = 0; s < 35; s += 7) {
+		if (ip == end)
+			return NULL;
+		r |= (uint32_t)(*ip & 127) << s;
+		if (!(*ip++ & 128)) {
+			*v = r;
+			return ip;
+		}
+	}
+	return NULL;
+}
+
+static size_t encode_line(unsigned char *op0, const struct mline *ml, int width)
+{
+	unsigned char *op = op0;
+	int len, nruns = 0, x, r;
+
+	for (len = width; len > 0; len--)
+		if (ml->image[len - 1] != ' ' || ml->style[len - 1])
+			break;
+	for (x = 0; x < len; x = r, nruns++)
+		for (r = x + 1; r < len && ml->style[r] == ml->style[x]; r++)
+			;
+	if (nruns == 1 && ml->style[0] == 0)
+		nruns = 0;
+	op = put_varint(op, width);
+	op = put_varint(op, len);
+	op = put_varint(op, ml->image[width]);
+	op = put_varint(op, nruns);
+	for (x = 0; x < len; x++)
+		op = put_varint(op, ml->image[x]);
+	for (x = 0; nruns && x < len; x = r) {
+		const struct mstyle *st = mline_style(ml, x);
+
+		for (r = x + 1; r < len && ml->style[r] == ml->style[x]; r++)
+			;
+		op = put_varint(op, r - x);
+		op = put_varint(op, st->attr);
+		op = put_varint(op, st->font);
+		op = put_varint(op, st->fontx);
+		op = put_varint(op, st->colorbg);
+		op = put_varint(op, st->colorfg);
+	}
+	return op - op0;
+}
+
+/*
+ * Decode the line at ip into ml, whose arrays have room for width + 1
+ * cells, or just skip over it if ml is NULL. Returns where the next
+ * line starts, or NULL if the line is corrupt.
+ */
+static const unsigned char *decode_line(const unsigned char *ip, const unsigned char *end, struct mline *ml, int width)
+{
+	uint32_t len, wrap, nruns, v, n;
+	uint32_t x;
+
+	if (!(ip = get_varint(ip, end, &v)) || !(ip = get_varint(ip, end, &len))
+	    || !(ip = get_varint(ip, end, &wrap))
+	    || !(ip = get_varint(ip, end, &nruns)))
+		return NULL;
+	for (x = 0; x < len; x++) {
+		if (!(ip = get_varint(ip, end, &v)))
+			return NULL;
+		if (ml && x < (uint32_t)width)
+			ml->image[x] = v;
+	}
+	if (ml) {
+		for (; x < (uint32_t)width; x++)
+			ml->image[x] = ' ';
+		ml->image[width] = wrap;
+	}
+	for (x = 0; nruns; nruns--, x += n) {
+		struct mchar mc = { 0 };
+		uint32_t s;
+
+		if (!(ip = get_varint(ip, end, &n)) || n > len - x
+		    || !(ip = get_varint(ip, end, &mc.attr)) || !(ip = get_varint(ip, end, &mc.font))
+		    || !(ip = get_varint(ip, end, &mc.fontx)) || !(ip = get_varint(ip, end, &mc.colorbg))
+		    || !(ip = get_varint(ip, end, &mc.colorfg)))
+			return NULL;
+		if (!ml)
+			continue;
+		s = mstyle_of(&mc);
+		for (v = x; v < x + n && v < (uint32_t)width; v++)
+			ml->style[v] = s;
+	}
+	return ip;
+}
+
+static int grow(unsigned char **buf, size_t *max, size_t need)
+{
+	unsigned char *n;
+
+	if (need <= *max)
+		return 0;
+	if (need < *max * 2)
+		need = *max * 2;
+	if (!(n = realloc(*buf, need)))
+		return -1;
+	*buf = n;
+	*max = need;
+	return 0;
+}
+
+static struct hpblock **block_at(HistPack *hp, int i)
+{
+	return &hp->blocks[(hp->first + i) % hp->maxblocks];
+}
+
+static uint32_t checksum(const unsigned char *p, size_t n)
+{
+	uint32_t h = 2166136261u;
+
+	while (n--)
+		h = (h ^ *p++) * 16777619u;
+	return h;
+}
+
+static int spill_open(HistPack *hp)
+{
+	struct hpspill *sp;
+	const char *name = strrchr(histpack_spillpath, '/');
+	size_t n = strlen(histpack_spillpath) + 32;
+
+	if (!(sp = calloc(1, sizeof(struct hpspill))))
+		return -1;
+	hp->spill = sp;
+	sp->fd = -1;
+	name = name ? name + 1 : histpack_spillpath;
+	if (!(sp->path = malloc(n)))
+		return -1;
+	snprintf(sp->path, n, "%.*s.%s.hist%lu", (int)(name - histpack_spillpath), histpack_spillpath,
+		 name, ++nspills);
+	/* never write through whatever was left or planted under the name */
+	unlink(sp->path);
+	if ((sp->fd = open(sp->path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW, 0600)) < 0)
+		return -1;
+	fcntl(sp->fd, F_SETFD, FD_CLOEXEC);
+	return 0;
+}
+
+static void spill_unmap(struct hpspill *sp)
+{
+	if (sp->map)
+		munmap(sp->map, sp->maplen);
+	sp->map = NULL;
+	sp->maplen = 0;
+}
+
+/* Map the whole file, if end is beyond what is mapped. */
+static int spill_map(struct hpspill *sp, off_t end)
+{
+	void *map;
+
+	if (end <= (off_t)sp->maplen)
+		return 0;
+	spill_unmap(sp);
+	if (end > sp->len || (map = mmap(NULL, sp->len, PROT_READ, MAP_SHARED, sp->fd, 0)) == MAP_FAILED)
+		return -1;
+	sp->map = map;
+	sp->maplen = sp->len;
+	return 0;
+}
+
+static void spill_truncate(struct hpspill *sp, off_t len)
+{
+	spill_unmap(sp);
+	/* whatever this fails to cut off is written over */
+	ftruncate(sp->fd, len);
+	sp->len = len;
+	if (sp->dead > len)
+		sp->dead = len;
+}
+
+/* Move the oldest block in memory to the spill file. */
+static int spill_block(HistPack *hp)
+{
+	struct hpblock **bp = block_at(hp, hp->nspilled), *b = *bp;
+	struct hpspill *sp = hp->spill;
+	struct hprecord rec;
+	struct iovec iov[2];
+
+	if (!sp && spill_open(hp))
+		return -1;
+	sp = hp->spill;
+	if (sp->fd < 0)
+		return -1;
+	rec.magic = HPMAGIC;
+	rec.rawlen = b->rawlen;
+	rec.len = b->len;
+	rec.sum = checksum(b->data, b->len);
+	rec.id = b->id;
+	iov[0].iov_base = &rec;
+	iov[0].iov_len = sizeof(rec);
+	iov[1].iov_base = b->data;
+	iov[1].iov_len = b->len;
+	if (lseek(sp->fd, sp->len, SEEK_SET) != sp->len
+	    || writev(sp->fd, iov, 2) != (ssize_t)(sizeof(rec) + b->len)) {
+		spill_truncate(sp, sp->len);
+		return -1;
+	}
+	if (histpack_sync)
+		fsync(sp->fd);
+	b->off = sp->len;
+	sp->len += sizeof(rec) + b->len;
+	hp->memsize -= b->len;
+	if ((b = realloc(b, sizeof(struct hpblock))))
+		*bp = b;
+	hp->nspilled++;
+	return 0;
+}
+
+/* Checked data of spilled block b, NULL if it does not match its record. */
+static const unsigned char *spill_data(struct hpspill *sp, const struct hpblock *b)
+{
+	struct hprecord rec;
+	const unsigned char *data;
+
+	if (spill_map(sp, b->off + sizeof(rec) + b->len))
+		return NULL;
+	memcpy(&rec, sp->map + b->off, sizeof(rec));
+	data = sp->map + b->off + sizeof(rec);
+	if (rec.magic != HPMAGIC || rec.id != b->id || rec.rawlen != b->rawlen || rec.len != b->len
+	    || rec.sum != checksum(data, b->len))
+		return NULL;
+	return data;
+}
+
+/* Copy the blocks still in use to a new file, once enough have been dropped. */
+static void spill_compact(HistPack *hp)
+{
+	struct hpspill *sp = hp->spill;
+	off_t live = sp->len - sp->dead;
+	char *tmp;
+	int fd = -1;
+
+	if (hp->nspilled == 0) {
+		spill_truncate(sp, 0);
+		return;
+	}
+	if (sp->dead < SPILLCOMPACT || sp->dead < live || spill_map(sp, sp->len))
+		return;
+	if (!(tmp = malloc(strlen(sp->path) + 2)))
+		return;
+	sprintf(tmp, "%s~", sp->path);
+	unlink(tmp);
+	if ((fd = open(tmp, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW, 0600)) < 0
+	    || write(fd, sp->map + sp->dead, live) != live
+	    || (histpack_sync && fsync(fd))
+	    || rename(tmp, sp->path)) {
+		if (fd >= 0)
+			close(fd);
+		unlink(tmp);
+		free(tmp);
+		return;
+	}
+	free(tmp);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	spill_unmap(sp);
+	close(sp->fd);
+	sp->fd = fd;
+	for (int i = 0; i < hp->nspilled; i++)
+		(*block_at(hp, i))->off -= sp->dead;
+	sp->len = live;
+	sp->dead = 0;
+}
+
+/* Compress the staged lines into a new block. */
+static int seal(HistPack *hp)
+{
+	struct hpblock *b;
+	const unsigned char *data = hp->stage;
+	size_t n;
+
+	if (hp->nblocks == hp->maxblocks) {
+		int max = hp->maxblocks ? hp->maxblocks * 2 : 16;
+		struct hpblock **nb = malloc(max * sizeof(struct hpblock *));
+
+		if (!nb)
+			return -1;
+		for (int i = 0; i < hp->nblocks; i++)
+			nb[i] = *block_at(hp, i);
+		free(hp->blocks);
+		hp->blocks = nb;
+		hp->first = 0;
+		hp->maxblocks = max;
+	}
+	if (grow(&scratch, &scratchmax, LZ_BOUND(hp->stagelen)))
+		return -1;
+	n = lz_compress(hp->stage, hp->stagelen, scratch);
+	if (n < hp->stagelen)
+		data = scratch;
+	else
+		n = hp->stagelen;
+	if (!(b = malloc(sizeof(struct hpblock) + n)))
+		return -1;
+	b->rawlen = hp->stagelen;
+	b->len = n;
+	b->id = hp->stageid;
+	b->off = -1;
+	memcpy(b->data, data, n);
+	*block_at(hp, hp->nblocks++) = b;
+	hp->memsize += n;
+	hp->stagelen = 0;
+	hp->nstage = 0;
+	hp->stageid = ++nextid;
+	while (histpack_memlimit && histpack_spillpath && hp->memsize > histpack_memlimit
+	       && hp->nspilled < hp->nblocks && spill_block(hp) == 0)
+		;
+	return 0;
+}
+
+/* The encoded lines of b, in scratch if they had to be decompressed. */
+static const unsigned char *block_data(HistPack *hp, const struct hpblock *b)
+{
+	const unsigned char *data = b->off < 0 ? b->data : spill_data(hp->spill, b);
+
+	if (!data || b->len == b->rawlen)
+		return data;
+	if (grow(&scratch, &scratchmax, b->rawlen)
+	    || lz_decompress(data, b->len, scratch, b->rawlen) != (ssize_t)b->rawlen)
+		return NULL;
+	return scratch;
+}
+
+/* Make the newest block the staged one again. */
+static int unseal(HistPack *hp)
+{
+	struct hpblock *b = *block_at(hp, hp->nblocks - 1);
+	const unsigned char *ip, *end;
+
+	if (!(ip = block_data(hp, b)) || grow(&hp->stage, &hp->stagemax, b->rawlen))
+		return -1;
+	memcpy(hp->stage, ip, b->rawlen);
+	ip = hp->stage;
+	end = ip + b->rawlen;
+	for (int i = 0; i < HISTPACK_BLOCK; i++) {
+		if (!(ip = decode_line(ip, end, NULL, 0)))
+			return -1;
+		hp->stageoff[i + 1] = ip - hp->stage;
+	}
+	hp->stagelen = b->rawlen;
+	hp->nstage = HISTPACK_BLOCK;
+	hp->stageid = b->id;
+	hp->nblocks--;
+	if (b->off >= 0) {
+		hp->nspilled--;
+		spill_truncate(hp->spill, b->off);
+	} else
+		hp->memsize -= b->len;
+	free(b);
+	return 0;
+}
+
+static void cache_release(struct hpcache *c, int keep)
+{
+	for (int i = keep; i < c->ndecoded; i++) {
+		linepool_free(c->lines[i].image);
+		linepool_free(c->lines[i].style);
+		c->lines[i] = (struct mline) { 0 };
+	}
+	if (c->ndecoded > keep)
+		c->ndecoded = keep;
+	if (!keep)
+		c->id = 0;
+}
+
+/* Decode lines of c up to and including last, from ip on where the next one starts. */
+static int cache_decode(struct hpcache *c, const unsigned char *ip, const unsigned char *end, int last)
+{
+	uint32_t width = c->width;
+
+	while (c->ndecoded <= last) {
+		struct mline *ml = &c->lines[c->ndecoded];
+
+		if (!c->width && (!get_varint(ip, end, &width) || width == 0 || width > WIDTHMAX))
+			return -1;
+		ml->image = linepool_alloc(width + 1);
+		ml->style = linepool_alloc(width + 1);
+		c->ndecoded++;
+		if (!ml->image || !ml->style || !(ip = decode_line(ip, end, ml, width)))
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ * Append a line of width cells as the newest one. Returns -1 if there
+ * is no memory for it.
+ */
+int histpack_push(HistPack *hp, const struct mline *ml, int width)
+{
+	if (hp->nstage == HISTPACK_BLOCK && seal(hp))
+		return -1;
+	if (grow(&hp->stage, &hp->stagemax, hp->stagelen + LINEBOUND(width)))
+		return -1;
+	if (!hp->stageid)
+		hp->stageid = ++nextid;
+	hp->stagelen += encode_line(hp->stage + hp->stagelen, ml, width);
+	hp->stageoff[++hp->nstage] = hp->stagelen;
+	hp->lines++;
+	return 0;
+}
+
+/* Remove the newest line. */
+void histpack_pop(HistPack *hp)
+{
+	if (hp->lines <= 1 || (hp->nstage == 0 && unseal(hp))) {
+		histpack_free(hp);
+		return;
+	}
+	hp->nstage--;
+	hp->stagelen = hp->stageoff[hp->nstage];
+	hp->lines--;
+	for (int i = 0; i < HISTPACK_CACHE; i++)
+		if (cache[i].id == hp->stageid)
+			cache_release(&cache[i], hp->nstage);
+}
+
+/* Remove the n oldest lines. */
+void histpack_drop(HistPack *hp, int n)
+{
+	if (n >= hp->lines) {
+		histpack_free(hp);
+		return;
+	}
+	hp->skip += n;
+	hp->lines -= n;
+	while (hp->nblocks && hp->skip >= HISTPACK_BLOCK) {
+		struct hpblock *b = *block_at(hp, 0);
+
+		if (b->off >= 0) {
+			hp->nspilled--;
+			hp->spill->dead = b->off + sizeof(struct hprecord) + b->len;
+		} else
+			hp->memsize -= b->len;
+		free(b);
+		hp->first = (hp->first + 1) % hp->maxblocks;
+		hp->nblocks--;
+		hp->skip -= HISTPACK_BLOCK;
+	}
+	if (hp->spill && hp->spill->dead)
+		spill_compact(hp);
+}
+
+/*
+ * Line y, counted from the oldest line, laid out for width cells, or as
+ * wide as it was stored if width is 0. The line stays valid until
+ * HISTPACK_CACHE other blocks have been read or the pack changes.
+ * Returns NULL if it cannot be decoded.
+ */
+struct mline *histpack_line(HistPack *hp, int y, int width)
+{
+	struct hpblock *b = NULL;
+	struct hpcache *c = NULL;
+	uint64_t id = hp->stageid;
+	int i;
+
+	if (y < 0 || y >= hp->lines)
+		return NULL;
+	y += hp->skip;
+	if (y / HISTPACK_BLOCK < hp->nblocks) {
+		b = *block_at(hp, y / HISTPACK_BLOCK);
+		id = b->id;
+	}
+	y %= HISTPACK_BLOCK;
+	for (i = 0; i < HISTPACK_CACHE && !c; i++)
+		if (cache[i].id == id && cache[i].width == width)
+			c = &cache[i];
+	/* an entry read while its block was staged may not be complete */
+	if (!c || (b && c->ndecoded < HISTPACK_BLOCK)) {
+		if (!c) {
+			c = &cache[0];
+			for (i = 1; i < HISTPACK_CACHE; i++)
+				if (cache[i].used < c->used)
+					c = &cache[i];
+		}
+		cache_release(c, 0);
+		c->id = id;
+		c->width = width;
+		if (b) {
+			const unsigned char *data = block_data(hp, b);
+
+			if (!data || cache_decode(c, data, data + b->rawlen, HISTPACK_BLOCK - 1)) {
+				cache_release(c, 0);
+				return NULL;
+			}
+		}
+	}
+	c->used = ++ticks;
+	if (!b && y >= c->ndecoded
+	    && cache_decode(c, hp->stage + hp->stageoff[c->ndecoded], hp->stage + hp->stagelen, y)) {
+		cache_release(c, 0);
+		return NULL;
+	}
+	return &c->lines[y];
+}
+
+/*
+ * Cells line y of hp adds to the line it is a part of: all it was stored
+ * with if that goes on in the next one, else up to the last that is not
+ * blank. A line that cannot be decoded adds none.
+ */
+static int cells(HistPack *hp, int y, bool last)
+{
+	struct mline *ml = histpack_line(hp, y, 0);
+	int l;
+
+	if (!ml)
+		return 0;
+	l = linepool_len(ml->image) - 1;
+	if (last)
+		while (l > 0 && ml->image[l - 1] == ' ' && !ml->style[l - 1])
+			l--;
+	return l;
+}
+
+/*
+ * Rewrap the lines of hp to width cells, the way ChangeWindowSize does
+ * with the screen: lines that go on in the next one are put together
+ * with it and split up again. Returns -1 if there is no memory for it,
+ * hp is left as it was then.
+ */
+int histpack_rewrap(HistPack *hp, int width)
+{
+	HistPack n = { 0 };
+	struct mline row, *ml;
+	uint32_t wrap;
+	int y, ys, ye, l, lf, lt, lx, c;
+
+	row.image = linepool_alloc(width + 1);
+	row.style = linepool_alloc(width + 1);
+	if (!row.image || !row.style)
+		goto nomem;
+	for (ys = 0; ys < hp->lines; ys = ye + 1) {
+		for (ye = ys; (ml = histpack_line(hp, ye, 0)); ye++)
+			if (ye == hp->lines - 1 || ml->image[linepool_len(ml->image) - 1] == ' ')
+				break;
+		/* the newest line keeps saying if it goes on, on the screen */
+		wrap = ml ? ml->image[linepool_len(ml->image) - 1] : ' ';
+		for (l = 0, y = ys; y <= ye; y++)
+			l += cells(hp, y, y == ye);
+		y = ys;
+		lf = 0;
+		do {
+			for (lt = 0; lt < width; lt++) {
+				row.image[lt] = ' ';
+				row.style[lt] = 0;
+			}
+			for (lt = 0; lt < width && l > 0; lt += lx) {
+				if (lf == (c = cells(hp, y, y == ye))) {
+					y++;
+					lf = 0;
+					lx = 0;
+					continue;
+				}
+				ml = histpack_line(hp, y, 0);
+				lx = c - lf < width - lt ? c - lf : width - lt;
+				memcpy(row.image + lt, ml->image + lf, lx * sizeof(uint32_t));
+				memcpy(row.style + lt, ml->style + lf, lx * sizeof(uint32_t));
+				lf += lx;
+				l -= lx;
+			}
+			row.image[width] = l ? 0 : wrap;
+			if (histpack_push(&n, &row, width))
+				goto nomem;
+		} while (l > 0);
+	}
+	linepool_free(row.image);
+	linepool_free(row.style);
+	histpack_free(hp);
+	*hp = n;
+	return 0;
+
+ nomem:
+	linepool_free(row.image);
+	linepool_free(row.style);
+	histpack_free(&n);
+	return -1;
+}
+
+/* Memory used by hp, not counting the cache and the spill file. */
+size_t histpack_size(const HistPack *hp)
+{
+	return hp->stagemax + hp->maxblocks * sizeof(struct hpblock *)
+	    + hp->nblocks * sizeof(struct hpblock) + hp->memsize;
+}
+
+void histpack_free(HistPack *hp)
+{
+	struct hpspill *sp = hp->spill;
+
+	for (int i = 0; i < hp->nblocks; i++)
+		free(*block_at(hp, i));
+	free(hp->blocks);
+	free(hp->stage);
+	if (sp) {
+		spill_unmap(sp);
+		if (sp->fd >= 0) {
+			close(sp->fd);
+			unlink(sp->path);
+		}
+		free(sp->path);
+		free(sp);
+	}
+	*hp = (HistPack) { 0 };
+}
+
+/* Call fn on the renditions of all decoded lines, for mstyle_gc. */
+void histpack_walk(void (*fn)(uint32_t *, int))
+{
+	for (int i = 0; i < HISTPACK_CACHE; i++)
+		for (int y = 0; y < cache[i].ndecoded; y++)
+			fn(cache[i].lines[y].style, linepool_len(cache[i].lines[y].style));
+}
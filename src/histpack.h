@@ -0,0 +1,79 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#ifndef SCREEN_HISTPACK_H
+#define SCREEN_HISTPACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "image.h"
+
+/*
+ * Packed store for the older part of the history. Lines are encoded
+ * with their trailing blanks cut off and their renditions as runs, and
+ * collected into blocks that are compressed with lz once full. Reading
+ * a line decodes its whole block into a small cache shared by all
+ * windows, so lines can be fetched one after the other, as copy mode
+ * and searching do, without decoding every time.
+ *
+ * Once the blocks of a pack take more than histpack_memlimit bytes, the
+ * oldest ones are appended to a spill file and read back through mmap.
+ */
+
+#define HISTPACK_BLOCK	64	/* lines per block */
+#define HISTPACK_CACHE	8	/* decoded blocks kept */
+
+struct hpblock;
+struct hpspill;
+
+typedef struct HistPack HistPack;
+struct HistPack {
+	struct hpblock **blocks;	/* ring of full blocks, oldest first */
+	int first;			/* index of the oldest block */
+	int nblocks;
+	int maxblocks;
+	int skip;			/* lines dropped from the oldest block */
+	int lines;			/* lines stored */
+	unsigned char *stage;		/* encoded lines of the newest block */
+	size_t stagelen;
+	size_t stagemax;
+	size_t stageoff[HISTPACK_BLOCK + 1];	/* where each staged line starts */
+	int nstage;			/* lines staged */
+	uint64_t stageid;		/* id the staged block will get */
+	int nspilled;			/* oldest blocks that are in the spill file */
+	size_t memsize;			/* bytes of the blocks in memory */
+	struct hpspill *spill;
+};
+
+extern size_t histpack_memlimit;	/* 0 keeps all blocks in memory */
+extern bool histpack_sync;		/* fsync spill files after each block */
+extern const char *histpack_spillpath;	/* spill files are named after it */
+
+int            histpack_push(HistPack *, const struct mline *, int);
+void           histpack_pop(HistPack *);
+void           histpack_drop(HistPack *, int);
+struct mline  *histpack_line(HistPack *, int, int);
+int            histpack_rewrap(HistPack *, int);
+size_t         histpack_size(const HistPack *);
+void           histpack_free(HistPack *);
+void           histpack_walk(void (*)(uint32_t *, int));
+
+#endif /* SCREEN_HISTPACK_H */
@@ -30,6 +30,7 @@
 #ifndef SCREEN_IMAGE_H
 #define SCREEN_IMAGE_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 /* structure representing single cell of terminal */
@@ -43,51 +44,68 @@ struct mchar {
 	uint32_t mbcs;		/* used for multi byte character sets; TODO: possible to remove? use image now that it has 32 bits*/
 };
 
+/* rendition of a cell, interned in mstyles */
+struct mstyle {
+	uint32_t attr;
+	uint32_t font;
+	uint32_t fontx;
+	uint32_t colorbg;
+	uint32_t colorfg;
+};
+
+/* line of cells, 8 bytes each */
 struct mline {
 	uint32_t *image;
-	uint32_t *attr;
-	uint32_t *font;
-	uint32_t *fontx;
-	uint32_t *colorbg;
-	uint32_t *colorfg;
+	uint32_t *style;	/* index into mstyles, null if all cells have the default rendition */
 };
 
+/* table of all renditions in use, index 0 is the default rendition */
+extern struct mstyle *mstyles;
+extern bool mstyle_gcdue;
+extern uint32_t mstyle_last;
+
+uint32_t mstyle_intern(const struct mchar *);
+void     mstyle_gc(void (*)(void (*)(uint32_t *, int)));
+
+/* whether style s is the rendition of mc */
+static inline bool mstyle_match(uint32_t s, const struct mchar *mc)
+{
+	const struct mstyle *st = &mstyles[s];
+
+	return st->attr == mc->attr && st->font == mc->font && st->fontx == mc->fontx
+	    && st->colorbg == mc->colorbg && st->colorfg == mc->colorfg;
+}
+
+/* index of the rendition of mc */
+static inline uint32_t mstyle_of(const struct mchar *mc)
+{
+	if ((mc->attr | mc->font | mc->fontx | mc->colorbg | mc->colorfg) == 0)
+		return 0;
+	if (mstyle_match(mstyle_last, mc))
+		return mstyle_last;
+	return mstyle_intern(mc);
+}
 
+#define mline_style(ml, x) (&mstyles[(ml)->style[x]])
 
 #define save_mline(ml, n) {					\
-	memmove(mline_old.image,   (ml)->image,   (n) * 4);	\
-	memmove(mline_old.attr,    (ml)->attr,    (n) * 4);	\
-	memmove(mline_old.font,    (ml)->font,    (n) * 4);	\
-	memmove(mline_old.fontx,   (ml)->fontx,   (n) * 4);	\
-	memmove(mline_old.colorbg, (ml)->colorbg, (n) * 4);	\
-	memmove(mline_old.colorfg, (ml)->colorfg, (n) * 4);	\
+	memmove(mline_old.image, (ml)->image, (n) * 4);		\
+	memmove(mline_old.style, (ml)->style, (n) * 4);		\
 }
 
 #define copy_mline(ml, xf, xt, n) {					\
-	memmove((ml)->image   + (xt), (ml)->image   + (xf), (n) * 4);	\
-	memmove((ml)->attr    + (xt), (ml)->attr    + (xf), (n) * 4);	\
-	memmove((ml)->font    + (xt), (ml)->font    + (xf), (n) * 4);	\
-	memmove((ml)->fontx   + (xt), (ml)->fontx   + (xf), (n) * 4);	\
-	memmove((ml)->colorbg + (xt), (ml)->colorbg + (xf), (n) * 4);	\
-	memmove((ml)->colorfg + (xt), (ml)->colorfg + (xf), (n) * 4);	\
+	memmove((ml)->image + (xt), (ml)->image + (xf), (n) * 4);	\
+	memmove((ml)->style + (xt), (ml)->style + (xf), (n) * 4);	\
 }
 
 #define clear_mline(ml, x, n) {							\
 	memmove((ml)->image + (x), blank, (n) * 4);				\
-	if ((ml)->attr    != null) memset((ml)->attr    + (x), 0, (n) * 4);	\
-	if ((ml)->font    != null) memset((ml)->font    + (x), 0, (n) * 4);	\
-	if ((ml)->fontx   != null) memset((ml)->fontx   + (x), 0, (n) * 4);	\
-	if ((ml)->colorbg != null) memset((ml)->colorbg + (x), 0, (n) * 4);	\
-	if ((ml)->colorfg != null) memset((ml)->colorfg + (x), 0, (n) * 4);	\
+	if ((ml)->style != null) memset((ml)->style + (x), 0, (n) * 4);	\
 }
 
 #define cmp_mline(ml1, ml2, x) (			\
-	   (ml1)->image[x]   == (ml2)->image[x]		\
-	&& (ml1)->attr[x]    == (ml2)->attr[x]		\
-	&& (ml1)->font[x]    == (ml2)->font[x]		\
-	&& (ml1)->fontx[x]   == (ml2)->fontx[x]		\
-	&& (ml1)->colorbg[x] == (ml2)->colorbg[x]	\
-	&& (ml1)->colorfg[x] == (ml2)->colorfg[x]	\
+	   (ml1)->image[x] == (ml2)->image[x]		\
+	&& (ml1)->style[x] == (ml2)->style[x]		\
 )
 
 #define cmp_mchar(mc1, mc2) (				\
@@ -100,30 +118,23 @@ struct mline {
 )
 
 #define cmp_mchar_mline(mc, ml, x) (			\
-	   (mc)->image   == (ml)->image[x]		\
-	&& (mc)->attr    == (ml)->attr[x]		\
-	&& (mc)->font    == (ml)->font[x]		\
-	&& (mc)->fontx   == (ml)->fontx[x]		\
-	&& (mc)->colorbg == (ml)->colorbg[x]		\
-	&& (mc)->colorfg == (ml)->colorfg[x]		\
+	   (mc)->image == (ml)->image[x]		\
+	&& mstyle_match((ml)->style[x], mc)		\
 )
 
 #define copy_mchar2mline(mc, ml, x) {			\
-	(ml)->image[x]   = (mc)->image;			\
-	(ml)->attr[x]    = (mc)->attr;			\
-	(ml)->font[x]    = (mc)->font;			\
-	(ml)->fontx[x]   = (mc)->fontx;			\
-	(ml)->colorbg[x] = (mc)->colorbg;		\
-	(ml)->colorfg[x] = (mc)->colorfg;		\
+	(ml)->image[x] = (mc)->image;			\
+	(ml)->style[x] = mstyle_of(mc);			\
 }
 
 #define copy_mline2mchar(mc, ml, x) {			\
+	const struct mstyle *st_ = mline_style(ml, x);	\
 	(mc)->image   = (ml)->image[x];			\
-	(mc)->attr    = (ml)->attr[x];			\
-	(mc)->font    = (ml)->font[x];			\
-	(mc)->fontx   = (ml)->fontx[x];			\
-	(mc)->colorbg = (ml)->colorbg[x];		\
-	(mc)->colorfg = (ml)->colorfg[x];		\
+	(mc)->attr    = st_->attr;			\
+	(mc)->font    = st_->font;			\
+	(mc)->fontx   = st_->fontx;			\
+	(mc)->colorbg = st_->colorbg;			\
+	(mc)->colorfg = st_->colorfg;			\
 	(mc)->mbcs    = 0;				\
 }
 
@@ -51,17 +51,76 @@ static struct mline *mlineoffset(const struct mline *ml, const int offset)
 	if (ml == 0)
 		return 0;
 	mml.image = ml->image + offset;
-	mml.attr = ml->attr + offset;
-	mml.font = ml->font + offset;
-	mml.fontx = ml->fontx + offset;
-	mml.colorbg = ml->colorbg + offset;
-	mml.colorfg = ml->colorfg + offset;
+	mml.style = ml->style + offset;
 	return &mml;
 }
 
 #define RECODE_MCHAR(mc) ((l->l_encoding == UTF8) != (D_encoding == UTF8) ? recode_mchar(mc, l->l_encoding, D_encoding) : (mc))
 #define RECODE_MLINE(ml) ((l->l_encoding == UTF8) != (D_encoding == UTF8) ? recode_mline(ml, l->l_width, l->l_encoding, D_encoding) : (ml))
 
+/* Whether l is a window in a synchronized update, see WinSyncUpdate. */
+static bool LaySynced(Layer *l)
+{
+	return l->l_layfn == &WinLf && ((Window *)l->l_data)->w_sync;
+}
+
+/*
+ * Whether drawing a region of the layer to a canvas has to be left out
+ * for now: while the layer is paused split canvases are refreshed once
+ * it is unpaused, and a display that waits for its next frame or for a
+ * synchronized update to end records the region as damage to be redrawn
+ * then.
+ */
+
+static bool LayDefer(Layer *l, Canvas *cv, int xs, int xe, int ys, int ye)
+{
+	bool toedge = xe >= l->l_width - 1;
+
+	if (l->l_pause.d && cv->c_slorient)
+		return true;
+	display = cv->c_display;
+	if (D_blocked || !(LaySynced(l) || DisplayDeferred()))
+		return false;
+	for (Viewport *vp = cv->c_vplist; vp; vp = vp->v_next) {
+		int xs2 = xs + vp->v_xoff;
+		int xe2 = toedge ? vp->v_xe : xe + vp->v_xoff;
+		int ys2 = ys + vp->v_yoff;
+		int ye2 = ye + vp->v_yoff;
+
+		if (xs2 < vp->v_xs)
+			xs2 = vp->v_xs;
+		if (xe2 > vp->v_xe)
+			xe2 = vp->v_xe;
+		if (ys2 < vp->v_ys)
+			ys2 = vp->v_ys;
+		if (ye2 > vp->v_ye)
+			ye2 = vp->v_ye;
+		if (DisplayDamage(xs2, xe2, ys2, ye2))
+			return false;	/* no memory, draw it right away */
+	}
+	return true;
+}
+
+/*
+ * Scroll the split canvases of a paused layer right away when all of
+ * their displays can do it with left/right margins. The damage
+ * collected so far moves along with the lines.
+ */
+static bool LayPauseScroll(Layer *l, int n, int ys, int ye)
+{
+	for (Canvas *cv = l->l_cvlist; cv; cv = cv->c_lnext) {
+		if (!cv->c_slorient)
+			continue;
+		display = cv->c_display;
+		if (D_blocked || LaySynced(l) || DisplayDeferred())
+			return false;
+		for (Viewport *vp = cv->c_vplist; vp; vp = vp->v_next)
+			if (!CanScrollCols(vp->v_xs, vp->v_xe, n))
+				return false;
+	}
+	return damage_scroll(&l->l_pause.region, ys, ye, n) == 0;
+}
+
 void LGotoPos(Layer *l, int x, int y)
 {
 	int x2, y2;
@@ -70,7 +129,7 @@ void LGotoPos(Layer *l, int x, int y)
 		LayPauseUpdateRegion(l, x, x, y, y);
 
 	for (Canvas *cv = l->l_cvlist; cv; cv = cv->c_lnext) {
-		if (l->l_pause.d && cv->c_slorient)
+		if (LayDefer(l, cv, x, x, y, y))
 			continue;
 		display = cv->c_display;
 		if (D_blocked)
@@ -107,7 +166,7 @@ void LScrollH(Layer *l, int n, int y, int xs, int xe, int bce, struct mline *ol)
 	if (l->l_pause.d)
 		LayPauseUpdateRegion(l, xs, xe, y, y);
 	for (Canvas *cv = l->l_cvlist; cv; cv = cv->c_lnext) {
-		if (l->l_pause.d && cv->c_slorient)
+		if (LayDefer(l, cv, xs, xe, y, y))
 			continue;
 		for (Viewport *vp = cv->c_vplist; vp; vp = vp->v_next) {
 			y2 = y + vp->v_yoff;
@@ -147,12 +206,13 @@ void LScrollH(Layer *l, int n, int y, int xs, int xe, int bce, struct mline *ol)
 void LScrollV(Layer *l, int n, int ys, int ye, int bce)
 {
 	int ys2, ye2, xs2, xe2;
+	bool now = false;
 	if (n == 0)
 		return;
-	if (l->l_pause.d)
+	if (l->l_pause.d && !(now = LayPauseScroll(l, n, ys, ye)))
 		LayPauseUpdateRegion(l, 0, l->l_width - 1, ys, ye);
 	for (Canvas *cv = l->l_cvlist; cv; cv = cv->c_lnext) {
-		if (l->l_pause.d && cv->c_slorient)
+		if (!(now && cv->c_slorient) && LayDefer(l, cv, 0, l->l_width - 1, ys, ye))
 			continue;
 		for (Viewport *vp = cv->c_vplist; vp; vp = vp->v_next) {
 			xs2 = vp->v_xoff;
@@ -201,7 +261,7 @@ void LInsChar(Layer *l, struct mchar *c, int x, int y, struct mline *ol)
 	if (l->l_pause.d)
 		LayPauseUpdateRegion(l, x, l->l_width - 1, y, y);
 	for (Canvas *cv = l->l_cvlist; cv; cv = cv->c_lnext) {
-		if (l->l_pause.d && cv->c_slorient)
+		if (LayDefer(l, cv, x, l->l_width - 1, y, y))
 			continue;
 		for (Viewport *vp = cv->c_vplist; vp; vp = vp->v_next) {
 			y2 = y + vp->v_yoff;
@@ -248,7 +308,7 @@ void LPutChar(Layer *l, struct mchar *c, int x, int y)
 				     , y, y);
 
 	for (Canvas *cv = l->l_cvlist; cv; cv = cv->c_lnext) {
-		if (l->l_pause.d && cv->c_slorient)
+		if (LayDefer(l, cv, x, x + (c->mbcs ? 1 : 0), y, y))
 			continue;
 		display = cv->c_display;
 		if (D_blocked)
@@ -277,7 +337,7 @@ void LPutStr(Layer *l, char *s, int n, struct mchar *r, int x, int y)
 		LayPauseUpdateRegion(l, x, x + n - 1, y, y);
 
 	for (Canvas *cv = l->l_cvlist; cv; cv = cv->c_lnext) {
-		if (l->l_pause.d && cv->c_slorient)
+		if (LayDefer(l, cv, x, x + n - 1, y, y))
 			continue;
 		for (Viewport *vp = cv->c_vplist; vp; vp = vp->v_next) {
 			y2 = y + vp->v_yoff;
@@ -306,8 +366,7 @@ void LPutStr(Layer *l, char *s, int n, struct mchar *r, int x, int y)
 				}
 				continue;
 			}
-			while (xs2++ <= xe2)
-				PUTCHARLP(*s2++);
+			PUTSTRLP(s2, xe2 - xs2 + 1);
 		}
 	}
 }
@@ -325,7 +384,7 @@ void LPutWinMsg(Layer *l, char *s, int n, struct mchar *r, int x, int y)
 	if (len > n)
 		len = n;
 	for (Canvas *cv = l->l_cvlist; cv; cv = cv->c_lnext) {
-		if (l->l_pause.d && cv->c_slorient)
+		if (LayDefer(l, cv, x, x + n - 1, y, y))
 			continue;
 		for (Viewport *vp = cv->c_vplist; vp; vp = vp->v_next) {
 			y2 = y + vp->v_yoff;
@@ -372,7 +431,7 @@ void LClearLine(Layer *l, int y, int xs, int xe, int bce, struct mline *ol)
 	if (l->l_pause.d)
 		LayPauseUpdateRegion(l, xs, xe, y, y);
 	for (Canvas *cv = l->l_cvlist; cv; cv = cv->c_lnext) {
-		if (l->l_pause.d && cv->c_slorient)
+		if (LayDefer(l, cv, xs, xe, y, y))
 			continue;
 		for (Viewport *vp = cv->c_vplist; vp; vp = vp->v_next) {
 			xs2 = xs + vp->v_xoff;
@@ -410,7 +469,7 @@ void LClearArea(Layer *l, int xs, int ys, int xe, int ye, int bce, int uself)
 	if (l->l_pause.d)
 		LayPauseUpdateRegion(l, xs, xe, ys, ye);
 	for (Canvas *cv = l->l_cvlist; cv; cv = cv->c_lnext) {
-		if (l->l_pause.d && cv->c_slorient)
+		if (LayDefer(l, cv, ys == ye ? xs : 0, ys == ye ? xe : l->l_width - 1, ys, ye))
 			continue;
 		display = cv->c_display;
 		if (D_blocked)
@@ -452,12 +511,22 @@ void LClearArea(Layer *l, int xs, int ys, int xe, int ye, int bce, int uself)
 }
 
 void LCDisplayLine(Layer *l, struct mline *ml, int y, int xs, int xe, int isblank)
+{
+	LCDisplayRow(l, ml, 0, y, xs, xe, isblank);
+}
+
+/*
+ * LCDisplayLine for a window row with generation gen, see WinRowGen.
+ * Display lines that show it unshifted and in full can be left alone
+ * while they are drawn from that generation.
+ */
+void LCDisplayRow(Layer *l, struct mline *ml, uint64_t gen, int y, int xs, int xe, int isblank)
 {
 	int xs2, xe2, y2;
 	if (l->l_pause.d)
 		LayPauseUpdateRegion(l, xs, xe, y, y);
 	for (Canvas *cv = l->l_cvlist; cv; cv = cv->c_lnext) {
-		if (l->l_pause.d && cv->c_slorient)
+		if (LayDefer(l, cv, xs, xe, y, y))
 			continue;
 		display = cv->c_display;
 		if (D_blocked)
@@ -475,8 +544,9 @@ void LCDisplayLine(Layer *l, struct mline *ml, int y, int xs, int xe, int isblan
 			if (xs2 > xe2)
 				continue;
 			display = cv->c_display;
-			DisplayLine(isblank ? &mline_blank : &mline_null, mlineoffset(RECODE_MLINE(ml), -vp->v_xoff),
-				    y2, xs2, xe2);
+			DisplayLineGen(isblank ? &mline_blank : &mline_null, mlineoffset(RECODE_MLINE(ml), -vp->v_xoff),
+				       y2, xs2, xe2,
+				       vp->v_xoff || l->l_width < D_width || l->l_encoding != D_encoding ? 0 : gen);
 		}
 	}
 }
@@ -499,7 +569,7 @@ void LSetRendition(Layer *l, struct mchar *r)
 {
 	for (Canvas *cv = l->l_cvlist; cv; cv = cv->c_lnext) {
 		display = cv->c_display;
-		if (D_blocked)
+		if (D_blocked || LaySynced(l) || DisplayDeferred())
 			continue;
 		SetRendition(r);
 	}
@@ -524,7 +594,7 @@ void LWrapChar(Layer *l, struct mchar *c, int y, int top, int bot, bool ins)
 		yy = y == l->l_height - 1 ? y : y + 1;
 
 		for (Canvas *cv = l->l_cvlist; cv; cv = cv->c_lnext) {
-			if (l->l_pause.d && cv->c_slorient)
+			if (LayDefer(l, cv, 0, l->l_width - 1, y, yy))
 				continue;
 			y2 = 0;	/* gcc -Wall */
 			display = cv->c_display;
@@ -567,7 +637,7 @@ void LWrapChar(Layer *l, struct mchar *c, int y, int top, int bot, bool ins)
 		/* hard case: scroll up */
 
 		for (Canvas *cv = l->l_cvlist; cv; cv = cv->c_lnext) {
-			if (l->l_pause.d && cv->c_slorient)
+			if (LayDefer(l, cv, 0, l->l_width - 1, top, bot))
 				continue;
 			display = cv->c_display;
 			if (D_blocked)
@@ -865,7 +935,8 @@ void ExitOverlayPage()
 	flayer = oldlay->l_next;
 	if (flayer->l_layfn == &WinLf) {
 		if (oldlay->l_blocking) {
-			p->w_blocked--;
+			if (!--p->w_blocked)
+				WakeWindow(p);
 		}
 		/* don't warp dead layers: check cvlist */
 		if (p->w_blocked && p->w_savelayer && p->w_savelayer != flayer && oldlay->l_cvlist) {
@@ -928,6 +999,8 @@ void LayProcessMouseSwitch(Layer *l, int s)
 void LayPause(Layer *layer, int pause)
 {
 	Window *win;
+	Damage *region;
+	bool deferred;
 
 	pause = ! !pause;
 
@@ -936,12 +1009,13 @@ void LayPause(Layer *layer, int pause)
 
 	if ((layer->l_pause.d = pause)) {
 		/* Start pausing */
-		layer->l_pause.top = layer->l_pause.bottom = -1;
+		damage_clear(&layer->l_pause.region);
 		return;
 	}
 
 	/* Unpause. So refresh the regions in the displays! */
-	if (layer->l_pause.top == -1 && layer->l_pause.bottom == -1)
+	region = &layer->l_pause.region;
+	if (damage_empty(region))
 		return;
 
 	if (layer->l_layfn == &WinLf)	/* Currently, this will always be the case! */
@@ -954,14 +1028,15 @@ void LayPause(Layer *layer, int pause)
 			continue;	/* Wasn't split, so already updated. */
 
 		display = cv->c_display;
+		deferred = LaySynced(layer) || DisplayDeferred();
 
 		for (Viewport *vp = cv->c_vplist; vp; vp = vp->v_next) {
-			for (int line = layer->l_pause.top; line <= layer->l_pause.bottom; line++) {
+			for (int line = region->top; line <= region->bottom; line++) {
 				int xs, xe;
 
 				if (line + vp->v_yoff >= vp->v_ys && line + vp->v_yoff <= vp->v_ye &&
-				    ((xs = layer->l_pause.left[line]) >= 0) &&
-				    ((xe = layer->l_pause.right[line]) >= 0)) {
+				    ((xs = region->left[line]) >= 0) &&
+				    ((xe = region->right[line]) >= 0)) {
 					xs += vp->v_xoff;
 					xe += vp->v_xoff;
 
@@ -970,19 +1045,23 @@ void LayPause(Layer *layer, int pause)
 					if (xe > vp->v_xe)
 						xe = vp->v_xe;
 
-					if (layer->l_encoding == UTF8 && xe < vp->v_xe && win) {
+					/* ml is indexed in window, not display, columns */
+					if (layer->l_encoding == UTF8 && xe < vp->v_xe && win &&
+					    xe - vp->v_xoff + 1 < win->w_width) {
 						struct mline *ml = win->w_mlines + line;
-						if (dw_left(ml, xe, UTF8))
+						if (dw_left(ml, xe - vp->v_xoff, UTF8))
 							xe++;
 					}
 
-					if (xs <= xe)
+					if (xs > xe)
+						continue;
+					if (!deferred || DisplayDamage(xs, xe, line + vp->v_yoff, line + vp->v_yoff))
 						RefreshLine(line + vp->v_yoff, xs, xe, 0);
 				}
 			}
 		}
 
-		if (cv == D_forecv) {
+		if (cv == D_forecv && !deferred) {
 			int cx = layer->l_x + cv->c_xoff;
 			int cy = layer->l_y + cv->c_yoff;
 
@@ -999,50 +1078,21 @@ void LayPause(Layer *layer, int pause)
 		}
 	}
 
-	for (int line = layer->l_pause.top; line <= layer->l_pause.bottom; line++)
-		layer->l_pause.left[line] = layer->l_pause.right[line] = -1;
+	damage_clear(region);
 }
 
 void LayPauseUpdateRegion(Layer *layer, int xs, int xe, int ys, int ye)
 {
 	if (!layer->l_pause.d)
 		return;
-	if (ys < 0)
-		ys = 0;
 	if (ye >= layer->l_height)
 		ye = layer->l_height - 1;
 	if (xe >= layer->l_width)
 		xe = layer->l_width - 1;
-
-	if (layer->l_pause.top == -1 || layer->l_pause.top > ys)
-		layer->l_pause.top = ys;
-	if (layer->l_pause.bottom < ye) {
-		layer->l_pause.bottom = ye;
-		if (layer->l_pause.lines <= ye) {
-			int o = layer->l_pause.lines;
-			layer->l_pause.lines = ye + 32;
-			layer->l_pause.left = realloc(layer->l_pause.left, sizeof(int) * layer->l_pause.lines);
-			layer->l_pause.right = realloc(layer->l_pause.right, sizeof(int) * layer->l_pause.lines);
-			while (o < layer->l_pause.lines) {
-				layer->l_pause.left[o] = layer->l_pause.right[o] = -1;
-				o++;
-			}
-		}
-	}
-
-	while (ys <= ye) {
-		if (layer->l_pause.left[ys] == -1 || layer->l_pause.left[ys] > xs)
-			layer->l_pause.left[ys] = xs;
-		if (layer->l_pause.right[ys] < xe)
-			layer->l_pause.right[ys] = xe;
-		ys++;
-	}
+	damage_add(&layer->l_pause.region, xs, xe, ys, ye);
 }
 
 void LayerCleanupMemory(Layer *layer)
 {
-	if (layer->l_pause.left)
-		free(layer->l_pause.left);
-	if (layer->l_pause.right)
-		free(layer->l_pause.right);
+	damage_free(&layer->l_pause.region);
 }
@@ -31,8 +31,11 @@
 #define SCREEN_LAYER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
+#include "damage.h"
+
 /*
  * This is the overlay structure. It is used to create a seperate
  * layer over the current windows.
@@ -81,11 +84,7 @@ struct Layer {
 
 	struct {
 		int d : 1;		/* Is the output for the layer blocked? */
-
-		/* After unpausing, what region should we refresh? */
-		int *left, *right;
-		int top, bottom;
-		int lines;
+		Damage region;		/* what to refresh after unpausing */
 	} l_pause;
 };
 
@@ -173,6 +172,7 @@ void  LClearArea (Layer *, int, int, int, int, int, int);
 void  LClearLine (Layer *, int, int, int, int, struct mline *);
 void  LRefreshAll (Layer *, int);
 void  LCDisplayLine (Layer *, struct mline *, int, int, int, int);
+void  LCDisplayRow (Layer *, struct mline *, uint64_t, int, int, int, int);
 void  LCDisplayLineWrap (Layer *, struct mline *, int, int, int, int);
 void  LSetRendition (Layer *, struct mchar *);
 void  LWrapChar  (Layer *, struct mchar *, int, int, int, bool);
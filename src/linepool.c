@@ -0,0 +1,130 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include "config.h"
+
+#include "linepool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* sits in front of every array; next is used while it is on a free list */
+struct lphdr {
+	struct lphdr *next;
+	size_t len;
+};
+
+static struct lpwidth {
+	size_t len;
+	int nfree;
+	unsigned long used;	/* last time this list was touched */
+	struct lphdr *free;
+} pools[LINEPOOL_WIDTHS];
+
+static unsigned long lpclock;
+
+struct linepool_stats linepool_stats;
+
+static void lp_release(struct lpwidth *p)
+{
+	struct lphdr *h;
+
+	while ((h = p->free)) {
+		p->free = h->next;
+		free(h);
+		linepool_stats.releases++;
+	}
+	p->nfree = 0;
+	p->len = 0;
+}
+
+static struct lpwidth *lp_find(size_t len)
+{
+	for (int i = 0; i < LINEPOOL_WIDTHS; i++)
+		if (pools[i].len == len) {
+			pools[i].used = ++lpclock;
+			return &pools[i];
+		}
+	return 0;
+}
+
+/*
+ * Zeroed array of len cells, or NULL if no memory is available. It must
+ * be given back with linepool_free.
+ */
+uint32_t *linepool_alloc(int len)
+{
+	struct lpwidth *p;
+	struct lphdr *h;
+
+	linepool_stats.allocs++;
+	if ((p = lp_find(len)) && (h = p->free)) {
+		p->free = h->next;
+		p->nfree--;
+		memset(h + 1, 0, len * sizeof(uint32_t));
+	} else {
+		linepool_stats.mallocs++;
+		if (!(h = calloc(1, sizeof(struct lphdr) + len * sizeof(uint32_t))))
+			return 0;
+	}
+	h->len = len;
+	return (uint32_t *)(h + 1);
+}
+
+void linepool_free(uint32_t *a)
+{
+	struct lphdr *h;
+	struct lpwidth *p;
+
+	if (!a)
+		return;
+	linepool_stats.frees++;
+	h = (struct lphdr *)a - 1;
+	if (!(p = lp_find(h->len))) {
+		/* take over the list that was used longest ago */
+		p = &pools[0];
+		for (int i = 1; i < LINEPOOL_WIDTHS; i++)
+			if (pools[i].used < p->used)
+				p = &pools[i];
+		lp_release(p);
+		p->len = h->len;
+		p->used = ++lpclock;
+	}
+	if (p->nfree >= LINEPOOL_KEEP) {
+		free(h);
+		linepool_stats.releases++;
+		return;
+	}
+	h->next = p->free;
+	p->free = h;
+	p->nfree++;
+}
+
+/* number of cells a was allocated with */
+int linepool_len(const uint32_t *a)
+{
+	return ((const struct lphdr *)a - 1)->len;
+}
+
+/* give all kept arrays back to malloc */
+void linepool_flush(void)
+{
+	for (int i = 0; i < LINEPOOL_WIDTHS; i++)
+		lp_release(&pools[i]);
+}
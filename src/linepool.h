@@ -0,0 +1,49 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#ifndef SCREEN_LINEPOOL_H
+#define SCREEN_LINEPOOL_H
+
+#include <stdint.h>
+
+/*
+ * Allocator for the per-cell arrays of window lines. Freed arrays are
+ * kept on a free list for their length, so scrolling hands the storage
+ * of the line going into the history straight to the next colored line
+ * instead of going through malloc.
+ */
+
+#define LINEPOOL_WIDTHS	4	/* array lengths with a free list */
+#define LINEPOOL_KEEP	256	/* arrays kept per length */
+
+struct linepool_stats {
+	unsigned long allocs;	/* linepool_alloc calls */
+	unsigned long mallocs;	/* ... that had to go to malloc */
+	unsigned long frees;	/* linepool_free calls */
+	unsigned long releases;	/* ... that went on to free */
+};
+
+extern struct linepool_stats linepool_stats;
+
+uint32_t *linepool_alloc(int);
+void      linepool_free(uint32_t *);
+int       linepool_len(const uint32_t *);
+void      linepool_flush(void);
+
+#endif /* SCREEN_LINEPOOL_H */
@@ -0,0 +1,155 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include "config.h"
+
+#include "lz.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define MINMATCH	4
+#define MAXOFFSET	65535
+#define HASHBITS	12
+
+static uint32_t read32(const unsigned char *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static unsigned char *put_length(unsigned char *op, size_t n)
+{
+	for (; n >= 255; n -= 255)
+		*op++ = 255;
+	*op++ = n;
+	return op;
+}
+
+/* Emit a sequence of n literals followed by a match, if mlen is not 0. */
+static unsigned char *put_sequence(unsigned char *op, const unsigned char *lit, size_t n, size_t off, size_t mlen)
+{
+	unsigned char *token = op++;
+
+	*token = (n < 15 ? n : 15) << 4;
+	if (n >= 15)
+		op = put_length(op, n - 15);
+	memcpy(op, lit, n);
+	op += n;
+	if (mlen) {
+		mlen -= MINMATCH;
+		*op++ = off & 255;
+		*op++ = off >> 8;
+		*token |= mlen < 15 ? mlen : 15;
+		if (mlen >= 15)
+			op = put_length(op, mlen - 15);
+	}
+	return op;
+}
+
+/*
+ * Compress len bytes at src to dst, which must have room for
+ * LZ_BOUND(len) bytes. Returns the compressed size.
+ */
+size_t lz_compress(const unsigned char *src, size_t len, unsigned char *dst)
+{
+	uint32_t table[1 << HASHBITS];
+	const unsigned char *ip = src, *anchor = src, *end = src + len;
+	unsigned char *op = dst;
+
+	memset(table, 0, sizeof(table));
+	while (end - ip >= MINMATCH) {
+		uint32_t seq = read32(ip);
+		uint32_t h = (seq * 2654435761u) >> (32 - HASHBITS);
+		const unsigned char *ref = src + table[h];
+		const unsigned char *mp;
+
+		table[h] = ip - src;
+		if (ref >= ip || ip - ref > MAXOFFSET || read32(ref) != seq) {
+			ip++;
+			continue;
+		}
+		for (mp = ip + MINMATCH, ref += MINMATCH; mp < end && *mp == *ref; mp++, ref++)
+			;
+		op = put_sequence(op, anchor, ip - anchor, mp - ref, mp - ip);
+		ip = anchor = mp;
+	}
+	op = put_sequence(op, anchor, end - anchor, 0, 0);
+	return op - dst;
+}
+
+static int get_length(const unsigned char **ipp, const unsigned char *end, size_t *n)
+{
+	const unsigned char *ip = *ipp;
+	unsigned char b;
+
+	do {
+		if (ip == end)
+			return -1;
+		b = *ip++;
+		*n += b;
+	} while (b == 255);
+	*ipp = ip;
+	return 0;
+}
+
+/*
+ * Decompress len bytes at src into dst, which has room for cap bytes.
+ * Returns the decompressed size, or -1 if the input is corrupt or does
+ * not fit.
+ */
+ssize_t lz_decompress(const unsigned char *src, size_t len, unsigned char *dst, size_t cap)
+{
+	const unsigned char *ip = src, *end = src + len;
+	unsigned char *op = dst, *oend = dst + cap;
+	size_t n, off;
+
+	while (ip < end) {
+		unsigned char token = *ip++;
+
+		n = token >> 4;
+		if (n == 15 && get_length(&ip, end, &n))
+			return -1;
+		if (n > (size_t)(end - ip) || n > (size_t)(oend - op))
+			return -1;
+		memcpy(op, ip, n);
+		op += n;
+		ip += n;
+		if (ip == end)
+			break;
+		if (end - ip < 2)
+			return -1;
+		off = ip[0] | ip[1] << 8;
+		ip += 2;
+		if (off == 0 || off > (size_t)(op - dst))
+			return -1;
+		n = token & 15;
+		if (n == 15 && get_length(&ip, end, &n))
+			return -1;
+		n += MINMATCH;
+		if (n > (size_t)(oend - op))
+			return -1;
+		/* the match may overlap what it produces */
+		for (const unsigned char *ref = op - off; n; n--)
+			*op++ = *ref++;
+	}
+	return op - dst;
+}
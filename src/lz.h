@@ -0,0 +1,38 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#ifndef SCREEN_LZ_H
+#define SCREEN_LZ_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * Small LZ77 codec for packing history. The format follows LZ4 blocks:
+ * a token with the literal and match lengths, the literals, and a two
+ * byte offset back into the output for the match.
+ */
+
+/* room lz_compress may need for n bytes of input */
+#define LZ_BOUND(n)	((n) + (n) / 255 + 16)
+
+size_t  lz_compress(const unsigned char *, size_t, unsigned char *);
+ssize_t lz_decompress(const unsigned char *, size_t, unsigned char *, size_t);
+
+#endif /* SCREEN_LZ_H */
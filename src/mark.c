@@ -244,7 +244,6 @@ static int rem(int x1, int y1, int x2, int y2, int redisplay, char *pt, int yend
 	uint32_t *im;
 	struct mline *ml;
 	int cf, cfx, font;
-	uint32_t *fo, *fox;
 
 	markdata->second = 0;
 	if (y2 < y1 || ((y2 == y1) && (x2 < x1))) {
@@ -284,13 +283,11 @@ static int rem(int x1, int y1, int x2, int y2, int redisplay, char *pt, int yend
 		if (dw_right(ml, j, fore->w_encoding))
 			j--;
 		im = ml->image + j;
-		fo = ml->font + j;
-		fox = ml->fontx + j;
 		font = ASCII;
 		for (; j <= to; j++) {
 			c = (unsigned char)*im++;
-			cf = (unsigned char)*fo++;
-			cfx = (unsigned char)*fox++;
+			cf = (unsigned char)mline_style(ml, j)->font;
+			cfx = (unsigned char)mline_style(ml, j)->fontx;
 			if (fore->w_encoding == UTF8) {
 				c |= cf << 8 | cfx << 16;
 				if (c == UCS_HIDDEN)
@@ -303,7 +300,6 @@ static int rem(int x1, int y1, int x2, int y2, int redisplay, char *pt, int yend
 			}
 			if (is_dw_font(cf)) {
 				c = c << 8 | (unsigned char)*im++;
-				fo++;
 				j++;
 			}
 			if (pastefont) {
@@ -1096,8 +1092,8 @@ void revto_line(int tx, int ty, int line)
 			if (t >= revst && t <= reven) {
 				mc = mchar_so;
 				if (pastefont) {
-					mc.font = ml->font[x];
-					mc.fontx = ml->fontx[x];
+					mc.font = mline_style(ml, x)->font;
+					mc.fontx = mline_style(ml, x)->fontx;
 				}
 				mc.image = ml->image[x];
 			} else
@@ -1197,8 +1193,8 @@ static void MarkRedisplayLine(int y, int xs, int xe, int isblank)
 		if (cp > sto || x > rm)
 			break;
 		if (pastefont) {
-			mchar_marked.font = ml->font[x];
-			mchar_marked.fontx = ml->fontx[x];
+			mchar_marked.font = mline_style(ml, x)->font;
+			mchar_marked.fontx = mline_style(ml, x)->fontx;
 		}
 		mchar_marked.image = ml->image[x];
 		mchar_marked.mbcs = 0;
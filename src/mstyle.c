@@ -0,0 +1,169 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include "config.h"
+
+#include "image.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The rendition table. Styles are found through an open addressing
+ * hash of their indices. Styles are never freed one by one; once the
+ * table has doubled since the last collection, mstyle_gcdue asks for
+ * mstyle_gc to run at a point where every index in use is stored in
+ * some line.
+ */
+
+#define MSTYLE_GCMIN	4096	/* no collection below this many styles */
+
+static struct mstyle mstyle_default[1];
+
+struct mstyle *mstyles = mstyle_default;
+bool mstyle_gcdue;
+uint32_t mstyle_last;		/* last style interned, checked first */
+
+static uint32_t nstyles = 1;	/* used entries of mstyles */
+static uint32_t maxstyles = 1;	/* allocated entries */
+static uint32_t *hash;		/* style indices, 0 is a free slot */
+static uint32_t hashmask;
+static uint32_t gclimit = MSTYLE_GCMIN;
+
+static uint32_t *gcmap;		/* marks, then new indices during mstyle_gc */
+
+static uint32_t style_hash(const struct mstyle *st)
+{
+	uint32_t h = st->attr;
+
+	h = h * 31 + st->font;
+	h = h * 31 + st->fontx;
+	h = h * 31 + st->colorbg;
+	h = h * 31 + st->colorfg;
+	return h * 0x9e3779b1;
+}
+
+/* Build a hash of size slots, a power of two, from the table. */
+static int rehash(uint32_t size)
+{
+	if (hash && size == hashmask + 1)
+		memset(hash, 0, size * sizeof(uint32_t));
+	else {
+		uint32_t *nhash = calloc(size, sizeof(uint32_t));
+
+		if (!nhash)
+			return -1;
+		free(hash);
+		hash = nhash;
+		hashmask = size - 1;
+	}
+	for (uint32_t i = 1; i < nstyles; i++) {
+		uint32_t h = style_hash(&mstyles[i]) & hashmask;
+
+		while (hash[h])
+			h = (h + 1) & hashmask;
+		hash[h] = i;
+	}
+	return 0;
+}
+
+/*
+ * Index of the rendition of mc, added to the table if it is new. Falls
+ * back to the default rendition if no memory is available.
+ */
+uint32_t mstyle_intern(const struct mchar *mc)
+{
+	struct mstyle st;
+	uint32_t h, i;
+
+	if (mstyle_match(mstyle_last, mc))
+		return mstyle_last;
+	st.attr = mc->attr;
+	st.font = mc->font;
+	st.fontx = mc->fontx;
+	st.colorbg = mc->colorbg;
+	st.colorfg = mc->colorfg;
+	if (hash) {
+		for (h = style_hash(&st) & hashmask; (i = hash[h]); h = (h + 1) & hashmask)
+			if (mstyle_match(i, mc))
+				return mstyle_last = i;
+	}
+	if ((nstyles + 1) * 2 > hashmask + 1 && rehash(hash ? (hashmask + 1) * 2 : 256))
+		return 0;
+	if (nstyles == maxstyles) {
+		struct mstyle *n = malloc(sizeof(struct mstyle) * maxstyles * 2);
+
+		if (!n)
+			return 0;
+		memcpy(n, mstyles, sizeof(struct mstyle) * nstyles);
+		if (mstyles != mstyle_default)
+			free(mstyles);
+		mstyles = n;
+		maxstyles *= 2;
+	}
+	i = nstyles++;
+	mstyles[i] = st;
+	for (h = style_hash(&st) & hashmask; hash[h]; h = (h + 1) & hashmask)
+		;
+	hash[h] = i;
+	if (nstyles >= gclimit)
+		mstyle_gcdue = true;
+	return mstyle_last = i;
+}
+
+static void gc_mark(uint32_t *s, int n)
+{
+	for (int i = 0; i < n; i++)
+		gcmap[s[i]] = 1;
+}
+
+static void gc_remap(uint32_t *s, int n)
+{
+	for (int i = 0; i < n; i++)
+		s[i] = gcmap[s[i]];
+}
+
+/*
+ * Drop the styles no line uses any more. walk must call its argument
+ * on every style array there is, once to mark the styles in use and
+ * once more to give them their new, compacted indices.
+ */
+void mstyle_gc(void (*walk)(void (*)(uint32_t *, int)))
+{
+	uint32_t n = 1;
+
+	mstyle_gcdue = false;
+	if (!(gcmap = calloc(nstyles, sizeof(uint32_t))))
+		return;
+	walk(gc_mark);
+	gcmap[0] = 0;
+	for (uint32_t i = 1; i < nstyles; i++)
+		if (gcmap[i]) {
+			mstyles[n] = mstyles[i];
+			gcmap[i] = n++;
+		}
+	walk(gc_remap);
+	free(gcmap);
+	gcmap = 0;
+	nstyles = n;
+	mstyle_last = 0;
+	if (hash)
+		rehash(hashmask + 1);
+	gclimit = nstyles * 2 > MSTYLE_GCMIN ? nstyles * 2 : MSTYLE_GCMIN;
+}
@@ -0,0 +1,136 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include "config.h"
+
+#include "obuf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void obuf_release(OutBuf *ob, OutBufSeg *seg)
+{
+	if (ob->spare)
+		free(seg);
+	else
+		ob->spare = seg;
+}
+
+/*
+ * Start filling a fresh tail segment. The old tail keeps what was
+ * written to it so far. Returns -1 if no memory is available.
+ */
+int obuf_grow(OutBuf *ob)
+{
+	OutBufSeg *seg;
+
+	if (ob->tail && ob->head == ob->tail && ob->rp == ob->wp) {
+		/* everything written, just start over */
+		ob->rp = ob->wp = ob->tail->data;
+		ob->free = OBUF_SEGSIZE;
+		return 0;
+	}
+	if ((seg = ob->spare))
+		ob->spare = 0;
+	else if (!(seg = malloc(sizeof(OutBufSeg))))
+		return -1;
+	seg->next = 0;
+	seg->end = 0;
+	if (ob->tail) {
+		ob->tail->end = ob->wp;
+		ob->sealed += ob->wp - ob->tail->data;
+		ob->tail->next = seg;
+	} else {
+		ob->head = seg;
+		ob->rp = seg->data;
+	}
+	ob->tail = seg;
+	ob->wp = seg->data;
+	ob->free = OBUF_SEGSIZE;
+	return 0;
+}
+
+/* number of bytes waiting to be written */
+size_t obuf_len(const OutBuf *ob)
+{
+	if (!ob->tail)
+		return 0;
+	return ob->sealed + (ob->wp - ob->tail->data) - (ob->rp - ob->head->data);
+}
+
+/*
+ * Describe up to max bytes from the start of the queue in at most n
+ * iovecs, ready for writev(). Returns the number of iovecs used.
+ */
+int obuf_iov(const OutBuf *ob, struct iovec *iov, int n, size_t max)
+{
+	int i = 0;
+
+	for (OutBufSeg *seg = ob->head; seg && i < n && max; seg = seg->next) {
+		char *start = seg == ob->head ? ob->rp : seg->data;
+		char *end = seg == ob->tail ? ob->wp : seg->end;
+		size_t len = end - start;
+
+		if (!len)
+			continue;
+		if (len > max)
+			len = max;
+		iov[i].iov_base = start;
+		iov[i].iov_len = len;
+		max -= len;
+		i++;
+	}
+	return i;
+}
+
+/* drop len bytes from the start of the queue, they have been written */
+void obuf_consume(OutBuf *ob, size_t len)
+{
+	while (len && ob->head) {
+		OutBufSeg *seg = ob->head;
+
+		if (seg == ob->tail) {
+			if (len > (size_t)(ob->wp - ob->rp))
+				len = ob->wp - ob->rp;
+			ob->rp += len;
+			return;
+		}
+		if (len < (size_t)(seg->end - ob->rp)) {
+			ob->rp += len;
+			return;
+		}
+		len -= seg->end - ob->rp;
+		ob->sealed -= seg->end - seg->data;
+		ob->head = seg->next;
+		ob->rp = ob->head->data;
+		obuf_release(ob, seg);
+	}
+}
+
+void obuf_free(OutBuf *ob)
+{
+	OutBufSeg *seg, *next;
+
+	for (seg = ob->head; seg; seg = next) {
+		next = seg->next;
+		free(seg);
+	}
+	free(ob->spare);
+	memset(ob, 0, sizeof(*ob));
+}
@@ -0,0 +1,56 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#ifndef SCREEN_OBUF_H
+#define SCREEN_OBUF_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+#define OBUF_SEGSIZE 4096	/* size of one output buffer segment */
+
+typedef struct OutBufSeg OutBufSeg;
+struct OutBufSeg {
+	OutBufSeg *next;
+	char      *end;		/* end of data, once no longer the tail */
+	char       data[OBUF_SEGSIZE];
+};
+
+/*
+ * Display output queue. Data is appended to the tail segment through
+ * wp/free (see AddChar) and written out from the head segment, so
+ * neither side ever has to move bytes around.
+ */
+typedef struct {
+	OutBufSeg *head;	/* oldest segment, written first */
+	OutBufSeg *tail;	/* segment being filled */
+	OutBufSeg *spare;	/* drained segment kept for reuse */
+	char      *rp;		/* next byte to write, in head */
+	char      *wp;		/* next byte to fill, in tail */
+	int        free;	/* bytes left in tail */
+	size_t     sealed;	/* bytes in segments before tail */
+} OutBuf;
+
+int    obuf_grow(OutBuf *);
+size_t obuf_len(const OutBuf *);
+int    obuf_iov(const OutBuf *, struct iovec *, int, size_t);
+void   obuf_consume(OutBuf *, size_t);
+void   obuf_free(OutBuf *);
+
+#endif
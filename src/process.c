@@ -52,6 +52,7 @@
 #include "encoding.h"
 #include "fileio.h"
 #include "help.h"
+#include "histpack.h"
 #include "input.h"
 #include "kmapdef.h"
 #include "layout.h"
@@ -1008,17 +1009,45 @@ void DoAction(struct action *act, int key)
 	case RC_DEFOBUFLIMIT:
 		if (ParseNum(act, &defobuflimit) == 0 && msgok)
 			OutputMsg(0, "Default limit set to %d", defobuflimit);
-		if (display && *rc_name) {
+		if (display && *rc_name)
 			D_obufmax = defobuflimit;
-			D_obuflenmax = D_obuflen - D_obufmax;
-		}
 		break;
 	case RC_OBUFLIMIT:
 		if (*args == 0)
-			OutputMsg(0, "Limit is %d, current buffer size is %d", D_obufmax, D_obuflen);
+			OutputMsg(0, "Limit is %d, current buffer size is %zu", D_obufmax, obuf_len(&D_obuf));
 		else if (ParseNum(act, &D_obufmax) == 0 && msgok)
 			OutputMsg(0, "Limit set to %d", D_obufmax);
-		D_obuflenmax = D_obuflen - D_obufmax;
+		break;
+	case RC_DEFMAXFPS:
+		if (ParseNum(act, &n))
+			break;
+		if (n > MAXFPS_MAX) {
+			OutputMsg(0, "%s: %s: at most %d frames per second", rc_name, comms[nr].name, MAXFPS_MAX);
+			break;
+		}
+		defmaxfps = n;
+		if (msgok)
+			OutputMsg(0, "Default frame rate limit set to %d", defmaxfps);
+		if (display && *rc_name)
+			D_maxfps = defmaxfps;
+		break;
+	case RC_MAXFPS:
+		if (*args == 0) {
+			if (D_maxfps)
+				OutputMsg(0, "Output is limited to %d frames per second", D_maxfps);
+			else
+				OutputMsg(0, "Output is not frame rate limited");
+			break;
+		}
+		if (ParseNum(act, &n))
+			break;
+		if (n > MAXFPS_MAX) {
+			OutputMsg(0, "%s: %s: at most %d frames per second", rc_name, comms[nr].name, MAXFPS_MAX);
+			break;
+		}
+		D_maxfps = n;
+		if (msgok)
+			OutputMsg(0, "Frame rate limit set to %d", D_maxfps);
 		break;
 	case RC_DUMPTERMCAP:
 		WriteFile(user, (char *)0, DUMP_TERMCAP);
@@ -2686,6 +2715,19 @@ void DoAction(struct action *act, int key)
 		if (ParseSwitch(act, &compacthist) == 0 && msgok)
 			OutputMsg(0, "%scompacting history lines", compacthist ? "" : "not ");
 		break;
+	case RC_HISTSPILL:
+		if (ParseNum(act, &n) == 0) {
+			histpack_memlimit = n > 0 ? (size_t)n * 1024 : 0;
+			if (msgok && n > 0)
+				OutputMsg(0, "Spilling packed history beyond %d kB per window", n);
+			else if (msgok)
+				OutputMsg(0, "Keeping all history in memory");
+		}
+		break;
+	case RC_HISTSYNC:
+		if (ParseOnOff(act, &histpack_sync) == 0 && msgok)
+			OutputMsg(0, "%ssyncing spilled history", histpack_sync ? "" : "not ");
+		break;
 	case RC_HARDCOPY_APPEND:
 		(void)ParseOnOff(act, &hardcopy_append);
 		break;
@@ -3012,6 +3054,16 @@ void DoAction(struct action *act, int key)
 		if (D_nonblock <= 0)
 			evdeq(&D_blockedev);
 		break;
+	case RC_FRAMEDROP:
+		if (ParseOnOff(act, &D_framedrop) == 0 && msgok)
+			OutputMsg(0, "Framedrop turned %s", D_framedrop ? "on" : "off");
+		break;
+	case RC_DEFFRAMEDROP:
+		if (ParseOnOff(act, &defframedrop) == 0 && msgok)
+			OutputMsg(0, "Default framedrop turned %s", defframedrop ? "on" : "off");
+		if (display && *rc_name)
+			D_framedrop = defframedrop;
+		break;
 	case RC_DEFNONBLOCK:
 		if (*args && ((args[0][0] >= '0' && args[0][0] <= '9') || args[0][0] == '.')) {
 			if (ParseNum1000(act, &defnonblock))
@@ -4404,7 +4456,7 @@ void KillWindow(Window *window)
 		if (gotone) {
 			if (window->w_zdisplay == display) {
 				D_blocked = 0;
-				D_readev.condpos = D_readev.condneg = 0;
+				evunblock(&D_readev);
 			}
 			Activate(-1);
 		}
@@ -5322,6 +5374,10 @@ int StuffKey(int i)
 	int discard = 0;
 	int keyno = i;
 
+	if (i >= KMAP_MODES) {
+		ModeReply(i);
+		return 0;
+	}
 	if (i < KMAP_KEYS && D_ESCseen) {
 		struct action *act = &D_ESCseen[i + 256];
 		if (act->nr != RC_ILLEGAL) {
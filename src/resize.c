@@ -38,6 +38,8 @@
 
 #include "screen.h"
 
+#include "histpack.h"
+#include "linepool.h"
 #include "process.h"
 #include "telnet.h"
 
@@ -55,12 +57,8 @@ static void SwapAltScreen(Window *);
 struct winsize glwz;
 
 static struct mline mline_zero = {
-	.image   = (uint32_t *)0,
-	.attr    = (uint32_t *)0,
-	.font    = (uint32_t *)0,
-	.fontx   = (uint32_t *)0,
-	.colorbg = (uint32_t *)0,
-	.colorfg = (uint32_t *)0
+	.image = (uint32_t *)0,
+	.style = (uint32_t *)0
 };
 
 /*
@@ -310,68 +308,53 @@ void ResizeLayer(Layer *l, int wi, int he, Display *norefdisp)
 static void FreeMline(struct mline *ml)
 {
 	if (ml->image)
-		free(ml->image);
-	if (ml->attr && ml->attr != null)
-		free(ml->attr);
-	if (ml->font && ml->font != null)
-		free(ml->font);
-	if (ml->fontx && ml->fontx != null)
-		free(ml->fontx);
-	if (ml->colorbg && ml->colorbg != null)
-		free(ml->colorbg);
-	if (ml->colorfg && ml->colorfg != null)
-		free(ml->colorfg);
+		linepool_free(ml->image);
+	if (ml->style && ml->style != null)
+		linepool_free(ml->style);
 	*ml = mline_zero;
 }
 
 static int AllocMline(struct mline *ml, int w)
 {
-	ml->image = malloc(w * 4);
-	ml->attr = null;
-	ml->font = null;
-	ml->fontx = null;
-	ml->colorbg = null;
-	ml->colorfg = null;
+	ml->image = linepool_alloc(w);
+	ml->style = null;
 	if (ml->image == 0)
 		return -1;
 	return 0;
 }
 
+/*
+ * Cells of ml. History rows keep the width they were stored at until
+ * they are rewrapped, see RewrapHistory. The cell after them tells if
+ * the line goes on in the next row.
+ */
+static int RowWidth(struct mline *ml)
+{
+	return ml->image ? linepool_len(ml->image) - 1 : 0;
+}
+
+/* cells of the w cells of ml up to the last one that is not blank, at least 1 */
+static int RowLength(struct mline *ml, int w)
+{
+	int l;
+
+	for (l = w - 1; l > 0; l--)
+		if (ml->image[l] != ' ' || mline_style(ml, l)->attr)
+			break;
+	return l + 1;
+}
+
 static int BcopyMline(struct mline *mlf, int xf, struct mline *mlt, int xt, int l, int w)
 {
 	int r = 0;
 
 	memmove(mlt->image + xt, mlf->image + xf, l * 4);
-	if (mlf->attr != null && mlt->attr == null) {
-		if ((mlt->attr = calloc(w, 4)) == 0)
-			mlt->attr = null, r = -1;
-	}
-	if (mlt->attr != null)
-		memmove(mlt->attr + xt, mlf->attr + xf, l * 4);
-	if (mlf->font != null && mlt->font == null) {
-		if ((mlt->font = calloc(w, 4)) == 0)
-			mlt->font = null, r = -1;
-	}
-	if (mlt->font != null)
-		memmove(mlt->font + xt, mlf->font + xf, l * 4);
-	if (mlf->fontx != null && mlt->fontx == null) {
-		if ((mlt->fontx = calloc(w, 4)) == 0)
-			mlt->fontx = null, r = -1;
-	}
-	if (mlt->fontx != null)
-		memmove(mlt->fontx + xt, mlf->fontx + xf, l * 4);
-	if (mlf->colorbg != null && mlt->colorbg == null) {
-		if ((mlt->colorbg = calloc(w, 4)) == 0)
-			mlt->colorbg = null, r = -1;
-	}
-	if (mlt->colorbg != null)
-		memmove(mlt->colorbg + xt, mlf->colorbg + xf, l * 4);
-	if (mlf->colorfg != null && mlt->colorfg == null) {
-		if ((mlt->colorfg = calloc(w, 4)) == 0)
-			mlt->colorfg = null, r = -1;
-	}
-	if (mlt->colorfg != null)
-		memmove(mlt->colorfg + xt, mlf->colorfg + xf, l * 4);
+	if (mlf->style != null && mlt->style == null) {
+		if ((mlt->style = linepool_alloc(w)) == 0)
+			mlt->style = null, r = -1;
+	}
+	if (mlt->style != null)
+		memmove(mlt->style + xt, mlf->style + xf, l * 4);
 	return r;
 }
 
@@ -393,29 +376,17 @@ static void CheckMaxSize(int wi)
 	blank = xrealloc(blank, maxwidth * 4);
 	null = xrealloc(null, maxwidth * 4);
 	mline_old.image = xrealloc(mline_old.image, maxwidth * 4);
-	mline_old.attr = xrealloc(mline_old.attr, maxwidth * 4);
-	mline_old.font = xrealloc(mline_old.font, maxwidth * 4);
-	mline_old.fontx = xrealloc(mline_old.fontx, maxwidth * 4);
-	mline_old.colorbg = xrealloc(mline_old.colorbg, maxwidth * 4);
-	mline_old.colorfg = xrealloc(mline_old.colorfg, maxwidth * 4);
-	if (!(blank && null && mline_old.image && mline_old.attr && mline_old.font && mline_old.fontx && mline_old.colorbg && mline_old.colorfg))
+	mline_old.style = xrealloc(mline_old.style, maxwidth * 4);
+	if (!(blank && null && mline_old.image && mline_old.style))
 		Panic(0, "%s", strnomem);
 
 	MakeBlankLine(blank, maxwidth);
 	memset(null, 0, maxwidth * 4);
 
 	mline_blank.image = blank;
-	mline_blank.attr = null;
+	mline_blank.style = null;
 	mline_null.image = null;
-	mline_null.attr = null;
-	mline_blank.font = null;
-	mline_null.font = null;
-	mline_blank.fontx = null;
-	mline_null.fontx = null;
-	mline_blank.colorbg = null;
-	mline_null.colorbg = null;
-	mline_blank.colorfg = null;
-	mline_null.colorfg = null;
+	mline_null.style = null;
 
 #define RESET_AFC(x, bl) do { if (x == old##bl) x = bl; } while (0)
 
@@ -425,11 +396,7 @@ static void CheckMaxSize(int wi)
     for (i = 0; i < count; i++, ml++) \
       { \
 	RESET_AFC(ml->image, blank); \
-	RESET_AFC(ml->attr, null); \
-	RESET_AFC(ml->font, null); \
-	RESET_AFC(ml->fontx, null); \
-	RESET_AFC(ml->colorbg, null); \
-	RESET_AFC(ml->colorfg, null); \
+	RESET_AFC(ml->style, null); \
       } \
   } while (0)
 
@@ -439,8 +406,8 @@ static void CheckMaxSize(int wi)
 	for (p = windows; p; p = p->w_next) {
 		RESET_LINES(p->w_mlines, p->w_height);
 
-		RESET_LINES(p->w_hlines, p->w_histheight);
-		RESET_LINES(p->w_alt.hlines, p->w_alt.histheight);
+		RESET_LINES(p->w_hlines, p->w_histheight - p->w_histcold);
+		RESET_LINES(p->w_alt.hlines, p->w_alt.histheight - p->w_alt.histcold);
 
 		RESET_LINES(p->w_alt.mlines, p->w_alt.height);
 	}
@@ -464,18 +431,28 @@ static void MakeBlankLine(uint32_t *p, int n)
 		*p++ = ' ';
 }
 
-#define OLDWIN(y) ((y < p->w_histheight) \
-        ? &p->w_hlines[(p->w_histidx + y) % p->w_histheight] \
-        : &p->w_mlines[y - p->w_histheight])
+/*
+ * Rows to allocate for hi lines of history and he lines of screen. The
+ * spare rows let MScrollV move the lines along instead of moving the
+ * lines themselves; only when they run out are the lines copied back to
+ * the start, so no more than two rows are copied per line scrolled.
+ */
+static int RowsFor(int he, int hi)
+{
+	return hi + he + ((hi + he) / 2 > he ? (hi + he) / 2 : he);
+}
 
-#define NEWWIN(y) ((y < hi) ? &nhlines[y] : &nmlines[y - hi])
+#define OLDWIN(y) (&p->w_hlines[y])
+
+#define NEWWIN(y) (&nhlines[y])
 
 int ChangeWindowSize(Window *p, int wi, int he, int hi)
 {
 	struct mline *mlf = 0, *mlt = 0, *ml, *nmlines, *nhlines;
 	int fy, ty, l, lx, lf, lt, yy, oty, addone;
 	int ncx, ncy, naka, t;
-	int y, shift;
+	int y, shift, nrows, gap;
+	int oh, hh, hc;
 
 	if (wi <= 0 || he <= 0)
 		wi = he = hi = 0;
@@ -499,23 +476,39 @@ int ChangeWindowSize(Window *p, int wi, int he, int hi)
 
 	CheckMaxSize(wi);
 
-	fy = p->w_histheight + p->w_height - 1;
-	ty = hi + he - 1;
+	/* only the newest HOTHISTHEIGHT lines of the history are kept in rows */
+	oh = p->w_histheight - p->w_histcold;
+	hh = hi < HOTHISTHEIGHT ? hi : HOTHISTHEIGHT;
+	hc = hi - hh;
+
+	fy = oh + p->w_height - 1;
+	ty = hh + he - 1;
 
 	nmlines = nhlines = 0;
+	nrows = 0;
 	ncx = 0;
 	ncy = 0;
 	naka = 0;
 
 	if (wi) {
-		if (wi != p->w_width || he != p->w_height) {
-			if ((nmlines = calloc(he, sizeof(struct mline))) == 0) {
-				KillWindow(p);
-				Msg(0, "%s", strnomem);
-				return -1;
-			}
-		} else {
-			nmlines = p->w_mlines;
+		nrows = RowsFor(he, hh);
+		if (hh && (nhlines = calloc(nrows, sizeof(struct mline))) == 0) {
+			Msg(0, "No memory for history buffer - turned off");
+			hi = hh = hc = 0;
+			ty = he - 1;
+			nrows = RowsFor(he, 0);
+		}
+		if (!nhlines && (nhlines = calloc(nrows, sizeof(struct mline))) == 0) {
+			KillWindow(p);
+			Msg(0, "%s", strnomem);
+			return -1;
+		}
+		nmlines = nhlines + hh;
+		if (wi == p->w_width && he == p->w_height) {
+			/* just the history changes, take the lines over as they are */
+			memcpy(nmlines, p->w_mlines, he * sizeof(struct mline));
+			for (y = 0; y < he; y++)
+				p->w_mlines[y] = mline_zero;
 			fy -= he;
 			ty -= he;
 			ncx = p->w_x;
@@ -523,13 +516,6 @@ int ChangeWindowSize(Window *p, int wi, int he, int hi)
 			naka = p->w_autoaka;
 		}
 	}
-	if (hi) {
-		if ((nhlines = calloc(hi, sizeof(struct mline))) == 0) {
-			Msg(0, "No memory for history buffer - turned off");
-			hi = 0;
-			ty = he - 1;
-		}
-	}
 
 	/* special case: cursor is at magic margin position */
 	addone = 0;
@@ -544,11 +530,11 @@ int ChangeWindowSize(Window *p, int wi, int he, int hi)
 		ncy = p->w_y + he - p->w_height;
 		/* never lose sight of the line with the cursor on it */
 		shift = -ncy;
-		for (yy = p->w_y + p->w_histheight - 1; yy >= 0 && ncy + shift < he; yy--) {
+		for (yy = p->w_y + oh - 1; yy >= 0 && ncy + shift < he; yy--) {
 			ml = OLDWIN(yy);
 			if (!ml->image)
 				break;
-			if (ml->image[p->w_width] == ' ')
+			if (ml->image[RowWidth(ml)] == ' ')
 				break;
 			shift++;
 		}
@@ -566,38 +552,44 @@ int ChangeWindowSize(Window *p, int wi, int he, int hi)
 			fy--;
 		}
 	}
-	if (fy >= 0)
+	lf = 0;
+	if (fy >= 0) {
 		mlf = OLDWIN(fy);
+		lf = RowWidth(mlf);
+	}
 	if (ty >= 0)
 		mlt = NEWWIN(ty);
 
 	while (fy >= 0 && ty >= 0) {
-		if (p->w_width == wi) {
-			/* here is a simple shortcut: just copy over */
+		if (lf == wi || (fy < oh && ty < hh)) {
+			/*
+			 * here is a simple shortcut: just copy over. Rows that
+			 * stay in the history keep their width, they are
+			 * rewrapped when they are looked at.
+			 */
 			*mlt = *mlf;
 			*mlf = mline_zero;
-			if (--fy >= 0)
+			if (--fy >= 0) {
 				mlf = OLDWIN(fy);
+				lf = RowWidth(mlf);
+			}
 			if (--ty >= 0)
 				mlt = NEWWIN(ty);
 			continue;
 		}
 
 		/* calculate lenght */
-		for (l = p->w_width - 1; l > 0; l--)
-			if (mlf->image[l] != ' ' || mlf->attr[l])
-				break;
-		if (fy == p->w_y + p->w_histheight && l < p->w_x)
-			l = p->w_x;	/* cursor is non blank */
-		l++;
+		l = RowLength(mlf, lf);
+		if (fy == p->w_y + oh && l <= p->w_x)
+			l = p->w_x + 1;	/* cursor is non blank */
 		lf = l;
 
-		/* add wrapped lines to length */
+		/* add wrapped lines to length, rows of the history may be of other widths */
 		for (yy = fy - 1; yy >= 0; yy--) {
 			ml = OLDWIN(yy);
-			if (ml->image[p->w_width] == ' ')
+			if (ml->image[RowWidth(ml)] == ' ')
 				break;
-			l += p->w_width;
+			l += RowWidth(ml);
 		}
 
 		/* rewrap lines */
@@ -615,14 +607,14 @@ int ChangeWindowSize(Window *p, int wi, int he, int hi)
 				goto nomem;
 
 			/* did we copy the cursor ? */
-			if (fy == p->w_y + p->w_histheight && lf - lx <= p->w_x && lf > p->w_x) {
+			if (fy == p->w_y + oh && lf - lx <= p->w_x && lf > p->w_x) {
 				ncx = p->w_x + lt - lf + addone;
-				ncy = ty - hi;
+				ncy = ty - hh;
 				shift = wi ? -ncy + (l - lx) / wi : 0;
-				if (ty + shift > hi + he - 1)
-					shift = hi + he - 1 - ty;
+				if (ty + shift > hh + he - 1)
+					shift = hh + he - 1 - ty;
 				if (shift > 0) {
-					for (y = hi + he - 1; y >= ty; y--) {
+					for (y = hh + he - 1; y >= ty; y--) {
 						mlt = NEWWIN(y);
 						FreeMline(mlt);
 						if (y - shift < ty)
@@ -639,17 +631,18 @@ int ChangeWindowSize(Window *p, int wi, int he, int hi)
 				}
 			}
 			/* did we copy autoaka line ? */
-			if (p->w_autoaka > 0 && fy == p->w_autoaka - 1 + p->w_histheight && lf - lx <= 0)
-				naka = ty - hi >= 0 ? 1 + ty - hi : 0;
+			if (p->w_autoaka > 0 && fy == p->w_autoaka - 1 + oh && lf - lx <= 0)
+				naka = ty - hh >= 0 ? 1 + ty - hh : 0;
 
 			lf -= lx;
 			lt -= lx;
 			l -= lx;
 			if (lf == 0) {
 				FreeMline(mlf);
-				lf = p->w_width;
-				if (--fy >= 0)
+				if (--fy >= 0) {
 					mlf = OLDWIN(fy);
+					lf = RowWidth(mlf);
+				}
 			}
 			if (lt == 0) {
 				lt = wi;
@@ -658,25 +651,65 @@ int ChangeWindowSize(Window *p, int wi, int he, int hi)
 			}
 		}
 	}
+	/* lines that do not fit any more are packed, of one partly moved over what is left */
+	if (fy >= 0 && hc) {
+		if (lf != RowWidth(mlf)) {
+			MakeBlankLine(mlf->image + lf, RowWidth(mlf) - lf);
+			if (mlf->style != null)
+				memset(mlf->style + lf, 0, (RowWidth(mlf) - lf) * 4);
+		}
+		for (y = 0; y <= fy; y++)
+			histpack_push(&p->w_cold, OLDWIN(y), RowWidth(OLDWIN(y)));
+	}
 	while (fy >= 0) {
 		FreeMline(mlf);
 		if (--fy >= 0)
 			mlf = OLDWIN(fy);
 	}
-	while (ty >= 0) {
+	/* lines missing at the top are unpacked again, those left in the history at their own width */
+	for (; ty >= 0 && p->w_cold.lines; histpack_pop(&p->w_cold)) {
+		ml = histpack_line(&p->w_cold, p->w_cold.lines - 1, ty < hh ? 0 : wi);
+		l = ml ? RowWidth(ml) : wi;
+		if (AllocMline(mlt, l + 1))
+			goto nomem;
+		if (!ml) {
+			MakeBlankLine(mlt->image, l + 1);
+		} else {
+			memmove(mlt->image, ml->image, (l + 1) * 4);
+			if (memcmp(ml->style, null, l * 4) && BcopyMline(ml, 0, mlt, 0, l, l + 1))
+				goto nomem;
+		}
+		if (--ty >= 0)
+			mlt = NEWWIN(ty);
+	}
+	/* history the lines do not reach is left out until it is filled */
+	gap = ty + 1 < hh ? ty + 1 : hh;
+	while (ty >= gap) {
 		if (AllocMline(mlt, wi + 1))
 			goto nomem;
 		MakeBlankLine(mlt->image, wi + 1);
-		if (--ty >= 0)
+		if (--ty >= gap)
 			mlt = NEWWIN(ty);
 	}
+	if (gap) {
+		hh -= gap;
+		memmove(nhlines, nhlines + gap, (hh + he) * sizeof(struct mline));
+		nrows = RowsFor(he, hh);
+		if ((ml = realloc(nhlines, nrows * sizeof(struct mline))) != NULL)
+			nhlines = ml;
+		else
+			nrows = RowsFor(he, hh + gap);
+		nmlines = nhlines + hh;
+	}
+	if (p->w_cold.lines > hc)
+		histpack_drop(&p->w_cold, p->w_cold.lines - hc);
+	p->w_histcold = hi - hh;
 
-	if (p->w_mlines && p->w_mlines != nmlines)
-		free((char *)p->w_mlines);
-	p->w_mlines = nmlines;
-	if (p->w_hlines && p->w_hlines != nhlines)
-		free((char *)p->w_hlines);
+	free(p->w_rows);
+	p->w_rows = nhlines;
+	p->w_nrows = nrows;
 	p->w_hlines = nhlines;
+	p->w_mlines = nmlines;
 
 	/* change tabs */
 	if (p->w_width != wi) {
@@ -685,22 +718,15 @@ int ChangeWindowSize(Window *p, int wi, int he, int hi)
 			p->w_tabs = xrealloc(p->w_tabs, (wi + 1) * 4);
 			if (p->w_tabs == 0) {
  nomem:
-				if (nmlines) {
-					for (ty = he + hi - 1; ty >= 0; ty--) {
+				if (nhlines && p->w_rows != nhlines) {
+					for (ty = he + hh - 1; ty >= 0; ty--) {
 						mlt = NEWWIN(ty);
 						FreeMline(mlt);
 					}
-					if (nmlines && p->w_mlines != nmlines)
-						free((char *)nmlines);
-					if (nhlines && p->w_hlines != nhlines)
-						free((char *)nhlines);
+					free(nhlines);
 				}
 				KillWindow(p);
 				Msg(0, "%s", strnomem);
-				if (nmlines)
-					free(nmlines);
-				if (nhlines)
-					free(nhlines);
 				return -1;
 			}
 			for (; t < wi; t++)
@@ -751,12 +777,17 @@ int ChangeWindowSize(Window *p, int wi, int he, int hi)
 		ioctl(p->w_ptyfd, TIOCSWINSZ, (char *)&glwz);
 	}
 
-	/* store new size */
+	/* store new size, history rows of another width are rewrapped later */
+	p->w_rewrap = hh && (p->w_rewrap || p->w_width != wi);
 	p->w_width = wi;
 	p->w_height = he;
-	p->w_histidx = 0;
 	p->w_histheight = hi;
 
+	/* all rows are new to the displays, without generations merely never the same */
+	free(p->w_rowgen);
+	p->w_rowgen = he ? malloc(he * sizeof(uint64_t)) : NULL;
+	WinTouchRows(p, 0, he - 1);
+
 #ifdef ENABLE_TELNET
 	if (p->w_type == W_TYPE_TELNET)
 		TelWindowSize(p);
@@ -765,31 +796,111 @@ int ChangeWindowSize(Window *p, int wi, int he, int hi)
 	return 0;
 }
 
+/*
+ * Rewrap the history of p that ChangeWindowSize left at the width of an
+ * earlier size. The rows are packed after the older lines, which keep
+ * the width they were stored at, the whole history is rewrapped at the
+ * width of the window and the newest lines are unpacked into rows
+ * again. Returns -1 if there is no memory for it, the history is left
+ * as it is then.
+ */
+int RewrapHistory(Window *p)
+{
+	struct mline *rows, *ml;
+	int oh = p->w_histheight - p->w_histcold;
+	int hh = p->w_histheight < HOTHISTHEIGHT ? p->w_histheight : HOTHISTHEIGHT;
+	int wi = p->w_width;
+	int y, n, nrows;
+
+	nrows = RowsFor(p->w_height, hh);
+	if (!(rows = calloc(nrows, sizeof(struct mline))))
+		return -1;
+	for (y = 0; y < hh; y++)
+		if (AllocMline(&rows[y], wi + 1) || !(rows[y].style = linepool_alloc(wi + 1)))
+			goto nomem;
+	for (y = 0; y < oh; y++)
+		if (histpack_push(&p->w_cold, &p->w_hlines[y], RowWidth(&p->w_hlines[y])))
+			goto unpush;
+	if (histpack_rewrap(&p->w_cold, wi))
+		goto unpush;
+
+	/* the newest lines go back into rows */
+	n = p->w_cold.lines < hh ? p->w_cold.lines : hh;
+	for (y = n - 1; y >= 0; y--, histpack_pop(&p->w_cold)) {
+		ml = histpack_line(&p->w_cold, p->w_cold.lines - 1, wi);
+		if (!ml) {
+			MakeBlankLine(rows[y].image, wi + 1);
+			memset(rows[y].style, 0, (wi + 1) * 4);
+		} else {
+			memmove(rows[y].image, ml->image, (wi + 1) * 4);
+			memmove(rows[y].style, ml->style, (wi + 1) * 4);
+		}
+		if (!memcmp(rows[y].style, null, wi * 4)) {
+			linepool_free(rows[y].style);
+			rows[y].style = null;
+		}
+	}
+	for (y = n; y < hh; y++)
+		FreeMline(&rows[y]);
+	if (p->w_cold.lines > p->w_histheight - n)
+		histpack_drop(&p->w_cold, p->w_cold.lines - (p->w_histheight - n));
+
+	for (y = 0; y < oh; y++)
+		FreeMline(&p->w_hlines[y]);
+	memcpy(rows + n, p->w_mlines, p->w_height * sizeof(struct mline));
+	free(p->w_rows);
+	if (n < hh && (ml = realloc(rows, RowsFor(p->w_height, n) * sizeof(struct mline))) != NULL) {
+		rows = ml;
+		nrows = RowsFor(p->w_height, n);
+	}
+	p->w_rows = rows;
+	p->w_nrows = nrows;
+	p->w_hlines = rows;
+	p->w_mlines = rows + n;
+	p->w_histcold = p->w_histheight - n;
+	p->w_rewrap = false;
+	return 0;
+
+ unpush:
+	while (y-- > 0)
+		histpack_pop(&p->w_cold);
+	y = hh;
+ nomem:
+	while (y >= 0)
+		FreeMline(&rows[y--]);
+	free(rows);
+	return -1;
+}
+
 void FreeAltScreen(Window *p)
 {
 	int i;
 
-	if (p->w_alt.mlines) {
-		for (i = 0; i < p->w_alt.height; i++)
-			FreeMline(p->w_alt.mlines + i);
-		free(p->w_alt.mlines);
-	}
+	if (p->w_alt.rows) {
+		for (i = 0; i < p->w_alt.histheight - p->w_alt.histcold + p->w_alt.height; i++)
+			FreeMline(p->w_alt.hlines + i);
+		free(p->w_alt.rows);
+	}
+	histpack_free(&p->w_alt.cold);
+	free(p->w_alt.rowgen);
+	p->w_alt.rowgen = 0;
+	p->w_alt.histcold = 0;
+	p->w_alt.rewrap = false;
+	p->w_alt.rows = 0;
+	p->w_alt.nrows = 0;
 	p->w_alt.mlines = 0;
+	p->w_alt.hlines = 0;
 	p->w_alt.width = 0;
 	p->w_alt.height = 0;
-	if (p->w_alt.hlines) {
-		for (i = 0; i < p->w_alt.histheight; i++)
-			FreeMline(p->w_alt.hlines + i);
-		free(p->w_alt.hlines);
-	}
-	p->w_alt.hlines = 0;
-	p->w_alt.histidx = 0;
 	p->w_alt.histheight = 0;
 }
 
 static void SwapAltScreen(Window *p)
 {
 	struct mline *ml;
+	HistPack hp;
+	uint64_t *g;
+	bool b;
 	int t;
 
 #define SWAP(item, t) do { (t) = p->w_alt. item; p->w_alt. item = p->w_##item; p->w_##item = (t); } while (0)
@@ -800,7 +911,12 @@ static void SwapAltScreen(Window *p)
 
 	SWAP(histheight, t);
 	SWAP(hlines, ml);
-	SWAP(histidx, t);
+	SWAP(rows, ml);
+	SWAP(nrows, t);
+	SWAP(histcold, t);
+	SWAP(rewrap, b);
+	SWAP(cold, hp);
+	SWAP(rowgen, g);
 #undef SWAP
 }
 
@@ -816,6 +932,8 @@ void EnterAltScreen(Window *p)
 		   is only necessary to reset the height(s) without resetting the width. */
 		p->w_height = 0;
 		p->w_histheight = 0;
+		p->w_histcold = 0;
+		histpack_free(&p->w_cold);
 	}
 	ChangeWindowSize(p, p->w_alt.width, p->w_alt.height, p->w_alt.histheight);
 	p->w_alt.on = 1;
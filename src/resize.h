@@ -7,6 +7,7 @@ int   ChangeWindowSize (Window *, int, int, int);
 void  ChangeScreenSize (int, int, int);
 void  CheckScreenSize (int);
 void *xrealloc (void *, size_t);
+int   RewrapHistory (Window *);
 void  ResizeLayersToCanvases (void);
 void  ResizeLayer (Layer *, int, int, Display *);
 int   MayResizeLayer (Layer *);
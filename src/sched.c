@@ -34,32 +34,178 @@
 #include <sys/types.h>
 #include <time.h>
 #include <sys/time.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 
 #include "screen.h"
+#include "evheap.h"
 
-static Event *evs;
-static Event *tevs;
+#define EVMASK(type)	(1 << (type))
+
+/*
+ * Read and write events are kept per fd, so that registration with the
+ * event backend only has to change when an event is queued, dequeued or
+ * its condition flips, instead of rebuilding the whole interest set on
+ * every iteration of the main loop.
+ */
+struct evfd {
+	Event *evs;		/* queued read/write events on this fd */
+	int mask;		/* EVMASK bits registered with the backend */
+};
+
+struct evready {
+	int fd;
+	int mask;
+};
+
+/*
+ * An event backend waits until some of the registered fds are ready or
+ * the timeout expires and reports the ready fds in evready.
+ */
+struct evbackend {
+	const char *name;
+	bool (*init) (void);
+	void (*ctl) (int, int, int);	/* fd, old mask, new mask */
+	int (*wait) (struct timeval *);	/* returns number of ready fds */
+};
+
+static Event *evs;		/* EV_ALWAYS events */
+static EventHeap tevs;		/* EV_TIMEOUT events */
 static Event *nextev;
-static int calctimeout;
 
-static Event *calctimo(void);
+static struct evfd *evfds;
+static int nevfds;
+static struct evready *evready;
+static int nevready;
+static Event **evdisp;		/* events to dispatch in this iteration */
+static int nevdisp, aevdisp;
+static const struct evbackend *backend;
+static struct timeval now;	/* monotonic time, cached per iteration */
+static bool running;		/* inside the sched() loop */
+
+static void evfd_update(int);
+static void evready_grow(int);
+
+static bool select_init(void);
+static void select_ctl(int, int, int);
+static int select_wait(struct timeval *);
+
+static const struct evbackend select_backend = {
+	"select",
+	select_init,
+	select_ctl,
+	select_wait
+};
+
+#ifdef HAVE_SYS_EPOLL_H
+static bool epoll_init(void);
+static void epoll_ctl_fd(int, int, int);
+static int epoll_wait_fds(struct timeval *);
+
+static const struct evbackend epoll_backend = {
+	"epoll",
+	epoll_init,
+	epoll_ctl_fd,
+	epoll_wait_fds
+};
+#endif
+
+/* read the monotonic clock, wall clock jumps must not affect timeouts */
+static void UpdateTime()
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+		now.tv_sec = ts.tv_sec;
+		now.tv_usec = ts.tv_nsec / 1000;
+		return;
+	}
+#endif
+	gettimeofday(&now, NULL);
+}
+
+/*
+ * Returns the time all timeouts are based on. Inside the main loop the
+ * clock is read only once per iteration, so that hot output paths which
+ * rearm timers don't have to ask the kernel every time.
+ */
+void GetTime(struct timeval *tv)
+{
+	if (!running)
+		UpdateTime();
+	*tv = now;
+}
+
+/* recompute the mask of an fd and tell the backend about changes */
+static void evfd_update(int fd)
+{
+	Event *ev;
+	int mask = 0;
+
+	for (ev = evfds[fd].evs; ev; ev = ev->fdnext)
+		if (!ev->blocked)
+			mask |= EVMASK(ev->type);
+	if (mask == evfds[fd].mask)
+		return;
+	if (backend)
+		backend->ctl(fd, evfds[fd].mask, mask);
+	evfds[fd].mask = mask;
+}
+
+static void evfd_link(Event *ev)
+{
+	if (ev->fd >= nevfds) {
+		int n = nevfds ? nevfds : 64;
+		struct evfd *nfds;
+
+		while (n <= ev->fd)
+			n *= 2;
+		if (!(nfds = realloc(evfds, n * sizeof(*evfds))))
+			Panic(0, "%s", strnomem);
+		memset(nfds + nevfds, 0, (n - nevfds) * sizeof(*evfds));
+		evfds = nfds;
+		nevfds = n;
+	}
+	ev->fdnext = evfds[ev->fd].evs;
+	evfds[ev->fd].evs = ev;
+	evfd_update(ev->fd);
+}
+
+static void evfd_unlink(Event *ev)
+{
+	Event **evpp;
+
+	for (evpp = &evfds[ev->fd].evs; *evpp; evpp = &(*evpp)->fdnext)
+		if (*evpp == ev) {
+			*evpp = ev->fdnext;
+			break;
+		}
+	ev->fdnext = 0;
+	evfd_update(ev->fd);
+}
 
 void evenq(Event *ev)
 {
 	Event *evp, **evpp;
 	if (ev->queued)
 		return;
-	evpp = &evs;
+	ev->queued = true;
+	if (ev->type == EV_READ || ev->type == EV_WRITE) {
+		if (ev->fd >= 0)
+			evfd_link(ev);
+		return;
+	}
 	if (ev->type == EV_TIMEOUT) {
-		calctimeout = 1;
-		evpp = &tevs;
+		if (evheap_push(&tevs, ev))
+			Panic(0, "%s", strnomem);
+		return;
 	}
-	for (; (evp = *evpp); evpp = &evp->next)
+	for (evpp = &evs; (evp = *evpp); evpp = &evp->next)
 		if (ev->priority > evp->priority)
 			break;
 	ev->next = evp;
 	*evpp = ev;
-	ev->queued = true;
 }
 
 void evdeq(Event *ev)
@@ -67,55 +213,247 @@ void evdeq(Event *ev)
 	Event *evp, **evpp;
 	if (!ev || !ev->queued)
 		return;
-	evpp = &evs;
+	ev->queued = false;
+	if (ev->type == EV_READ || ev->type == EV_WRITE) {
+		if (ev->fd < 0)
+			return;
+		evfd_unlink(ev);
+		/* don't dispatch it later in this iteration */
+		for (int i = 0; i < nevdisp; i++)
+			if (evdisp[i] == ev)
+				evdisp[i] = 0;
+		return;
+	}
 	if (ev->type == EV_TIMEOUT) {
-		calctimeout = 1;
-		evpp = &tevs;
+		evheap_remove(&tevs, ev);
+		return;
 	}
-	for (; (evp = *evpp); evpp = &evp->next)
+	for (evpp = &evs; (evp = *evpp); evpp = &evp->next)
 		if (evp == ev)
 			break;
 	*evpp = ev->next;
-	ev->queued = false;
 	if (ev == nextev)
 		nextev = nextev->next;
 }
 
-static Event *calctimo()
+/*
+ * A blocked fd or EV_ALWAYS event stays queued but its handler is not
+ * called, the fd is not watched at all. Whoever makes the event
+ * runnable again has to call evunblock(), it is not polled.
+ */
+void evblock(Event *ev)
+{
+	if (ev->blocked)
+		return;
+	ev->blocked = true;
+	if (ev->queued && (ev->type == EV_READ || ev->type == EV_WRITE) && ev->fd >= 0)
+		evfd_update(ev->fd);
+}
+
+void evunblock(Event *ev)
+{
+	if (!ev->blocked)
+		return;
+	ev->blocked = false;
+	if (ev->queued && (ev->type == EV_READ || ev->type == EV_WRITE) && ev->fd >= 0)
+		evfd_update(ev->fd);
+}
+
+static void evready_grow(int n)
 {
-	Event *ev, *min;
-	long mins;
+	if (n <= nevready)
+		return;
+	if (!(evready = realloc(evready, n * sizeof(*evready))))
+		Panic(0, "%s", strnomem);
+	nevready = n;
+}
+
+static void evdisp_add(Event *ev)
+{
+	int i;
+
+	if (nevdisp == aevdisp) {
+		aevdisp = aevdisp ? aevdisp * 2 : 64;
+		if (!(evdisp = realloc(evdisp, aevdisp * sizeof(*evdisp))))
+			Panic(0, "%s", strnomem);
+	}
+	/* keep priority order, events of equal priority in arrival order */
+	for (i = nevdisp; i > 0 && evdisp[i - 1]->priority < ev->priority; i--)
+		evdisp[i] = evdisp[i - 1];
+	evdisp[i] = ev;
+	nevdisp++;
+}
+
+/*
+ *  select() backend, the portable fallback
+ */
+
+static fd_set select_rfds, select_wfds;
+static int select_maxfd = -1;
+
+static bool select_init()
+{
+	FD_ZERO(&select_rfds);
+	FD_ZERO(&select_wfds);
+	select_maxfd = -1;
+	return true;
+}
+
+static void select_ctl(int fd, int omask, int mask)
+{
+	(void)omask; /* unused */
+
+	if (fd >= FD_SETSIZE)
+		Panic(0, "select: fd %d exceeds FD_SETSIZE", fd);
+	if (mask & EVMASK(EV_READ))
+		FD_SET(fd, &select_rfds);
+	else
+		FD_CLR(fd, &select_rfds);
+	if (mask & EVMASK(EV_WRITE))
+		FD_SET(fd, &select_wfds);
+	else
+		FD_CLR(fd, &select_wfds);
+	if (mask && fd > select_maxfd)
+		select_maxfd = fd;
+	while (select_maxfd >= 0 && !FD_ISSET(select_maxfd, &select_rfds) && !FD_ISSET(select_maxfd, &select_wfds))
+		select_maxfd--;
+}
 
-	if ((min = tevs) == 0)
-		return 0;
-	mins = min->timeout.tv_sec;
-	for (ev = tevs->next; ev; ev = ev->next) {
-		if (mins < ev->timeout.tv_sec)
+static int select_wait(struct timeval *tv)
+{
+	fd_set r, w;
+	int nsel, n = 0;
+
+	r = select_rfds;
+	w = select_wfds;
+	nsel = select(select_maxfd + 1, &r, &w, (fd_set *) 0, tv);
+	if (nsel <= 0)
+		return nsel;
+	evready_grow(nsel);
+	for (int fd = 0; fd <= select_maxfd && n < nsel; fd++) {
+		int mask = 0;
+		if (FD_ISSET(fd, &r))
+			mask |= EVMASK(EV_READ);
+		if (FD_ISSET(fd, &w))
+			mask |= EVMASK(EV_WRITE);
+		if (!mask)
 			continue;
-		if (mins > ev->timeout.tv_sec || min->timeout.tv_usec > ev->timeout.tv_usec) {
-			min = ev;
-			mins = ev->timeout.tv_sec;
+		evready[n].fd = fd;
+		evready[n].mask = mask;
+		n++;
+	}
+	return n;
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+/*
+ *  epoll() backend, registration persists across iterations
+ */
+
+static int epfd = -1;
+static struct epoll_event *epevs;
+static int nepevs;
+
+static bool epoll_init()
+{
+	if ((epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		return false;
+	nepevs = 64;
+	if (!(epevs = malloc(nepevs * sizeof(*epevs))))
+		Panic(0, "%s", strnomem);
+	return true;
+}
+
+static void epoll_ctl_fd(int fd, int omask, int mask)
+{
+	struct epoll_event epev;
+
+	memset(&epev, 0, sizeof(epev));
+	epev.data.fd = fd;
+	if (mask & EVMASK(EV_READ))
+		epev.events |= EPOLLIN;
+	if (mask & EVMASK(EV_WRITE))
+		epev.events |= EPOLLOUT;
+	if (!mask) {
+		/* the fd may already be closed, which removed it from the set */
+		(void)epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &epev);
+		return;
+	}
+	if (epoll_ctl(epfd, omask ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &epev) == 0)
+		return;
+	/* closed before the remaining events got dequeued */
+	if (errno == EBADF)
+		return;
+	/* closed and reopened behind our back? */
+	if (errno == ENOENT && epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &epev) == 0)
+		return;
+	if (errno == EEXIST && epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &epev) == 0)
+		return;
+	Panic(errno, "epoll_ctl %d", fd);
+}
+
+static int epoll_wait_fds(struct timeval *tv)
+{
+	int timo = -1;
+	int n;
+
+	if (tv)			/* round up, so that we don't wake up too early */
+		timo = tv->tv_sec * 1000 + (tv->tv_usec + 999) / 1000;
+	n = epoll_wait(epfd, epevs, nepevs, timo);
+	if (n <= 0)
+		return n;
+	evready_grow(n);
+	for (int i = 0; i < n; i++) {
+		int mask = 0;
+		if (epevs[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+			mask |= EVMASK(EV_READ);
+		if (epevs[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+			mask |= EVMASK(EV_WRITE);
+		evready[i].fd = epevs[i].data.fd;
+		evready[i].mask = mask;
+	}
+	if (n == nepevs) {
+		struct epoll_event *nevs = realloc(epevs, 2 * nepevs * sizeof(*epevs));
+		if (nevs) {
+			epevs = nevs;
+			nepevs *= 2;
 		}
 	}
-	return min;
+	return n;
+}
+#endif
+
+static void evbackend_init()
+{
+#ifdef HAVE_SYS_EPOLL_H
+	if (epoll_backend.init())
+		backend = &epoll_backend;
+	else
+#endif
+	if (select_backend.init())
+		backend = &select_backend;
+	/* register everything queued before we got here */
+	for (int fd = 0; fd < nevfds; fd++)
+		if (evfds[fd].mask)
+			backend->ctl(fd, 0, evfds[fd].mask);
 }
 
 void sched()
 {
 	Event *ev;
-	fd_set r, w, *set;
-	Event *timeoutev = 0;
+	Event *timeoutev;
 	struct timeval timeout;
-	int nsel;
+	int nready;
 
+	if (!backend)
+		evbackend_init();
+	UpdateTime();
+	running = true;
 	for (;;) {
-		if (calctimeout)
-			timeoutev = calctimo();
-		if (timeoutev) {
-			gettimeofday(&timeout, NULL);
+		if ((timeoutev = evheap_top(&tevs))) {
 			/* tp - timeout */
-			timeout.tv_sec = timeoutev->timeout.tv_sec - timeout.tv_sec;
-			timeout.tv_usec = timeoutev->timeout.tv_usec - timeout.tv_usec;
+			timeout.tv_sec = timeoutev->timeout.tv_sec - now.tv_sec;
+			timeout.tv_usec = timeoutev->timeout.tv_usec - now.tv_usec;
 			if (timeout.tv_usec < 0) {
 				timeout.tv_usec += 1000000;
 				timeout.tv_sec--;
@@ -126,40 +464,47 @@ void sched()
 			}
 		}
 
-		FD_ZERO(&r);
-		FD_ZERO(&w);
-		for (ev = evs; ev; ev = ev->next) {
-			if (ev->condpos && *ev->condpos <= (ev->condneg ? *ev->condneg : 0)) {
-				continue;
-			}
-			if (ev->type == EV_READ)
-				FD_SET(ev->fd, &r);
-			else if (ev->type == EV_WRITE)
-				FD_SET(ev->fd, &w);
-		}
-
-		nsel = select(FD_SETSIZE, &r, &w, (fd_set *) 0, timeoutev ? &timeout : (struct timeval *)0);
-		if (nsel < 0) {
+		nready = backend->wait(timeoutev ? &timeout : (struct timeval *)0);
+		UpdateTime();
+		if (nready < 0) {
 			if (errno != EINTR) {
-				Panic(errno, "select");
+				Panic(errno, "%s", backend->name);
 			}
-			nsel = 0;
-		} else if (nsel == 0) {	/* timeout */
+			nready = 0;
+		} else if (nready == 0) {	/* timeout */
 			if (timeoutev) {
 				evdeq(timeoutev);
 				timeoutev->handler(timeoutev, timeoutev->data);
 			}
 		}
+		/* busy fds never let the wait time out, still run what is overdue */
+		while ((timeoutev = evheap_top(&tevs)) && timercmp(&timeoutev->timeout, &now, <)) {
+			evdeq(timeoutev);
+			timeoutev->handler(timeoutev, timeoutev->data);
+		}
+
+		nevdisp = 0;
+		for (int i = 0; i < nready; i++) {
+			int fd = evready[i].fd;
+			if (fd >= nevfds)
+				continue;
+			for (ev = evfds[fd].evs; ev; ev = ev->fdnext)
+				if (!ev->blocked && (evready[i].mask & EVMASK(ev->type)))
+					evdisp_add(ev);
+		}
+		for (int i = 0; i < nevdisp; i++) {
+			if (!(ev = evdisp[i]))
+				continue;	/* dequeued by an earlier handler */
+			evdisp[i] = 0;
+			if (ev->blocked)
+				continue;	/* blocked by an earlier handler */
+			ev->handler(ev, ev->data);
+		}
+		nevdisp = 0;
 
 		for (ev = evs; ev; ev = nextev) {
 			nextev = ev->next;
-			if (ev->type != EV_ALWAYS) {
-				set = ev->type == EV_READ ? &r : &w;
-				if (nsel == 0 || !FD_ISSET(ev->fd, set))
-					continue;
-				nsel--;
-			}
-			if (ev->condpos && *ev->condpos <= (ev->condneg ? *ev->condneg : 0))
+			if (ev->blocked)
 				continue;
 			ev->handler(ev, ev->data);
 		}
@@ -168,13 +513,13 @@ void sched()
 
 void SetTimeout(Event *ev, int timo)
 {
-	gettimeofday(&ev->timeout, NULL);
+	GetTime(&ev->timeout);
 	ev->timeout.tv_sec += timo / 1000;
 	ev->timeout.tv_usec += (timo % 1000) * 1000;
-	if (ev->timeout.tv_usec > 1000000) {
+	if (ev->timeout.tv_usec >= 1000000) {
 		ev->timeout.tv_usec -= 1000000;
 		ev->timeout.tv_sec++;
 	}
-	if (ev->queued)
-		calctimeout = 1;
+	if (ev->queued && ev->type == EV_TIMEOUT)
+		evheap_update(&tevs, ev);
 }
@@ -50,13 +50,17 @@ struct Event {
 	int priority;
 	struct timeval timeout;
 	bool queued;		/* in evs queue */
-	int *condpos;		/* only active if condpos - condneg > 0 */
-	int *condneg;
+	bool blocked;		/* not dispatched until evunblock() */
+	Event *fdnext;		/* next event on the same fd */
+	int heapidx;		/* position in timeout heap */
 };
 
 void evenq (Event *);
 void evdeq (Event *);
+void evblock (Event *);
+void evunblock (Event *);
 void SetTimeout (Event *, int);
+void GetTime (struct timeval *);
 void sched (void);
 
 #endif /* SCREEN_SCHED_H */
@@ -159,6 +159,7 @@ int af;
 #include "attacher.h"
 #include "encoding.h"
 #include "help.h"
+#include "histpack.h"
 #include "misc.h"
 #include "process.h"
 #include "socket.h"
@@ -931,6 +932,7 @@ int main(int argc, char **argv)
 	sprintf(SocketPath + strlen(SocketPath), "/%s", socknamebuf);
 
 	ServerSocket = MakeServerSocket();
+	histpack_spillpath = SocketPath;
 	InitKeytab();
 #ifdef ETCSCREENRC
 #ifdef ALLOW_SYSSCREENRC
@@ -1724,6 +1726,11 @@ static void serv_select_fn(Event *event, void *data)
 		CV_CALL(D_forecv, LayRestore();
 			LaySetCursor());
 	}
+
+	/* start writing to displays which got new output */
+	for (display = displays; display; display = display->d_next)
+		if (D_status_obuffree < 0 && obuf_len(&D_obuf))
+			evunblock(&D_writeev);
 }
 
 static void logflush_fn(Event *event, void *data)
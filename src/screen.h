@@ -49,10 +49,11 @@
 #define MAXWIN		100
 
 /*
- * if a nasty user really wants to try a history of 3000 lines on all 10
- * windows, he will allocate 8 MegaBytes of memory, which is quite enough.
+ * Only the newest HOTHISTHEIGHT lines of the history are kept as they
+ * are, older lines are packed (see histpack.c) at a few bytes per line.
  */
 #define MAXHISTHEIGHT		3000
+#define HOTHISTHEIGHT		256
 #define DEFAULTHISTHEIGHT	100
 #define DEFAULT_BUFFERFILE	"/tmp/screen-exchange"
 
@@ -0,0 +1,179 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include "config.h"
+
+#include "sgr.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/*
+ * Select Graphic Rendition for ANSI terminals: everything that changes
+ * between two renditions goes into one CSI ... m sequence instead of
+ * one sequence per attribute and color. Colors are in mchar encoding
+ * and already reduced to what the terminal can show.
+ */
+
+/* bit 1 << c for each parameter c that turns on one of the attributes */
+static uint32_t sgr_codes(const SGR *sgr, uint32_t attr)
+{
+	uint32_t m = 0;
+
+	for (int i = 0; i < NATTR; i++)
+		if ((attr & (1 << i)) && sgr->attr[i])
+			m |= 1 << sgr->attr[i];
+	return m;
+}
+
+/* parameter that undoes c, 22 also undoes both bold and faint */
+static int sgr_offcode(int c)
+{
+	switch (c) {
+	case 1:
+	case 2:
+		return 22;
+	case 6:
+		return 25;
+	default:
+		return c > 2 && c < 10 ? 20 + c : 0;
+	}
+}
+
+/* parameter n followed by a separator */
+static char *sgr_num(char *p, unsigned int n)
+{
+	if (n >= 100)
+		*p++ = '0' + n / 100;
+	if (n >= 10)
+		*p++ = '0' + n / 10 % 10;
+	*p++ = '0' + n % 10;
+	*p++ = ';';
+	return p;
+}
+
+/* the parameters selecting color c, base is 30 or 40 */
+static char *sgr_color(char *p, uint32_t c, int base, int flags)
+{
+	if (c == 0)
+		return sgr_num(p, base + 9);
+	if (c & 0x02000000) {
+		if (flags & SGR_DIRECT) {
+			p = sgr_num(sgr_num(p, base + 8), 2);
+			p = sgr_num(sgr_num(sgr_num(p, (c >> 16) & 0xff), (c >> 8) & 0xff), c & 0xff);
+		}
+		return p;
+	}
+	c &= 0xff;
+	if (c < 8)
+		p = sgr_num(p, base + c);
+	else if (c < 16) {
+		if (flags & SGR_BRIGHT)
+			p = sgr_num(p, base + 60 + c - 8);
+	} else if (flags & SGR_INDEXED)
+		p = sgr_num(sgr_num(sgr_num(p, base + 8), 5), c);
+	return p;
+}
+
+/* the parameters for the attributes in mask m */
+static char *sgr_params(char *p, uint32_t m)
+{
+	for (int c = 0; m; c++, m >>= 1)
+		if (m & 1)
+			p = sgr_num(p, c);
+	return p;
+}
+
+/* change from -> to without resetting, false if that is not possible */
+static bool sgr_change(const SGR *sgr, const struct mstyle *from, const struct mstyle *to, char **pp)
+{
+	uint32_t f = sgr_codes(sgr, from->attr), t = sgr_codes(sgr, to->attr);
+	uint32_t drop = f & ~t, on = t & ~f, offs = 0;
+	char *p = *pp;
+
+	if (drop && !(sgr->flags & SGR_OFF))
+		return false;
+	if ((to->colorfg == 0 && from->colorfg != 0) || (to->colorbg == 0 && from->colorbg != 0))
+		if (!(sgr->flags & SGR_DEFAULT))
+			return false;
+	for (int c = 1; c < 10; c++)
+		if (drop & (1 << c)) {
+			int o = sgr_offcode(c);
+			if (!o)
+				return false;
+			offs |= 1 << (o - 20);
+		}
+	/* what the off parameters took along must come back */
+	for (int c = 1; c < 10; c++)
+		if ((t & f & (1 << c)) && (offs & (1 << (sgr_offcode(c) - 20))))
+			on |= 1 << c;
+	for (int o = 2; o < 10; o++)
+		if (offs & (1 << o))
+			p = sgr_num(p, 20 + o);
+	p = sgr_params(p, on);
+	if (to->colorfg != from->colorfg)
+		p = sgr_color(p, to->colorfg, 30, sgr->flags);
+	if (to->colorbg != from->colorbg)
+		p = sgr_color(p, to->colorbg, 40, sgr->flags);
+	*pp = p;
+	return true;
+}
+
+/* reset, then set everything of to */
+static void sgr_reset(const SGR *sgr, const struct mstyle *to, char **pp)
+{
+	char *p = *pp;
+
+	*p++ = ';';		/* an empty parameter is 0 */
+	p = sgr_params(p, sgr_codes(sgr, to->attr));
+	if (to->colorfg)
+		p = sgr_color(p, to->colorfg, 30, sgr->flags);
+	if (to->colorbg)
+		p = sgr_color(p, to->colorbg, 40, sgr->flags);
+	*pp = p;
+}
+
+/*
+ * Write the shortest sequence that takes the terminal from rendition
+ * from to rendition to into buf, which has room for SGRMAX bytes.
+ * Returns its length, 0 if the terminal shows to already.
+ */
+int sgr_encode(const SGR *sgr, const struct mstyle *from, const struct mstyle *to, char *buf)
+{
+	char chg[SGRMAX], rst[SGRMAX];
+	char *c = chg, *r = rst, *p;
+	bool changed;
+	int n;
+
+	changed = sgr_change(sgr, from, to, &c);
+	if (changed && c == chg)
+		return 0;
+	sgr_reset(sgr, to, &r);
+	if (changed && c - chg <= r - rst) {
+		p = chg;
+		n = c - chg - 1;	/* without the last ';' */
+	} else {
+		p = rst;
+		n = r - rst - 1;	/* \033[m if there is nothing else */
+	}
+	memcpy(buf, "\033[", 2);
+	memcpy(buf + 2, p, n);
+	buf[2 + n] = 'm';
+	return n + 3;
+}
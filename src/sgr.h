@@ -0,0 +1,44 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#ifndef SCREEN_SGR_H
+#define SCREEN_SGR_H
+
+#include <stdint.h>
+
+#include "ansi.h"
+#include "image.h"
+
+/* what a terminal's SGR sequence understands besides 0 and 30-37, 40-47 */
+#define SGR_OFF		(1<<0)	/* 22-29 switch single attributes off */
+#define SGR_DEFAULT	(1<<1)	/* 39 and 49 select the default colors */
+#define SGR_BRIGHT	(1<<2)	/* 90-97 and 100-107 select colors 8 to 15 */
+#define SGR_INDEXED	(1<<3)	/* 38;5;n and 48;5;n select colors above 15 */
+#define SGR_DIRECT	(1<<4)	/* 38;2;r;g;b and 48;2;r;g;b */
+
+#define SGRMAX		80	/* longest sequence sgr_encode writes */
+
+typedef struct SGR {
+	unsigned char attr[NATTR];	/* parameter turning on each attribute, 1-9, or 0 */
+	int flags;
+} SGR;
+
+int sgr_encode(const SGR *, const struct mstyle *, const struct mstyle *, char *);
+
+#endif /* SCREEN_SGR_H */
@@ -0,0 +1,298 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include "config.h"
+
+#include "shadow.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SHADOW_FIELDS 2		/* uint32_t arrays in a struct mline */
+
+/*
+ * Make room for a width x height terminal. Everything is unknown
+ * afterwards. Returns -1 if no memory is available, the shadow is
+ * empty then.
+ */
+int shadow_resize(Shadow *sh, int width, int height)
+{
+	size_t cells;
+
+	shadow_free(sh);
+	if (width <= 0 || height <= 0)
+		return 0;
+	cells = (size_t)width * height;
+	sh->lines = malloc(sizeof(struct mline) * height);
+	sh->known = calloc(height, sizeof(bool));
+	sh->gen = calloc(height, sizeof(uint64_t));
+	sh->mem = malloc(sizeof(uint32_t) * SHADOW_FIELDS * cells);
+	if (!sh->lines || !sh->known || !sh->gen || !sh->mem) {
+		shadow_free(sh);
+		return -1;
+	}
+	for (int y = 0; y < height; y++) {
+		uint32_t *p = sh->mem + (size_t)y * width * SHADOW_FIELDS;
+		sh->lines[y].image = p;
+		sh->lines[y].style = p + width;
+	}
+	sh->width = width;
+	sh->height = height;
+	return 0;
+}
+
+void shadow_free(Shadow *sh)
+{
+	free(sh->lines);
+	free(sh->known);
+	free(sh->gen);
+	free(sh->mem);
+	sh->lines = 0;
+	sh->known = 0;
+	sh->gen = 0;
+	sh->mem = 0;
+	sh->width = sh->height = 0;
+}
+
+/* Lines ys..ye no longer match the terminal. */
+void shadow_forget(Shadow *sh, int ys, int ye)
+{
+	if (ys < 0)
+		ys = 0;
+	if (ye >= sh->height)
+		ye = sh->height - 1;
+	for (int y = ys; y <= ye; y++) {
+		sh->known[y] = false;
+		sh->gen[y] = 0;
+	}
+}
+
+/* Whether all of the lines ys..ye are known. */
+bool shadow_known(const Shadow *sh, int ys, int ye)
+{
+	if (ys < 0 || ye >= sh->height || ys > ye)
+		return false;
+	for (int y = ys; y <= ye; y++)
+		if (!sh->known[y])
+			return false;
+	return true;
+}
+
+/* The content of line y, or NULL if it is unknown. */
+struct mline *shadow_line(Shadow *sh, int y)
+{
+	if (y < 0 || y >= sh->height || !sh->known[y])
+		return 0;
+	return &sh->lines[y];
+}
+
+void shadow_put(Shadow *sh, int x, int y, const struct mchar *mc)
+{
+	if (x < 0 || x >= sh->width || y < 0 || y >= sh->height)
+		return;
+	copy_mchar2mline(mc, &sh->lines[y], x);
+	sh->gen[y] = 0;
+}
+
+/* Put the n characters of s at x, y, with the rendition of mc. */
+void shadow_putstr(Shadow *sh, int x, int y, const char *s, int n, const struct mchar *mc)
+{
+	struct mline *ml;
+	uint32_t st;
+
+	if (y < 0 || y >= sh->height || x < 0)
+		return;
+	if (n > sh->width - x)
+		n = sh->width - x;
+	ml = &sh->lines[y];
+	st = mstyle_of(mc);
+	for (int i = 0; i < n; i++) {
+		ml->image[x + i] = (unsigned char)s[i];
+		ml->style[x + i] = st;
+	}
+	sh->gen[y] = 0;
+}
+
+/* Set columns xs..xe of line y, a line filled completely becomes known. */
+void shadow_fill(Shadow *sh, int xs, int xe, int y, const struct mchar *mc)
+{
+	if (y < 0 || y >= sh->height)
+		return;
+	if (xs < 0)
+		xs = 0;
+	if (xe >= sh->width)
+		xe = sh->width - 1;
+	for (int x = xs; x <= xe; x++)
+		copy_mchar2mline(mc, &sh->lines[y], x);
+	if (xs == 0 && xe == sh->width - 1)
+		sh->known[y] = true;
+	sh->gen[y] = 0;
+}
+
+/* Line y now shows ml. */
+void shadow_setline(Shadow *sh, int y, const struct mline *ml)
+{
+	struct mline *l;
+	size_t n;
+
+	if (y < 0 || y >= sh->height)
+		return;
+	l = &sh->lines[y];
+	n = sizeof(uint32_t) * sh->width;
+	memcpy(l->image, ml->image, n);
+	memcpy(l->style, ml->style, n);
+	sh->known[y] = true;
+	sh->gen[y] = 0;
+}
+
+/*
+ * Scroll lines ys..ye up by n lines, down if n is negative. The lines
+ * coming in are filled with mc, or unknown if mc is NULL.
+ */
+void shadow_scroll(Shadow *sh, int ys, int ye, int n, const struct mchar *mc)
+{
+	struct mline tmp;
+	bool tknown;
+	uint64_t tgen;
+	int up = n > 0;
+
+	if (ys < 0)
+		ys = 0;
+	if (ye >= sh->height)
+		ye = sh->height - 1;
+	if (ys > ye || n == 0)
+		return;
+	if (!up)
+		n = -n;
+	if (n > ye - ys + 1)
+		n = ye - ys + 1;
+	/* rotate the line structs, n single steps are fine for small n */
+	for (int i = 0; i < n; i++) {
+		if (up) {
+			tmp = sh->lines[ys];
+			tknown = sh->known[ys];
+			tgen = sh->gen[ys];
+			memmove(sh->lines + ys, sh->lines + ys + 1, sizeof(struct mline) * (ye - ys));
+			memmove(sh->known + ys, sh->known + ys + 1, sizeof(bool) * (ye - ys));
+			memmove(sh->gen + ys, sh->gen + ys + 1, sizeof(uint64_t) * (ye - ys));
+			sh->lines[ye] = tmp;
+			sh->known[ye] = tknown;
+			sh->gen[ye] = tgen;
+		} else {
+			tmp = sh->lines[ye];
+			tknown = sh->known[ye];
+			tgen = sh->gen[ye];
+			memmove(sh->lines + ys + 1, sh->lines + ys, sizeof(struct mline) * (ye - ys));
+			memmove(sh->known + ys + 1, sh->known + ys, sizeof(bool) * (ye - ys));
+			memmove(sh->gen + ys + 1, sh->gen + ys, sizeof(uint64_t) * (ye - ys));
+			sh->lines[ys] = tmp;
+			sh->known[ys] = tknown;
+			sh->gen[ys] = tgen;
+		}
+	}
+	for (int i = 0; i < n; i++) {
+		int y = up ? ye - i : ys + i;
+		if (mc)
+			shadow_fill(sh, 0, sh->width - 1, y, mc);
+		else
+			shadow_forget(sh, y, y);
+	}
+}
+
+/*
+ * Scroll columns xs..xe of lines ys..ye like shadow_scroll, for a
+ * terminal with left and right margins. A line stays known only if
+ * the line its columns came from was known.
+ */
+void shadow_scrollcols(Shadow *sh, int xs, int xe, int ys, int ye, int n, const struct mchar *mc)
+{
+	size_t w;
+	int up = n > 0;
+
+	if (xs < 0)
+		xs = 0;
+	if (xe >= sh->width)
+		xe = sh->width - 1;
+	if (xs == 0 && xe == sh->width - 1) {
+		shadow_scroll(sh, ys, ye, n, mc);
+		return;
+	}
+	if (ys < 0)
+		ys = 0;
+	if (ye >= sh->height)
+		ye = sh->height - 1;
+	if (ys > ye || xs > xe || n == 0)
+		return;
+	if (!up)
+		n = -n;
+	if (n > ye - ys + 1)
+		n = ye - ys + 1;
+	w = sizeof(uint32_t) * (xe - xs + 1);
+	for (int i = 0; i <= ye - ys - n; i++) {
+		int to = up ? ys + i : ye - i;
+		int from = up ? to + n : to - n;
+
+		memcpy(sh->lines[to].image + xs, sh->lines[from].image + xs, w);
+		memcpy(sh->lines[to].style + xs, sh->lines[from].style + xs, w);
+		sh->known[to] = sh->known[to] && sh->known[from];
+		sh->gen[to] = 0;
+	}
+	for (int i = 0; i < n; i++) {
+		int y = up ? ye - i : ys + i;
+		if (mc)
+			shadow_fill(sh, xs, xe, y, mc);
+		else
+			shadow_forget(sh, y, y);
+	}
+}
+
+/*
+ * The generation of the window row line y was drawn from in full, 0 if
+ * it has been changed in any other way since. See WinRowGen.
+ */
+uint64_t shadow_gen(const Shadow *sh, int y)
+{
+	if (y < 0 || y >= sh->height || !sh->known[y])
+		return 0;
+	return sh->gen[y];
+}
+
+void shadow_setgen(Shadow *sh, int y, uint64_t gen)
+{
+	if (y < 0 || y >= sh->height)
+		return;
+	sh->gen[y] = gen;
+}
+
+/*
+ * Cells from x on, up to to, that show the same in ml, ending at the
+ * last one that differs from what oml says is there. Cells at the end
+ * of the run that are already right need not be drawn again.
+ */
+int shadow_run(const struct mline *oml, const struct mline *ml, int x, int to)
+{
+	int n;
+
+	for (n = 1; x + n <= to; n++)
+		if (ml->image[x + n] != ml->image[x] || ml->style[x + n] != ml->style[x])
+			break;
+	while (n > 1 && cmp_mline(oml, ml, x + n - 1))
+		n--;
+	return n;
+}
@@ -0,0 +1,56 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#ifndef SCREEN_SHADOW_H
+#define SCREEN_SHADOW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "image.h"
+
+/*
+ * Model of what the user's terminal shows. Lines we are not sure
+ * about, e.g. after output we cannot follow, are marked unknown and
+ * must be redrawn in full before they can be trusted again.
+ */
+typedef struct Shadow {
+	struct mline *lines;
+	bool *known;		/* per line: lines[y] matches the terminal */
+	uint64_t *gen;		/* per line: window row generation it was drawn from, or 0 */
+	uint32_t *mem;		/* cell storage for all lines */
+	int width, height;
+} Shadow;
+
+int  shadow_resize(Shadow *, int, int);
+void shadow_free(Shadow *);
+void shadow_forget(Shadow *, int, int);
+bool shadow_known(const Shadow *, int, int);
+struct mline *shadow_line(Shadow *, int);
+void shadow_put(Shadow *, int, int, const struct mchar *);
+void shadow_putstr(Shadow *, int, int, const char *, int, const struct mchar *);
+void shadow_fill(Shadow *, int, int, int, const struct mchar *);
+void shadow_setline(Shadow *, int, const struct mline *);
+void shadow_scroll(Shadow *, int, int, int, const struct mchar *);
+void shadow_scrollcols(Shadow *, int, int, int, int, int, const struct mchar *);
+uint64_t shadow_gen(const Shadow *, int);
+void shadow_setgen(Shadow *, int, uint64_t);
+int  shadow_run(const struct mline *, const struct mline *, int, int);
+
+#endif /* SCREEN_SHADOW_H */
@@ -351,6 +351,7 @@ static void TelReply(Window *win, char *str, size_t len)
 	}
 	bcopy(str, win->w_inbuf + win->w_inlen, len);
 	win->w_inlen += len;
+	evunblock(&win->w_writeev);
 }
 
 static void TelDocmd(Window *win, int cmd, int opt)
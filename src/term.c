@@ -66,6 +66,8 @@ struct term term[T_N] =
   { "AL", T_STR  },
   { "dl", T_STR  },
   { "DL", T_STR  },
+  { "ML", T_STR  },
+  { "MC", T_STR  },
 
 /* insert/delete */
   { "in", T_FLG  },
@@ -83,8 +85,12 @@ struct term term[T_N] =
   { "CD", T_STR  },
   { "ce", T_STR  },
   { "cb", T_STR  },
+  { "ec", T_STR  },
   { "E3", T_STR  },
 
+/* repeat */
+  { "rp", T_STR  },
+
 /* initialise */
   { "is", T_STR  },
   { "ti", T_STR  },
@@ -165,6 +171,8 @@ struct term term[T_N] =
   { "VN", T_STR  },
   { "TF", T_FLG  },
   { "XT", T_FLG  },
+  { "SY", T_FLG  },
+  { "LR", T_FLG  },
 
 /* d_font setting */
   { "G0", T_FLG  },
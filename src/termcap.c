@@ -52,6 +52,10 @@ static int findseq_ge(char *, int, unsigned char **);
 static void setseqoff(unsigned char *, int, int);
 static int addmapseq(char *, int, int);
 static int remmapseq(char *, int);
+static void CalcMoveCosts(short *, char *);
+static bool IsAnsiCM(char *);
+static bool IsAnsiSGR(SGR *);
+static bool IsAnsiREP(char *);
 
 char Termcap[TERMCAP_BUFSIZE + 8];	/* new termcap +8:"TERMCAP=" */
 static int Termcaplen;
@@ -82,6 +86,101 @@ char *gettermcapstring(char *s)
 	return 0;
 }
 
+/* The cost of the counted move s for all counts below MOVECOSTS. */
+static void CalcMoveCosts(short *costs, char *s)
+{
+	for (int n = 0; n < MOVECOSTS; n++)
+		costs[n] = s ? CalcCost(tgoto(s, 0, n)) : EXPENSIVE;
+}
+
+/*
+ * Whether cm is ESC [ y ; x H with one based coordinates and without
+ * padding, which GotoPos can put together faster than tgoto.
+ */
+static bool IsAnsiCM(char *cm)
+{
+	static const int pos[][2] = { { 0, 0 }, { 8, 9 }, { 9, 99 }, { 99, 9 }, { 123, 4567 } };
+	char buf[32];
+
+	if (!cm)
+		return false;
+	for (size_t i = 0; i < sizeof(pos) / sizeof(*pos); i++) {
+		sprintf(buf, "\033[%d;%dH", pos[i][1] + 1, pos[i][0] + 1);
+		if (strcmp(tgoto(cm, pos[i][0], pos[i][1]), buf))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Whether attributes and colors are plain ANSI SGR sequences, which
+ * SetRendition can then merge into one. Fills in the parameter of
+ * each attribute and what else the terminal understands.
+ */
+static bool IsAnsiSGR(SGR *sgr)
+{
+	static const int idx[] = { 16, 87, 255 };
+	char buf[32];
+
+	memset(sgr, 0, sizeof(*sgr));
+	if (!D_ME || !D_CAF || !D_CAB)
+		return false;
+	if (strcmp(D_ME, "\033[m") && strcmp(D_ME, "\033[0m") &&
+	    strcmp(D_ME, "\033(B\033[m") && strcmp(D_ME, "\033(B\033[0m"))
+		return false;
+	for (int i = 0; i < NATTR; i++) {
+		char *s = D_attrtab[i];
+
+		if (!s)
+			continue;
+		if (strlen(s) != 4 || s[0] != '\033' || s[1] != '[' || s[2] < '1' || s[2] > '9' || s[3] != 'm')
+			return false;
+		sgr->attr[i] = s[2] - '0';
+	}
+	for (int c = 0; c < 8; c++) {
+		sprintf(buf, "\033[3%dm", c);
+		if (strcmp(tgoto(D_CAF, 0, c), buf))
+			return false;
+		sprintf(buf, "\033[4%dm", c);
+		if (strcmp(tgoto(D_CAB, 0, c), buf))
+			return false;
+	}
+	if (D_CCO == 88 || D_CCO == 256) {
+		for (size_t i = 0; i < sizeof(idx) / sizeof(*idx) && idx[i] < D_CCO; i++) {
+			sprintf(buf, "\033[38;5;%dm", idx[i]);
+			if (strcmp(tgoto(D_CAF, 0, idx[i]), buf))
+				return false;
+			sprintf(buf, "\033[48;5;%dm", idx[i]);
+			if (strcmp(tgoto(D_CAB, 0, idx[i]), buf))
+				return false;
+		}
+		sgr->flags |= SGR_INDEXED;
+	}
+	sgr->flags |= SGR_OFF;
+	if (D_CAX)
+		sgr->flags |= SGR_DEFAULT;
+	if (D_CXT)
+		sgr->flags |= SGR_BRIGHT;
+	return true;
+}
+
+/*
+ * Whether rp is the character followed by ESC [ n-1 b. The character
+ * can then go out the usual way with only the repeat added after it.
+ */
+static bool IsAnsiREP(char *rp)
+{
+	static const int counts[] = { 2, 10, 200 };
+	char buf[32];
+
+	for (size_t i = 0; i < sizeof(counts) / sizeof(*counts); i++) {
+		sprintf(buf, "x\033[%db", counts[i] - 1);
+		if (strcmp(tgoto(rp, counts[i], 'x'), buf))
+			return false;
+	}
+	return true;
+}
+
 /*
  * Compile the terminal capabilities for a display.
  * Input: tgetent(, D_termname) extra_incap, extra_outcap.
@@ -362,14 +461,21 @@ int InitTermcap(int width, int height)
 	D_CRcost = CalcCost(D_CR);
 	D_IMcost = CalcCost(D_IM);
 	D_EIcost = CalcCost(D_EI);
+	D_HOcost = CalcCost(D_HO);
+	CalcMoveCosts(D_CRIcost, D_CRI);
+	CalcMoveCosts(D_CLEcost, D_CLE);
+	CalcMoveCosts(D_CDOcost, D_CDO);
+	CalcMoveCosts(D_CUPcost, D_CUP);
+	D_CMansi = IsAnsiCM(D_CM);
+	D_SGRansi = IsAnsiSGR(&D_sgr);
+	if (D_RP && !IsAnsiREP(D_RP))
+		D_RP = 0;	/* see DisplayRun */
 
 	if (D_CAN) {
 		D_auto_nuke = true;
 	}
-	if (D_COL > 0) {
+	if (D_COL > 0)
 		D_obufmax = D_COL;
-		D_obuflenmax = D_obuflen - D_obufmax;
-	}
 
 	/* Some xterm entries set F0 and F10 to the same string. Nuke F0. */
 	if (D_tcs[T_CAPS].str && D_tcs[T_CAPS + 10].str && !strcmp(D_tcs[T_CAPS].str, D_tcs[T_CAPS + 10].str))
@@ -456,6 +562,14 @@ int remap(int n, int map)
 		return remmapseq(s, l);
 }
 
+/* Have the display take seq out of its input as key nr, or stop that. */
+int mapseq(char *seq, int nr, bool map)
+{
+	if (map)
+		return addmapseq(seq, strlen(seq), nr);
+	return remmapseq(seq, strlen(seq));
+}
+
 void CheckEscape()
 {
 	Display *odisplay;
@@ -468,6 +582,8 @@ void CheckEscape()
 	for (display = displays; display; display = display->d_next) {
 		for (i = 0; i < D_nseqs; i += D_kmaps[i + 2] * 2 + 4) {
 			nr = (D_kmaps[i] << 8 | D_kmaps[i + 1]) & ~KMAP_NOTIMEOUT;
+			if (nr >= KMAP_MODES)
+				continue;
 			if (nr < KMAP_KEYS + KMAP_AKEYS) {
 				if (umtab[nr].nr == RC_COMMAND)
 					break;
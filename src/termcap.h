@@ -7,6 +7,7 @@ int   InitTermcap (int, int);
 char *MakeTermcap (bool);
 char *gettermcapstring (char *);
 int   remap (int, int);
+int   mapseq (char *, int, bool);
 void  CheckEscape (void);
 int   CreateTransTable (char *);
 void  FreeTransTable (void);
@@ -0,0 +1,171 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+/* Decoding throughput of charscan_utf8 against the byte at a time
+ * FromUtf8 state machine, on plain ASCII, compiler style output with a
+ * few typographic quotes, and CJK text. */
+
+#define _POSIX_C_SOURCE 200809L	/* clock_gettime */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../charscan.h"
+
+#define SIZE	(16 << 20)
+#define CHUNK	4096	/* characters decoded per call */
+#define ROUNDS	5
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* FromUtf8 from encoding.c */
+static int FromUtf8(int c, int *utf8charp)
+{
+	int utf8char = *utf8charp;
+	if (utf8char) {
+		if ((c & 0xc0) != 0x80) {
+			*utf8charp = 0;
+			return -2;
+		} else
+			c = (c & 0x3f) | (utf8char << 6);
+		if (!(utf8char & 0x40000000)) {
+			if ((c & 0x820823e0) == 0x80000000)
+				c = 0xfdffffff;
+			else if ((c & 0x020821f0) == 0x02000000)
+				c = 0xfff7ffff;
+			else if ((c & 0x000820f8) == 0x00080000)
+				c = 0xffffd000;
+			else if ((c & 0x0000207c) == 0x00002000)
+				c = 0xffffff70;
+		}
+	} else {
+		if (c >= 0xfe)
+			c = 0xfffd;
+		else if (c >= 0xfc)
+			c = (c & 0x01) | 0xbffffffc;
+		else if (c >= 0xf8)
+			c = (c & 0x03) | 0xbfffff00;
+		else if (c >= 0xf0)
+			c = (c & 0x07) | 0xbfffc000;
+		else if (c >= 0xe0)
+			c = (c & 0x0f) | 0xbff00000;
+		else if (c >= 0xc2)
+			c = (c & 0x1f) | 0xfc000000;
+		else if (c >= 0xc0)
+			c = 0xfdffffff;
+		else if (c >= 0x80)
+			c = 0xfffd;
+	}
+	*utf8charp = utf8char = (c & 0x80000000) ? c : 0;
+	if (utf8char)
+		return -1;
+	if (c & 0xff800000)
+		c = 0xfffd;
+	if (c >= 0xd800 && (c <= 0xdfff || c == 0xfffe || c == 0xffff))
+		c = 0xfffd;
+	return c;
+}
+
+static void fill(char *buf, const char *const *words, int nwords)
+{
+	size_t n = 0;
+
+	srand(1);
+	while (n < SIZE - 64) {
+		const char *w = words[rand() % nwords];
+		size_t l = strlen(w);
+
+		memcpy(buf + n, w, l);
+		n += l;
+	}
+	while (n < SIZE)
+		buf[n++] = '\n';
+}
+
+static void bench(const char *name, const char *buf, int *out)
+{
+	double tb = 1e9, ts = 1e9, t;
+	unsigned long sumb = 0, sums = 0;
+
+	for (int r = 0; r < ROUNDS; r++) {
+		sumb = sums = 0;
+		t = now();
+		for (size_t used = 0, k; used < SIZE;) {
+			used += charscan_utf8(buf + used, SIZE - used, out, CHUNK, &k);
+			for (size_t j = 0; j < k; j++)
+				sumb += out[j];
+			if (k == 0) {
+				fprintf(stderr, "%s: stalled at %zu\n", name, used);
+				exit(1);
+			}
+		}
+		if ((t = now() - t) < tb)
+			tb = t;
+
+		t = now();
+		{
+			int state = 0, c;
+
+			for (size_t i = 0; i < SIZE; i++)
+				if ((c = FromUtf8((unsigned char)buf[i], &state)) >= 0)
+					sums += c;
+		}
+		if ((t = now() - t) < ts)
+			ts = t;
+	}
+	if (sumb != sums) {
+		fprintf(stderr, "%s: decoders disagree\n", name);
+		exit(1);
+	}
+	printf("%-10s bulk %7.0f MB/s  FromUtf8 %7.0f MB/s\n", name, SIZE / tb / 1e6, SIZE / ts / 1e6);
+}
+
+int main(void)
+{
+	static const char *const ascii[] = { "static ", "int ", "main", "(void)", " {\n", "\treturn 0;\n", "}\n" };
+	static const char *const gcc[] = {
+		"main.c:12:5: ", "error: ", "unknown type name ", "\xe2\x80\x98" "foo" "\xe2\x80\x99", "; did you mean ",
+		"\xe2\x80\x98" "FILE" "\xe2\x80\x99", "?\n", "   12 |     foo x;\n", "      |     ^~~\n"
+	};
+	static const char *const cjk[] = {
+		"\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e", "\xe4\xb8\xad\xe6\x96\x87", "\xed\x95\x9c\xea\xb5\xad\xec\x96\xb4",
+		"\xe3\x83\x86\xe3\x82\xb9\xe3\x83\x88", " ", "\xe3\x80\x82", "\n"
+	};
+	char *buf = malloc(SIZE);
+	int *out = malloc(CHUNK * sizeof(int));
+
+	if (buf == NULL || out == NULL)
+		return 1;
+	fill(buf, ascii, sizeof(ascii) / sizeof(*ascii));
+	bench("ascii", buf, out);
+	fill(buf, gcc, sizeof(gcc) / sizeof(*gcc));
+	bench("compiler", buf, out);
+	fill(buf, cjk, sizeof(cjk) / sizeof(*cjk));
+	bench("cjk", buf, out);
+	free(buf);
+	free(out);
+	return 0;
+}
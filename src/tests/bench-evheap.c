@@ -0,0 +1,90 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+/* Microbenchmark for the timeout heap used by sched(): arms, rearms and
+ * cancels timers the way per-window silence and per-canvas caption timers do,
+ * for growing numbers of timers. Cost per operation should grow
+ * logarithmically. */
+
+#define _POSIX_C_SOURCE 200809L	/* clock_gettime */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../evheap.h"
+
+#define OPS 1000000
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(int ntimers)
+{
+	EventHeap h = { 0 };
+	Event *evs = calloc(ntimers, sizeof(Event));
+	double t;
+
+	if (evs == NULL)
+		exit(1);
+	srand(ntimers);
+	for (int i = 0; i < ntimers; i++) {
+		evs[i].timeout.tv_sec = rand() % 3600;
+		evheap_push(&h, &evs[i]);
+	}
+
+	t = now();
+	for (int i = 0; i < OPS; i++) {
+		Event *ev = &evs[rand() % ntimers];
+		switch (i % 4) {
+		case 0:		/* rearm, like SetTimeout on a queued event */
+			ev->timeout.tv_sec = rand() % 3600;
+			evheap_update(&h, ev);
+			break;
+		case 1:		/* cancel and re-enqueue */
+			evheap_remove(&h, ev);
+			evheap_push(&h, ev);
+			break;
+		case 2:		/* fire the next timer */
+			ev = evheap_top(&h);
+			evheap_remove(&h, ev);
+			ev->timeout.tv_sec += 3600;
+			evheap_push(&h, ev);
+			break;
+		default:	/* next deadline lookup */
+			(void)evheap_top(&h);
+			break;
+		}
+	}
+	t = now() - t;
+	printf("%6d timers: %7.1f ns/op\n", ntimers, t * 1e9 / OPS);
+	evheap_free(&h);
+	free(evs);
+}
+
+int main(void)
+{
+	for (int n = 10; n <= 10000; n *= 10)
+		bench(n);
+	return 0;
+}
@@ -0,0 +1,102 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+/* Shell-like output of varying length, some of it colored, packed into
+ * the history and read back in order, as copy mode pages through it,
+ * and at random. Reports the size per line against the 8 bytes per
+ * cell the lines take unpacked. */
+
+#define _POSIX_C_SOURCE 200809L	/* clock_gettime */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../histpack.h"
+
+#define WIDTH	120
+#define LINES	200000
+#define READS	200000
+
+static const char *words[] = {
+	"drwxr-xr-x", "root", "4096", "Oct", "17", "src/", "main.c", "-rw-r--r--",
+	"make:", "Entering", "directory", "gcc", "-O2", "-c", "warning:", "unused",
+};
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void make(struct mline *ml, long n)
+{
+	struct mchar mc = { 0 };
+	int x = 0, len = (n * 7919) % (WIDTH - 20);
+
+	for (int i = 0; i <= WIDTH; i++)
+		ml->image[i] = ' ';
+	memset(ml->style, 0, (WIDTH + 1) * sizeof(uint32_t));
+	mc.colorfg = 1 + n % 7;
+	for (long w = n; x < len; w = w * 31 + 7) {
+		const char *s = words[w % 16];
+
+		for (; *s && x < WIDTH; s++, x++) {
+			ml->image[x] = *s;
+			if (n % 5 == 0 && x < 10)
+				ml->style[x] = mstyle_intern(&mc);
+		}
+		x++;
+	}
+}
+
+int main(void)
+{
+	HistPack hp = { 0 };
+	uint32_t image[WIDTH + 1], style[WIDTH + 1];
+	struct mline ml = { image, style };
+	unsigned long sum = 0;
+	double t, tpush = 0;
+
+	for (long n = 0; n < LINES; n++) {
+		make(&ml, n);
+		t = now();
+		if (histpack_push(&hp, &ml, WIDTH))
+			return 1;
+		tpush += now() - t;
+	}
+	printf("%d lines: %.1f bytes/line packed, %d unpacked\n",
+	       hp.lines, (double)histpack_size(&hp) / hp.lines, (WIDTH + 1) * 8);
+	printf("push       %7.1f ns/line\n", tpush / LINES * 1e9);
+
+	t = now();
+	for (int y = 0; y < hp.lines; y++)
+		sum += histpack_line(&hp, y, WIDTH)->image[0];
+	printf("in order   %7.1f ns/line\n", (now() - t) / hp.lines * 1e9);
+
+	srand(1);
+	t = now();
+	for (int i = 0; i < READS; i++)
+		sum += histpack_line(&hp, rand() % hp.lines, WIDTH)->image[0];
+	printf("at random  %7.1f ns/line\n", (now() - t) / READS * 1e9);
+
+	histpack_free(&hp);
+	return sum ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+/* Allocations made while a colored tail -f scrolls a window, with the
+ * per-cell arrays coming from malloc as before and from linepool. Every
+ * new line gets attr, colorfg and colorbg arrays, and scrolling a line
+ * into the history frees what the oldest history line had. */
+
+#define _POSIX_C_SOURCE 200809L	/* clock_gettime */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../linepool.h"
+
+#define WIDTH	(132 + 1)
+#define HEIGHT	50
+#define HIST	1000
+#define LINES	2000000
+#define NARRAYS	3	/* attr, colorfg, colorbg */
+
+struct line {
+	uint32_t *a[NARRAYS];
+};
+
+static unsigned long mallocs, frees;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t *old_alloc(int len)
+{
+	mallocs++;
+	return calloc(len, 4);
+}
+
+static void old_free(uint32_t *a)
+{
+	frees++;
+	free(a);
+}
+
+/* WAddLineToHist and MFixLine, with the given allocator */
+static double scroll(uint32_t *(*alloc)(int), void (*release)(uint32_t *))
+{
+	static struct line screen[HEIGHT], hist[HIST];
+	double t = now();
+	int histidx = 0;
+
+	for (long n = 0; n < LINES; n++) {
+		struct line *ml = &screen[n % HEIGHT], *hml = &hist[histidx];
+
+		for (int i = 0; i < NARRAYS; i++) {
+			if (hml->a[i])
+				release(hml->a[i]);
+			hml->a[i] = ml->a[i];
+			ml->a[i] = alloc(WIDTH);
+			ml->a[i][n % WIDTH] = n;
+		}
+		if (++histidx == HIST)
+			histidx = 0;
+	}
+	t = now() - t;
+	for (int y = 0; y < HEIGHT; y++)
+		for (int i = 0; i < NARRAYS; i++) {
+			if (screen[y].a[i])
+				release(screen[y].a[i]);
+			screen[y].a[i] = 0;
+		}
+	for (int y = 0; y < HIST; y++)
+		for (int i = 0; i < NARRAYS; i++) {
+			if (hist[y].a[i])
+				release(hist[y].a[i]);
+			hist[y].a[i] = 0;
+		}
+	return t;
+}
+
+int main(void)
+{
+	double t;
+
+	t = scroll(old_alloc, old_free);
+	printf("malloc   %8lu mallocs %8lu frees  %5.1f ns/line\n", mallocs, frees, t / LINES * 1e9);
+	t = scroll(linepool_alloc, linepool_free);
+	printf("linepool %8lu mallocs %8lu frees  %5.1f ns/line\n", linepool_stats.mallocs, linepool_stats.releases,
+	       t / LINES * 1e9);
+	return 0;
+}
@@ -0,0 +1,141 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+/* A colored line written cell by cell and then compared against the
+ * display's copy of it, as MPutChar and DisplayLine do, with the old
+ * six arrays per line and with an image array plus a style index. Each
+ * line is written twice, so half of the comparisons find the display
+ * up to date. */
+
+#define _POSIX_C_SOURCE 200809L	/* clock_gettime */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../image.h"
+
+#define WIDTH	160
+#define LINES	200000
+#define NCOLORS	16	/* colors in use on a line */
+
+/* the line before: one array per field */
+struct oldline {
+	uint32_t *image, *attr, *font, *fontx, *colorbg, *colorfg;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t *array(void)
+{
+	return calloc(WIDTH, sizeof(uint32_t));
+}
+
+static struct mchar cell(long n, int x)
+{
+	struct mchar mc = { 'a' + (n / 2 + x) % 26, (x / 8) & 1, 0, 0, 0, 0, 0 };
+
+	mc.colorfg = 0x1000000 | (((n / 14 + x / 10) % NCOLORS) * 0x0f0f0f);
+	return mc;
+}
+
+static double old_lines(unsigned long *diffs, double *tcmp)
+{
+	struct oldline a = { array(), array(), array(), array(), array(), array() };
+	struct oldline d = { array(), array(), array(), array(), array(), array() };
+	double t = 0, t0;
+
+	*tcmp = 0;
+	for (long n = 0; n < LINES; n++) {
+		t0 = now();
+		for (int x = 0; x < WIDTH; x++) {
+			struct mchar mc = cell(n, x);
+
+			a.image[x] = mc.image;
+			a.attr[x] = mc.attr;
+			a.font[x] = mc.font;
+			a.fontx[x] = mc.fontx;
+			a.colorbg[x] = mc.colorbg;
+			a.colorfg[x] = mc.colorfg;
+		}
+		t += now() - t0;
+		t0 = now();
+		for (int x = 0; x < WIDTH; x++) {
+			if (a.image[x] == d.image[x] && a.attr[x] == d.attr[x] && a.font[x] == d.font[x] &&
+			    a.fontx[x] == d.fontx[x] && a.colorbg[x] == d.colorbg[x] && a.colorfg[x] == d.colorfg[x])
+				continue;
+			(*diffs)++;
+			d.image[x] = a.image[x];
+			d.attr[x] = a.attr[x];
+			d.font[x] = a.font[x];
+			d.fontx[x] = a.fontx[x];
+			d.colorbg[x] = a.colorbg[x];
+			d.colorfg[x] = a.colorfg[x];
+		}
+		*tcmp += now() - t0;
+	}
+	return t;
+}
+
+static double new_lines(unsigned long *diffs, double *tcmp)
+{
+	struct mline a = { array(), array() };
+	struct mline d = { array(), array() };
+	double t = 0, t0;
+
+	*tcmp = 0;
+	for (long n = 0; n < LINES; n++) {
+		t0 = now();
+		for (int x = 0; x < WIDTH; x++) {
+			struct mchar mc = cell(n, x);
+
+			copy_mchar2mline(&mc, &a, x);
+		}
+		t += now() - t0;
+		t0 = now();
+		for (int x = 0; x < WIDTH; x++) {
+			if (cmp_mline(&a, &d, x))
+				continue;
+			(*diffs)++;
+			d.image[x] = a.image[x];
+			d.style[x] = a.style[x];
+		}
+		*tcmp += now() - t0;
+	}
+	return t;
+}
+
+int main(void)
+{
+	unsigned long od = 0, nd = 0;
+	double t, tc;
+
+	t = old_lines(&od, &tc);
+	printf("6 arrays  %2zu bytes/cell %9lu diffs  write %6.1f ns/line  compare %6.1f ns/line\n",
+	       6 * sizeof(uint32_t), od, t / LINES * 1e9, tc / LINES * 1e9);
+	t = new_lines(&nd, &tc);
+	printf("mstyle    %2zu bytes/cell %9lu diffs  write %6.1f ns/line  compare %6.1f ns/line\n",
+	       2 * sizeof(uint32_t), nd, t / LINES * 1e9, tc / LINES * 1e9);
+	return od == nd ? 0 : 1;
+}
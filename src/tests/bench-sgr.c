@@ -0,0 +1,147 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+/* The renditions of a colorful screen redrawn cell by cell, once with a
+ * sequence per attribute and color as the termcap strings of an
+ * xterm-256color give them, and once with sgr_encode. Reports the
+ * bytes spent on renditions per redraw. */
+
+#define _POSIX_C_SOURCE 200809L	/* clock_gettime */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../sgr.h"
+
+#define WIDTH	200
+#define HEIGHT	60
+#define REDRAWS	2000
+
+static SGR xterm = { { 2, 4, 1, 7, 7, 5 }, SGR_OFF | SGR_DEFAULT | SGR_BRIGHT | SGR_INDEXED | SGR_DIRECT };
+static struct mstyle screen[HEIGHT][WIDTH];
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* runs of text in a few styles, like highlighted source or ls output */
+static void fill(void)
+{
+	static const struct mstyle styles[] = {
+		{ 0, 0, 0, 0, 0 },
+		{ A_BD, 0, 0, 0, 0x01000004 },
+		{ 0, 0, 0, 0, 0x01000002 },
+		{ A_BD, 0, 0, 0, 0x01000001 },
+		{ A_US, 0, 0, 0, 0x01000006 },
+		{ 0, 0, 0, 0x01000004, 0x01000007 },
+		{ A_RV, 0, 0, 0, 0 },
+		{ 0, 0, 0, 0, 0x010000d0 },
+		{ A_BD | A_US, 0, 0, 0x010000ec, 0x0100000b },
+		{ 0, 0, 0, 0, 0x02ff8000 },
+	};
+	unsigned long r = 1;
+
+	for (int y = 0; y < HEIGHT; y++)
+		for (int x = 0; x < WIDTH; ) {
+			int n, s;
+
+			r = r * 1103515245 + 12345;
+			n = 1 + (r >> 8) % 12;
+			s = (r >> 20) % (sizeof(styles) / sizeof(*styles));
+			while (n-- && x < WIDTH)
+				screen[y][x++] = styles[s];
+		}
+}
+
+static void color(char **p, uint32_t c, int base)
+{
+	if (c == 0)
+		*p += sprintf(*p, "\033[%dm", base + 9);
+	else if (c & 0x02000000)
+		*p += sprintf(*p, "\033[%d;2;%u;%u;%um", base + 8, (c >> 16) & 0xff, (c >> 8) & 0xff, c & 0xff);
+	else if ((c &= 0xff) < 8)
+		*p += sprintf(*p, "\033[%um", base + c);
+	else if (c < 16)
+		*p += sprintf(*p, "\033[%um", base + 60 + c - 8);
+	else
+		*p += sprintf(*p, "\033[%d;5;%um", base + 8, c);
+}
+
+/* what SetAttr and SetColor send: sgr0 when an attribute goes away */
+static int termcap(const struct mstyle *from, const struct mstyle *to, char *buf)
+{
+	uint32_t fg = from->colorfg, bg = from->colorbg, old = from->attr;
+	char *p = buf;
+
+	if ((to->attr & old) != old) {
+		p += sprintf(p, "\033(B\033[m");
+		old = fg = bg = 0;
+	}
+	for (int i = 0; i < NATTR; i++)
+		if (((to->attr ^ old) & (1 << i)) && !(old & (1 << i)))
+			p += sprintf(p, "\033[%dm", xterm.attr[i]);
+	if (to->colorfg != fg)
+		color(&p, to->colorfg, 30);
+	if (to->colorbg != bg)
+		color(&p, to->colorbg, 40);
+	return p - buf;
+}
+
+static double run(int (*enc)(const struct mstyle *, const struct mstyle *, char *), unsigned long *bytes)
+{
+	struct mstyle cur = { 0, 0, 0, 0, 0 };
+	char buf[256];
+	double t0 = now();
+
+	*bytes = 0;
+	for (int n = 0; n < REDRAWS; n++)
+		for (int y = 0; y < HEIGHT; y++)
+			for (int x = 0; x < WIDTH; x++) {
+				const struct mstyle *to = &screen[y][x];
+
+				if (to->attr == cur.attr && to->colorfg == cur.colorfg && to->colorbg == cur.colorbg)
+					continue;
+				*bytes += enc(&cur, to, buf);
+				cur = *to;
+			}
+	return now() - t0;
+}
+
+static int single(const struct mstyle *from, const struct mstyle *to, char *buf)
+{
+	return sgr_encode(&xterm, from, to, buf);
+}
+
+int main(void)
+{
+	unsigned long ob, nb;
+	double t;
+
+	fill();
+	t = run(termcap, &ob);
+	printf("termcap  %7lu bytes/redraw  %6.1f us/redraw\n", ob / REDRAWS, t / REDRAWS * 1e6);
+	t = run(single, &nb);
+	printf("sgr      %7lu bytes/redraw  %6.1f us/redraw  %.1f%% saved\n", nb / REDRAWS, t / REDRAWS * 1e6,
+	       100.0 * (ob - nb) / ob);
+	return nb < ob ? 0 : 1;
+}
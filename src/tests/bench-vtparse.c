@@ -0,0 +1,386 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+/* Throughput of the WriteString dispatch: the nested switch screen used
+ * before vtparse and the table lookup, run over the same streams with
+ * the actions reduced to bookkeeping. Streams are recorded terminal
+ * output given as arguments, or a few generated ones: a directory
+ * listing with colours, full screen editor redraws, a progress meter and
+ * title updates. Both parsers must agree on what they saw. */
+
+#define _POSIX_C_SOURCE 200809L	/* clock_gettime */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../vtparse.h"
+
+#define NARGS	64
+#define SIZE	(8 << 20)
+#define ROUNDS	5
+
+struct parser {
+	int state;
+	int nargs, args[NARGS];
+	int intermediate;
+	unsigned long sum;	/* what the actions saw */
+};
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int special(struct parser *p, int c)
+{
+	switch (c) {
+	case '\b':
+	case '\r':
+	case '\n':
+	case '\013':
+	case '\007':
+	case '\t':
+	case '\017':
+	case '\016':
+		p->sum += c;
+		return 1;
+	}
+	return 0;
+}
+
+static void dispatch(struct parser *p, int c)
+{
+	p->sum = p->sum * 31 + c + p->intermediate;
+	for (int i = 0; i < p->nargs; i++)
+		p->sum += p->args[i];
+}
+
+static void csientry(struct parser *p)
+{
+	p->nargs = 0;
+	p->intermediate = 0;
+	memset(p->args, 0, sizeof(p->args));
+}
+
+static void param(struct parser *p, int c)
+{
+	if (p->nargs < NARGS && p->args[p->nargs] < 100000000)
+		p->args[p->nargs] = 10 * p->args[p->nargs] + (c - '0');
+}
+
+/* The switch from WriteString before the table, printer mode left out. */
+static void switch_parse(struct parser *p, const unsigned char *buf, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		int c = buf[i];
+ tryagain:
+		switch (p->state) {
+		case ASTR:
+			if (c == 0)
+				break;
+			if (c == '\033') {
+				p->state = STRESC;
+				break;
+			}
+			if (c >= ' ' || c == '\005') {
+				if (c != 0x9c) {
+					p->sum += c;
+					break;
+				}
+			}
+			c = '\\';
+			/* FALLTHROUGH */
+		case STRESC:
+			switch (c) {
+			case '\\':
+				p->state = LIT;
+				dispatch(p, c);
+				break;
+			case '\033':
+				p->sum += c;
+				break;
+			default:
+				p->state = ASTR;
+				p->sum += 033 + c;
+				break;
+			}
+			break;
+		case ESC:
+			switch (c) {
+			case '[':
+				csientry(p);
+				p->state = CSI;
+				break;
+			case ']':
+			case '_':
+			case 'P':
+			case '^':
+			case '!':
+			case '"':
+			case 'k':
+				p->state = ASTR;
+				break;
+			default:
+				if (special(p, c)) {
+					p->state = LIT;
+					break;
+				}
+				if (c >= ' ' && c <= '/') {
+					p->intermediate = p->intermediate ? -1 : c;
+				} else if (c >= '0' && c <= '~') {
+					dispatch(p, c);
+					p->state = LIT;
+				} else {
+					p->state = LIT;
+					goto tryagain;
+				}
+			}
+			break;
+		case CSI:
+			switch (c) {
+			case '0':
+			case '1':
+			case '2':
+			case '3':
+			case '4':
+			case '5':
+			case '6':
+			case '7':
+			case '8':
+			case '9':
+				param(p, c);
+				break;
+			case ';':
+			case ':':
+				if (p->nargs < NARGS)
+					p->nargs++;
+				break;
+			default:
+				if (special(p, c))
+					break;
+				if (c >= '@' && c <= '~') {
+					if (p->nargs < NARGS)
+						p->nargs++;
+					dispatch(p, c);
+					p->state = LIT;
+				} else if ((c >= ' ' && c <= '/') || (c >= '<' && c <= '?'))
+					p->intermediate = p->intermediate ? -1 : c;
+				else {
+					p->state = LIT;
+					goto tryagain;
+				}
+			}
+			break;
+		case LIT:
+		default:
+			if (c < ' ') {
+				if (c == '\033') {
+					p->intermediate = 0;
+					p->state = ESC;
+				} else
+					special(p, c);
+				break;
+			}
+			if (c >= 0x80 && c < 0xa0) {
+				if (c == 0x9b) {
+					csientry(p);
+					p->state = CSI;
+				}
+				break;
+			}
+			p->sum += c;
+			break;
+		}
+	}
+}
+
+static void table_parse(struct parser *p, const unsigned char *buf, size_t len)
+{
+	int state = p->state;
+
+	for (size_t i = 0; i < len; i++) {
+		int c = buf[i];
+		int e;
+ tryagain:
+		e = vtparse(state, c);
+		state = VT_STATE(e);
+		switch (VT_ACTION(e)) {
+		case VTA_REDO:
+			goto tryagain;
+		case VTA_EXEC:
+			special(p, c);
+			break;
+		case VTA_ESCAPE:
+			p->intermediate = 0;
+			break;
+		case VTA_ESCCOLLECT:
+		case VTA_CSICOLLECT:
+			p->intermediate = p->intermediate ? -1 : c;
+			break;
+		case VTA_ESCDISPATCH:
+		case VTA_CSIDISPATCH:
+			if (VT_ACTION(e) == VTA_CSIDISPATCH && p->nargs < NARGS)
+				p->nargs++;
+			dispatch(p, c);
+			break;
+		case VTA_CSIENTRY:
+			csientry(p);
+			break;
+		case VTA_PARAM:
+			param(p, c);
+			break;
+		case VTA_NEXTPARAM:
+			if (p->nargs < NARGS)
+				p->nargs++;
+			break;
+		case VTA_STRPUT:
+			p->sum += c;
+			break;
+		case VTA_STRCTL:
+		case VTA_STRST:
+		case VTA_STREND:
+			state = LIT;
+			dispatch(p, '\\');
+			break;
+		case VTA_STRESC:
+			p->sum += 033;
+			if (c != 033)
+				p->sum += c;
+			break;
+		case VTA_C1:
+			if (c == 0x9b) {
+				csientry(p);
+				state = CSI;
+			}
+			break;
+		case VTA_PRINT:
+			p->sum += c;
+			break;
+		default:
+			break;
+		}
+	}
+	p->state = state;
+}
+
+struct gen {
+	unsigned char *buf;
+	size_t len;
+};
+
+static void add(struct gen *g, const char *fmt, int a, int b)
+{
+	if (g->len + 256 < SIZE)
+		g->len += snprintf((char *)g->buf + g->len, 256, fmt, a, b);
+}
+
+static void gen_ls(struct gen *g)
+{
+	for (int i = 0; g->len + 256 < SIZE; i++) {
+		add(g, "-rw-r--r-- 1 user user %8d Oct 17 12:00 ", i * 7919 % 100000, 0);
+		add(g, "\033[0%d;3%dm", i % 2, 1 + i % 7);
+		add(g, "file-%d.%c\033[0m\r\n", i, "ochs"[i % 4]);
+	}
+}
+
+static void gen_editor(struct gen *g)
+{
+	for (int i = 0; g->len + 256 < SIZE; i++) {
+		add(g, "\033[%d;%dH\033[K", 1 + i % 50, 1);
+		add(g, "\033[38;5;%dm%4d \033[m", 100 + i % 50, i);
+		add(g, "\033[1;34mstatic\033[m \033[32mint\033[m f%d(void) { return %d; }", i, i * 3);
+	}
+}
+
+static void gen_progress(struct gen *g)
+{
+	for (int i = 0; g->len + 256 < SIZE; i++) {
+		add(g, "\r\033[K[%3d%%] ", i % 101, 0);
+		add(g, "\033[7m%0*d\033[27m", i % 60 + 1, 0);
+	}
+}
+
+static void gen_title(struct gen *g)
+{
+	for (int i = 0; g->len + 256 < SIZE; i++) {
+		add(g, "\033]0;job %d: step %d\007", i, i % 13);
+		add(g, "\033k%d\033\\line %d\n", i, i);
+	}
+}
+
+static void bench(const char *name, const unsigned char *buf, size_t len)
+{
+	double ts = 1e9, tt = 1e9, t;
+
+	/* best of a few rounds, against noise */
+	for (int i = 0; i < ROUNDS; i++) {
+		struct parser ps = { 0 }, pt = { 0 };
+
+		t = now();
+		switch_parse(&ps, buf, len);
+		if ((t = now() - t) < ts)
+			ts = t;
+		t = now();
+		table_parse(&pt, buf, len);
+		if ((t = now() - t) < tt)
+			tt = t;
+		if (ps.sum != pt.sum || ps.state != pt.state) {
+			fprintf(stderr, "%s: parsers disagree\n", name);
+			exit(1);
+		}
+	}
+	printf("%-20s switch %7.1f MB/s  table %7.1f MB/s\n", name,
+	       len / ts / 1e6, len / tt / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+	static void (*gens[])(struct gen *) = { gen_ls, gen_editor, gen_progress, gen_title };
+	static const char *names[] = { "ls", "editor", "progress", "title" };
+	struct gen g;
+
+	g.buf = malloc(SIZE);
+	if (g.buf == NULL)
+		return 1;
+	if (argc > 1) {
+		for (int i = 1; i < argc; i++) {
+			FILE *f = fopen(argv[i], "r");
+			if (f == NULL) {
+				perror(argv[i]);
+				return 1;
+			}
+			g.len = fread(g.buf, 1, SIZE, f);
+			fclose(f);
+			bench(argv[i], g.buf, g.len);
+		}
+	} else {
+		for (size_t i = 0; i < sizeof(gens) / sizeof(*gens); i++) {
+			g.len = 0;
+			gens[i](&g);
+			bench(names[i], g.buf, g.len);
+		}
+	}
+	free(g.buf);
+	return 0;
+}
@@ -0,0 +1,178 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../charscan.h"
+#include "signature.h"
+#include "macros.h"
+
+SIGNATURE_CHECK(charscan_ascii, size_t, (const char *, size_t));
+SIGNATURE_CHECK(charscan_utf8, size_t, (const char *, size_t, int *, size_t, size_t *));
+
+/* FromUtf8 from encoding.c, which charscan_utf8 must agree with */
+static int FromUtf8(int c, int *utf8charp)
+{
+	int utf8char = *utf8charp;
+	if (utf8char) {
+		if ((c & 0xc0) != 0x80) {
+			*utf8charp = 0;
+			return -2;
+		} else
+			c = (c & 0x3f) | (utf8char << 6);
+		if (!(utf8char & 0x40000000)) {
+			if ((c & 0x820823e0) == 0x80000000)
+				c = 0xfdffffff;
+			else if ((c & 0x020821f0) == 0x02000000)
+				c = 0xfff7ffff;
+			else if ((c & 0x000820f8) == 0x00080000)
+				c = 0xffffd000;
+			else if ((c & 0x0000207c) == 0x00002000)
+				c = 0xffffff70;
+		}
+	} else {
+		if (c >= 0xfe)
+			c = 0xfffd;
+		else if (c >= 0xfc)
+			c = (c & 0x01) | 0xbffffffc;
+		else if (c >= 0xf8)
+			c = (c & 0x03) | 0xbfffff00;
+		else if (c >= 0xf0)
+			c = (c & 0x07) | 0xbfffc000;
+		else if (c >= 0xe0)
+			c = (c & 0x0f) | 0xbff00000;
+		else if (c >= 0xc2)
+			c = (c & 0x1f) | 0xfc000000;
+		else if (c >= 0xc0)
+			c = 0xfdffffff;
+		else if (c >= 0x80)
+			c = 0xfffd;
+	}
+	*utf8charp = utf8char = (c & 0x80000000) ? c : 0;
+	if (utf8char)
+		return -1;
+	if (c & 0xff800000)
+		c = 0xfffd;
+	if (c >= 0xd800 && (c <= 0xdfff || c == 0xfffe || c == 0xffff))
+		c = 0xfffd;
+	return c;
+}
+
+/* check a charscan_utf8 result against FromUtf8 on the bytes it used */
+static void check_utf8(const char *s, size_t n, size_t max)
+{
+	int out[256], state = 0;
+	size_t used, k, j = 0;
+
+	used = charscan_utf8(s, n, out, max, &k);
+	ASSERT(used <= n && k <= max);
+	for (size_t i = 0; i < used; i++) {
+		int c = FromUtf8((unsigned char)s[i], &state);
+
+		ASSERT(c != -2);
+		if (c >= 0) {
+			ASSERT(j < k && out[j] == c);
+			j++;
+		}
+	}
+	ASSERT(j == k && state == 0);
+}
+
+int main(void)
+{
+	char buf[100];
+
+	/* empty input, and stopping at the length */
+	{
+		ASSERT(charscan_ascii("", 0) == 0);
+		ASSERT(charscan_ascii("abc", 2) == 2);
+	}
+
+	/* every position of a stop character, inside and past a block */
+	{
+		const char stops[] = { '\0', '\n', '\033', 0x1f, 0x7f, (char)0x80, (char)0xc3, (char)0xff };
+
+		for (size_t k = 0; k < sizeof(stops); k++)
+			for (size_t pos = 0; pos < sizeof(buf); pos++) {
+				memset(buf, 'x', sizeof(buf));
+				buf[pos] = stops[k];
+				ASSERT(charscan_ascii(buf, sizeof(buf)) == pos);
+			}
+	}
+
+	/* the whole printable range passes */
+	{
+		for (int i = 0; i < 95; i++)
+			buf[i] = ' ' + i;
+		ASSERT(charscan_ascii(buf, 95) == 95);
+		ASSERT(charscan_ascii(buf + 3, 50) == 50);
+	}
+
+	/* UTF-8: whole characters decode, everything else is left alone */
+	{
+		size_t k;
+		int out[64];
+
+		ASSERT(charscan_utf8("a\xc3\xa9\xe6\x97\xa5\xf0\x9f\x98\x80z", 11, out, 64, &k) == 11);
+		ASSERT(k == 5 && out[0] == 'a' && out[1] == 0xe9 && out[2] == 0x65e5 && out[3] == 0x1f600 && out[4] == 'z');
+		ASSERT(charscan_utf8("ab\xe6\x97", 4, out, 64, &k) == 2 && k == 2);
+		ASSERT(charscan_utf8("\xc0\x80", 2, out, 64, &k) == 0 && k == 0);
+		ASSERT(charscan_utf8("\xe0\x80\x80", 3, out, 64, &k) == 0);
+		ASSERT(charscan_utf8("\xed\xa0\x80", 3, out, 64, &k) == 0);
+		ASSERT(charscan_utf8("\xef\xbf\xbe", 3, out, 64, &k) == 0);
+		ASSERT(charscan_utf8("\xf8\x88\x80\x80\x80", 5, out, 64, &k) == 0);
+		ASSERT(charscan_utf8("\xc3\xa9\xc3\xa9", 4, out, 1, &k) == 2 && k == 1);
+		for (int i = 0; i < 64; i++)
+			buf[i] = i & 0x7f;
+		ASSERT(charscan_utf8(buf, 64, out, 64, &k) == 64 && k == 64);
+		for (int i = 0; i < 64; i++)
+			ASSERT(out[i] == i);
+	}
+
+	/* random mixes of ASCII, valid and broken sequences */
+	{
+		static const char *const pieces[] = {
+			"a", "0123456789abcdef0123456789abcdef", "\033", "\xc3\xa9", "\xe6\x97\xa5",
+			"\xf0\x9f\x98\x80", "\xf7\xbf\xbf\xbf", "\x80", "\xbf", "\xc1", "\xc2", "\xe0\xa0",
+			"\xe0\x9f\xbf", "\xed\x9f\xbf", "\xed\xa0\x80", "\xef\xbf\xbf", "\xf0\x8f\xbf\xbf",
+			"\xf4\x90\x80\x80", "\xfc\x84\x80\x80\x80\x80", "\xfe", "\xff"
+		};
+		char s[200];
+
+		srand(1);
+		for (int iter = 0; iter < 100000; iter++) {
+			size_t n = 0;
+
+			while (n < 160) {
+				const char *p = pieces[rand() % (sizeof(pieces) / sizeof(*pieces))];
+				while (*p)
+					s[n++] = *p++;
+			}
+			size_t off = rand() % n;
+
+			check_utf8(s, n, 256);
+			check_utf8(s + off, n - off, 256);
+			check_utf8(s, rand() % n, 1 + rand() % 40);
+		}
+	}
+
+	return 0;
+}
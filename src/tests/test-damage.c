@@ -0,0 +1,120 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "../damage.h"
+#include "signature.h"
+#include "macros.h"
+
+SIGNATURE_CHECK(damage_add, int, (Damage *, int, int, int, int));
+SIGNATURE_CHECK(damage_scroll, int, (Damage *, int, int, int));
+SIGNATURE_CHECK(damage_empty, bool, (const Damage *));
+SIGNATURE_CHECK(damage_clear, void, (Damage *));
+SIGNATURE_CHECK(damage_free, void, (Damage *));
+
+int main(void)
+{
+	/* a cleared region is empty */
+	{
+		Damage dmg = { 0 };
+		damage_clear(&dmg);
+		ASSERT(damage_empty(&dmg));
+		ASSERT(dmg.top == -1 && dmg.bottom == -1);
+		damage_free(&dmg);
+	}
+
+	/* regions merge per line into the covering span */
+	{
+		Damage dmg = { 0 };
+		damage_clear(&dmg);
+		ASSERT(damage_add(&dmg, 5, 10, 3, 3) == 0);
+		ASSERT(damage_add(&dmg, 2, 6, 3, 4) == 0);
+		ASSERT(damage_add(&dmg, 20, 30, 60, 60) == 0);
+		ASSERT(!damage_empty(&dmg));
+		ASSERT(dmg.top == 3 && dmg.bottom == 60);
+		ASSERT(dmg.left[3] == 2 && dmg.right[3] == 10);
+		ASSERT(dmg.left[4] == 2 && dmg.right[4] == 6);
+		ASSERT(dmg.left[5] == -1 && dmg.right[5] == -1);
+		ASSERT(dmg.left[60] == 20 && dmg.right[60] == 30);
+		damage_free(&dmg);
+		ASSERT(damage_empty(&dmg));
+	}
+
+	/* empty regions and negative lines */
+	{
+		Damage dmg = { 0 };
+		damage_clear(&dmg);
+		ASSERT(damage_add(&dmg, 4, 3, 0, 0) == 0);
+		ASSERT(damage_add(&dmg, 0, 1, 2, 1) == 0);
+		ASSERT(damage_empty(&dmg));
+		ASSERT(damage_add(&dmg, 0, 1, -5, 0) == 0);
+		ASSERT(dmg.top == 0 && dmg.bottom == 0);
+		damage_free(&dmg);
+	}
+
+	/* clearing keeps the arrays but resets every line */
+	{
+		Damage dmg = { 0 };
+		damage_clear(&dmg);
+		ASSERT(damage_add(&dmg, 0, 79, 0, 23) == 0);
+		damage_clear(&dmg);
+		ASSERT(damage_empty(&dmg));
+		ASSERT(dmg.lines > 23);
+		for (int y = 0; y < dmg.lines; y++)
+			ASSERT(dmg.left[y] == -1 && dmg.right[y] == -1);
+		ASSERT(damage_add(&dmg, 7, 7, 10, 10) == 0);
+		ASSERT(dmg.top == 10 && dmg.bottom == 10 && dmg.left[10] == 7);
+		damage_free(&dmg);
+	}
+
+	/* damage moves with scrolled lines, lines scrolled in are clean */
+	{
+		Damage dmg = { 0 };
+		damage_clear(&dmg);
+		ASSERT(damage_add(&dmg, 1, 2, 2, 2) == 0);
+		ASSERT(damage_add(&dmg, 3, 4, 5, 5) == 0);
+		ASSERT(damage_add(&dmg, 5, 6, 9, 9) == 0);
+		ASSERT(damage_scroll(&dmg, 2, 6, 2) == 0);
+		ASSERT(dmg.top == 3 && dmg.bottom == 9);
+		ASSERT(dmg.left[2] == -1 && dmg.left[4] == -1);
+		ASSERT(dmg.left[3] == 3 && dmg.right[3] == 4);
+		ASSERT(dmg.left[5] == -1 && dmg.left[6] == -1);
+		ASSERT(dmg.left[9] == 5 && dmg.right[9] == 6);
+		ASSERT(damage_scroll(&dmg, 0, 99, -60) == 0);
+		ASSERT(dmg.lines > 99);
+		ASSERT(dmg.top == 63 && dmg.bottom == 69);
+		ASSERT(dmg.left[63] == 3 && dmg.left[69] == 5);
+		ASSERT(damage_scroll(&dmg, 60, 99, 40) == 0);
+		ASSERT(damage_empty(&dmg));
+		damage_free(&dmg);
+	}
+
+	/* allocation failure records nothing */
+	{
+		Damage dmg = { 0 };
+		damage_clear(&dmg);
+		ASSERT_GCC(FAILLOC(damage_add(&dmg, 0, 1, 0, 0)) == -1);
+		ASSERT(damage_empty(&dmg));
+		damage_free(&dmg);
+	}
+
+	return 0;
+}
@@ -0,0 +1,144 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "../evheap.h"
+#include "signature.h"
+#include "macros.h"
+
+SIGNATURE_CHECK(evheap_push, int, (EventHeap *, Event *));
+SIGNATURE_CHECK(evheap_remove, void, (EventHeap *, Event *));
+SIGNATURE_CHECK(evheap_update, void, (EventHeap *, Event *));
+SIGNATURE_CHECK(evheap_top, Event *, (const EventHeap *));
+SIGNATURE_CHECK(evheap_free, void, (EventHeap *));
+
+#define NEVS 1000
+
+static void settime(Event *ev, long sec, long usec)
+{
+	ev->timeout.tv_sec = sec;
+	ev->timeout.tv_usec = usec;
+}
+
+static bool before_or_equal(const Event *a, const Event *b)
+{
+	if (a->timeout.tv_sec != b->timeout.tv_sec)
+		return a->timeout.tv_sec < b->timeout.tv_sec;
+	return a->timeout.tv_usec <= b->timeout.tv_usec;
+}
+
+int main(void)
+{
+	/* an empty heap has no top */
+	{
+		EventHeap h = { 0 };
+		ASSERT(evheap_top(&h) == NULL);
+		evheap_free(&h);
+	}
+
+	/* events come out in timeout order, regardless of insertion order */
+	{
+		EventHeap h = { 0 };
+		static Event evs[NEVS];
+		Event *prev = NULL;
+
+		srand(1);
+		for (int i = 0; i < NEVS; i++) {
+			settime(&evs[i], rand() % 100, rand() % 1000000);
+			ASSERT(evheap_push(&h, &evs[i]) == 0);
+		}
+		ASSERT(h.len == NEVS);
+
+		for (int i = 0; i < NEVS; i++) {
+			Event *ev = evheap_top(&h);
+			ASSERT(ev != NULL);
+			if (prev)
+				ASSERT(before_or_equal(prev, ev));
+			evheap_remove(&h, ev);
+			ASSERT(ev->heapidx == -1);
+			prev = ev;
+		}
+		ASSERT(evheap_top(&h) == NULL);
+		evheap_free(&h);
+	}
+
+	/* events with the same timeout fire in priority order */
+	{
+		EventHeap h = { 0 };
+		Event lo = { 0 }, hi = { 0 };
+
+		settime(&lo, 5, 0);
+		settime(&hi, 5, 0);
+		hi.priority = 1;
+		evheap_push(&h, &lo);
+		evheap_push(&h, &hi);
+		ASSERT(evheap_top(&h) == &hi);
+		evheap_free(&h);
+	}
+
+	/* removing from the middle and rescheduling keeps the order intact */
+	{
+		EventHeap h = { 0 };
+		static Event evs[NEVS];
+		Event *prev = NULL;
+		int n = NEVS;
+
+		srand(2);
+		for (int i = 0; i < NEVS; i++) {
+			settime(&evs[i], rand() % 1000, 0);
+			evheap_push(&h, &evs[i]);
+		}
+		for (int i = 0; i < NEVS; i += 3) {
+			evheap_remove(&h, &evs[i]);
+			n--;
+		}
+		for (int i = 1; i < NEVS; i += 3) {
+			settime(&evs[i], rand() % 1000, 0);
+			evheap_update(&h, &evs[i]);
+		}
+		ASSERT(h.len == n);
+
+		while (h.len) {
+			Event *ev = evheap_top(&h);
+			if (prev)
+				ASSERT(before_or_equal(prev, ev));
+			evheap_remove(&h, ev);
+			prev = ev;
+			n--;
+		}
+		ASSERT(n == 0);
+		evheap_free(&h);
+	}
+
+#ifdef _GNU_SOURCE
+	/* failing allocation leaves the heap untouched */
+	{
+		EventHeap h = { 0 };
+		Event ev = { 0 };
+
+		ASSERT(FAILLOC(evheap_push(&h, &ev)) == -1);
+		ASSERT(h.len == 0);
+		evheap_free(&h);
+	}
+#endif
+
+	return 0;
+}
@@ -0,0 +1,347 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200809L	/* pwrite, symlink */
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../histpack.h"
+#include "../linepool.h"
+#include "signature.h"
+#include "macros.h"
+
+SIGNATURE_CHECK(histpack_push, int, (HistPack *, const struct mline *, int));
+SIGNATURE_CHECK(histpack_pop, void, (HistPack *));
+SIGNATURE_CHECK(histpack_drop, void, (HistPack *, int));
+SIGNATURE_CHECK(histpack_line, struct mline *, (HistPack *, int, int));
+SIGNATURE_CHECK(histpack_rewrap, int, (HistPack *, int));
+SIGNATURE_CHECK(histpack_size, size_t, (const HistPack *));
+SIGNATURE_CHECK(histpack_free, void, (HistPack *));
+SIGNATURE_CHECK(histpack_walk, void, (void (*)(uint32_t *, int)));
+
+#define W 20
+
+static uint32_t image[W + 1], style[W + 1];
+static struct mline ml = { image, style };
+
+/* Line n: its number, colored from column 3 to 5 on odd lines. */
+static void make(int n)
+{
+	struct mchar mc = { 0 };
+
+	for (int x = 0; x < W; x++)
+		image[x] = ' ';
+	image[0] = '0' + n % 10;
+	image[1] = '0' + n / 10 % 10;
+	image[2] = '0' + n / 100 % 10;
+	image[W] = n % 3 ? ' ' : 0;
+	mc.colorfg = 1 + n % 7;
+	for (int x = 0; x < W; x++)
+		style[x] = (n & 1) && x >= 3 && x < 6 ? mstyle_intern(&mc) : 0;
+}
+
+/* whether l is line n at width w */
+static bool check(const struct mline *l, int n, int w)
+{
+	if (!l || l->image[0] != (uint32_t)'0' + n % 10 || l->image[2] != (uint32_t)'0' + n / 100 % 10)
+		return false;
+	if (l->image[w] != (n % 3 ? ' ' : 0u) || l->image[w - 1] != ' ')
+		return false;
+	for (int x = 0; x < w; x++) {
+		uint32_t fg = (n & 1) && x >= 3 && x < 6 ? 1 + n % 7 : 0;
+
+		if (mline_style(l, x)->colorfg != fg)
+			return false;
+	}
+	return true;
+}
+
+/* Cell x of wrapped line k, which is 30 to 34 cells long with blanks in it. */
+static uint32_t cell(int k, int x)
+{
+	return x % 12 >= 10 && x < 29 ? ' ' : 'a' + (k + x) % 26;
+}
+
+static int cells(int k)
+{
+	return 30 + k % 5;
+}
+
+/* Push the wrapped lines 0 to n - 1 in rows of w cells, colored from column 5 to 8 on odd lines. */
+static void push_wrapped(HistPack *hp, int n, int w)
+{
+	struct mchar mc = { .colorfg = 3 };
+	uint32_t im[w + 1], st[w + 1];
+	struct mline row = { im, st };
+
+	for (int k = 0; k < n; k++)
+		for (int x = 0; x < cells(k); ) {
+			for (int i = 0; i < w; i++, x++) {
+				im[i] = x < cells(k) ? cell(k, x) : ' ';
+				st[i] = (k & 1) && x >= 5 && x < 9 ? mstyle_intern(&mc) : 0;
+			}
+			im[w] = x < cells(k) ? 0 : ' ';
+			histpack_push(hp, &row, w);
+		}
+}
+
+/* whether hp holds the wrapped lines first to n - 1 in rows of w cells, as they were stored */
+static bool check_wrapped(HistPack *hp, int first, int n, int w)
+{
+	int y = 0;
+
+	for (int k = first; k < n; k++)
+		for (int x = 0; x < cells(k); y++) {
+			struct mline *l = histpack_line(hp, y, 0);
+
+			if (!l || linepool_len(l->image) != w + 1)
+				return false;
+			for (int i = 0; i < w; i++, x++) {
+				if (l->image[i] != (x < cells(k) ? cell(k, x) : ' '))
+					return false;
+				if (mline_style(l, i)->colorfg != ((k & 1) && x >= 5 && x < 9 ? 3u : 0u))
+					return false;
+			}
+			if (l->image[w] != (x < cells(k) ? 0u : ' '))
+				return false;
+		}
+	return y == hp->lines;
+}
+
+static int walked;
+
+static void count(uint32_t *s, int n)
+{
+	(void)s;
+	walked += n;
+}
+
+int main(void)
+{
+	/* lines read back as they went in, also at other widths */
+	{
+		HistPack hp = { 0 };
+
+		for (int n = 0; n < 1000; n++) {
+			make(n);
+			ASSERT(histpack_push(&hp, &ml, W) == 0);
+		}
+		ASSERT(hp.lines == 1000);
+		for (int n = 0; n < 1000; n++)
+			ASSERT(check(histpack_line(&hp, n, W), n, W));
+		for (int n = 999; n >= 0; n -= 7)
+			ASSERT(check(histpack_line(&hp, n, 5), n, 5));
+		ASSERT(check(histpack_line(&hp, 3, 80), 3, 80));
+		ASSERT(histpack_line(&hp, 1000, W) == NULL);
+		ASSERT(histpack_line(&hp, -1, W) == NULL);
+		/* far less than the 8 bytes per cell of the lines */
+		ASSERT(histpack_size(&hp) < 1000 * W);
+		histpack_free(&hp);
+		ASSERT(hp.lines == 0 && hp.blocks == NULL);
+	}
+
+	/* dropping the oldest lines, popping the newest */
+	{
+		HistPack hp = { 0 };
+
+		for (int n = 0; n < 300; n++) {
+			make(n);
+			histpack_push(&hp, &ml, W);
+		}
+		ASSERT(check(histpack_line(&hp, 299, W), 299, W));
+		histpack_drop(&hp, 130);
+		ASSERT(hp.lines == 170);
+		ASSERT(check(histpack_line(&hp, 0, W), 130, W));
+		ASSERT(check(histpack_line(&hp, 169, W), 299, W));
+		for (int n = 0; n < 50; n++)
+			histpack_pop(&hp);
+		ASSERT(hp.lines == 120);
+		ASSERT(check(histpack_line(&hp, 119, W), 249, W));
+		/* new lines replace the popped ones, also in the cache */
+		make(900);
+		histpack_push(&hp, &ml, W);
+		ASSERT(check(histpack_line(&hp, 120, W), 900, W));
+		ASSERT(check(histpack_line(&hp, 0, W), 130, W));
+		histpack_drop(&hp, 121);
+		ASSERT(hp.lines == 0 && hp.stage == NULL);
+		histpack_pop(&hp);
+		ASSERT(hp.lines == 0);
+	}
+
+	/* popping down to nothing across blocks */
+	{
+		HistPack hp = { 0 };
+
+		for (int n = 0; n < 200; n++) {
+			make(n);
+			histpack_push(&hp, &ml, W);
+		}
+		histpack_drop(&hp, 10);
+		for (int n = 199; n >= 10; n--) {
+			ASSERT(check(histpack_line(&hp, n - 10, W), n, W));
+			histpack_pop(&hp);
+		}
+		ASSERT(hp.lines == 0 && hp.nblocks == 0);
+	}
+
+	/* lines read while their block was staged, then after it was sealed */
+	{
+		HistPack hp = { 0 };
+
+		for (int n = 0; n < HISTPACK_BLOCK + 1; n++) {
+			make(n);
+			histpack_push(&hp, &ml, W);
+			if (n == 10)
+				ASSERT(check(histpack_line(&hp, 5, W), 5, W));
+		}
+		ASSERT(hp.nblocks == 1);
+		ASSERT(check(histpack_line(&hp, 40, W), 40, W));
+		histpack_free(&hp);
+	}
+
+	/* the cache holds a few blocks, their renditions can be walked */
+	{
+		HistPack hp = { 0 };
+
+		for (int n = 0; n < HISTPACK_BLOCK * (HISTPACK_CACHE + 4); n++) {
+			make(n);
+			histpack_push(&hp, &ml, W);
+		}
+		for (int n = 0; n < hp.lines; n++)
+			histpack_line(&hp, n, W);
+		histpack_walk(count);
+		ASSERT(walked == HISTPACK_CACHE * HISTPACK_BLOCK * (W + 1));
+		histpack_free(&hp);
+	}
+
+	/* blocks beyond the memory limit go to a spill file and come back */
+	{
+		HistPack hp = { 0 };
+		char buf[8];
+		int fd;
+
+		/* a file the spill file name points to is left alone */
+		unlink("tests/.spill.hist1");
+		ASSERT((fd = open("tests/spill.other", O_WRONLY | O_CREAT | O_TRUNC, 0600)) >= 0);
+		ASSERT(write(fd, "other", 5) == 5);
+		close(fd);
+		ASSERT(symlink("spill.other", "tests/.spill.hist1") == 0);
+
+		histpack_spillpath = "tests/spill";
+		histpack_memlimit = 1;
+		for (int n = 0; n < 1000; n++) {
+			make(n);
+			histpack_push(&hp, &ml, W);
+		}
+		ASSERT(hp.nspilled == hp.nblocks && hp.memsize == 0);
+		ASSERT((fd = open("tests/.spill.hist1", O_RDWR)) >= 0);
+		for (int n = 0; n < 1000; n++)
+			ASSERT(check(histpack_line(&hp, n, W), n, W));
+		/* dropping and popping work on spilled blocks as well */
+		histpack_drop(&hp, 100);
+		ASSERT(check(histpack_line(&hp, 0, W), 100, W));
+		for (int n = 999; n >= 900; n--) {
+			ASSERT(check(histpack_line(&hp, n - 100, W), n, W));
+			histpack_pop(&hp);
+		}
+		make(901);
+		histpack_push(&hp, &ml, W);
+		ASSERT(check(histpack_line(&hp, 800, W), 901, W));
+		/* a damaged block is refused, not decoded */
+		ASSERT(pwrite(fd, "xxxx", 4, 2000) == 4);
+		for (int n = 0; n < 800; n++)
+			if (!histpack_line(&hp, n, W))
+				walked = -1;
+		ASSERT(walked == -1);
+		histpack_free(&hp);
+		ASSERT(access("tests/.spill.hist1", F_OK) == -1);
+		close(fd);
+		ASSERT((fd = open("tests/spill.other", O_RDONLY)) >= 0);
+		ASSERT(read(fd, buf, sizeof(buf)) == 5 && !memcmp(buf, "other", 5));
+		close(fd);
+		unlink("tests/spill.other");
+	}
+
+	/* the spill file is compacted once most of it has been dropped */
+	{
+		HistPack hp = { 0 };
+		int n, fd;
+
+		for (n = 0; n < 200000; n++) {
+			make(n);
+			for (int x = 4; x < W; x++)
+				image[x] = 'a' + rand() % 26;
+			histpack_push(&hp, &ml, W);
+			if (hp.lines > 10000)
+				histpack_drop(&hp, 1);
+		}
+		ASSERT((fd = open("tests/.spill.hist2", O_RDONLY)) >= 0);
+		ASSERT(lseek(fd, 0, SEEK_END) < 3 << 20);
+		close(fd);
+		ASSERT(histpack_line(&hp, 9999, W)->image[0] == (uint32_t)'0' + (n - 1) % 10);
+		histpack_free(&hp);
+		histpack_memlimit = 0;
+	}
+
+	/* lines keep their width, rewrapping keeps all of their cells */
+	{
+		HistPack hp = { 0 };
+		int lines;
+
+		push_wrapped(&hp, 300, 12);
+		lines = hp.lines;
+		ASSERT(lines == 900);
+		ASSERT(check_wrapped(&hp, 0, 300, 12));
+		ASSERT(histpack_rewrap(&hp, 7) == 0);
+		ASSERT(check_wrapped(&hp, 0, 300, 7));
+		ASSERT(histpack_rewrap(&hp, 80) == 0);
+		ASSERT(hp.lines == 300);
+		ASSERT(check_wrapped(&hp, 0, 300, 80));
+		/* and can still be read at other widths */
+		ASSERT(histpack_line(&hp, 5, 31)->image[29] == cell(5, 29));
+		ASSERT(histpack_rewrap(&hp, 12) == 0);
+		ASSERT(hp.lines == lines);
+		ASSERT(check_wrapped(&hp, 0, 300, 12));
+		/* a line cut in two by dropping the oldest ones stays apart */
+		histpack_drop(&hp, 4);
+		ASSERT(histpack_rewrap(&hp, 50) == 0);
+		ASSERT(hp.lines == 299 && histpack_line(&hp, 0, 0)->image[0] == cell(1, 12));
+		ASSERT(check_wrapped(&hp, 2, 300, 50) == false);
+		histpack_drop(&hp, 1);
+		ASSERT(check_wrapped(&hp, 2, 300, 50));
+		histpack_free(&hp);
+	}
+
+	/* lines without memory to store them are refused */
+	{
+		HistPack hp = { 0 };
+
+		make(1);
+		ASSERT_GCC(FAILLOC(histpack_push(&hp, &ml, W)) == -1);
+		ASSERT(hp.lines == 0);
+		histpack_free(&hp);
+	}
+
+	return 0;
+}
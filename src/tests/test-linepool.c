@@ -0,0 +1,130 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../linepool.h"
+#include "signature.h"
+#include "macros.h"
+
+SIGNATURE_CHECK(linepool_alloc, uint32_t *, (int));
+SIGNATURE_CHECK(linepool_free, void, (uint32_t *));
+SIGNATURE_CHECK(linepool_flush, void, (void));
+SIGNATURE_CHECK(linepool_len, int, (const uint32_t *));
+
+static bool zero(const uint32_t *a, int len)
+{
+	for (int i = 0; i < len; i++)
+		if (a[i])
+			return false;
+	return true;
+}
+
+int main(void)
+{
+	/* fresh arrays are zeroed */
+	{
+		uint32_t *a = linepool_alloc(81);
+
+		ASSERT(a != NULL);
+		ASSERT(zero(a, 81));
+		ASSERT(linepool_stats.allocs == 1 && linepool_stats.mallocs == 1);
+		linepool_free(a);
+		linepool_free(NULL);
+		ASSERT(linepool_stats.frees == 1 && linepool_stats.releases == 0);
+	}
+
+	/* a freed array comes back for the same length, zeroed again */
+	{
+		uint32_t *a = linepool_alloc(81), *b;
+
+		ASSERT(linepool_stats.mallocs == 1);
+		for (int i = 0; i < 81; i++)
+			a[i] = 0x12345678;
+		linepool_free(a);
+		b = linepool_alloc(81);
+		ASSERT(b == a);
+		ASSERT(zero(b, 81));
+		ASSERT(linepool_stats.mallocs == 1);
+
+		/* but not for a different one */
+		a = linepool_alloc(133);
+		ASSERT(a != b);
+		ASSERT(linepool_stats.mallocs == 2);
+		ASSERT(linepool_len(a) == 133 && linepool_len(b) == 81);
+		linepool_free(a);
+		linepool_free(b);
+	}
+
+	/* steady scrolling goes without malloc */
+	{
+		uint32_t *lines[24];
+		unsigned long mallocs;
+
+		for (int i = 0; i < 24; i++)
+			lines[i] = linepool_alloc(81);
+		mallocs = linepool_stats.mallocs;
+		for (int n = 0; n < 10000; n++) {
+			linepool_free(lines[n % 24]);
+			lines[n % 24] = linepool_alloc(81);
+		}
+		ASSERT(linepool_stats.mallocs == mallocs);
+		for (int i = 0; i < 24; i++)
+			linepool_free(lines[i]);
+	}
+
+	/* only LINEPOOL_KEEP arrays are kept per length */
+	{
+		uint32_t *a[LINEPOOL_KEEP + 10];
+		unsigned long releases = linepool_stats.releases;
+
+		for (int i = 0; i < LINEPOOL_KEEP + 10; i++)
+			a[i] = linepool_alloc(41);
+		for (int i = 0; i < LINEPOOL_KEEP + 10; i++)
+			linepool_free(a[i]);
+		ASSERT(linepool_stats.releases == releases + 10);
+	}
+
+	/* a new length takes over the list used longest ago */
+	{
+		uint32_t *a[LINEPOOL_WIDTHS + 1];
+		unsigned long mallocs;
+
+		linepool_flush();
+		for (int i = 0; i <= LINEPOOL_WIDTHS; i++)
+			a[i] = linepool_alloc(10 + i);
+		for (int i = 0; i <= LINEPOOL_WIDTHS; i++)
+			linepool_free(a[i]);
+		mallocs = linepool_stats.mallocs;
+		/* length 10 was dropped to make room for the last one */
+		linepool_free(linepool_alloc(10 + LINEPOOL_WIDTHS));
+		ASSERT(linepool_stats.mallocs == mallocs);
+		linepool_free(linepool_alloc(10));
+		ASSERT(linepool_stats.mallocs == mallocs + 1);
+	}
+
+	/* flush gives everything back */
+	{
+		linepool_flush();
+		ASSERT(linepool_stats.mallocs - linepool_stats.releases == 0);
+	}
+
+	return 0;
+}
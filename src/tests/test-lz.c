@@ -0,0 +1,120 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../lz.h"
+#include "signature.h"
+#include "macros.h"
+
+SIGNATURE_CHECK(lz_compress, size_t, (const unsigned char *, size_t, unsigned char *));
+SIGNATURE_CHECK(lz_decompress, ssize_t, (const unsigned char *, size_t, unsigned char *, size_t));
+
+static unsigned char in[100000], packed[LZ_BOUND(100000)], out[100000];
+
+/* compress and decompress len bytes of in, returning the packed size */
+static size_t roundtrip(size_t len)
+{
+	size_t n = lz_compress(in, len, packed);
+
+	ASSERT(n <= LZ_BOUND(len));
+	ASSERT(lz_decompress(packed, n, out, len) == (ssize_t)len);
+	ASSERT(memcmp(in, out, len) == 0);
+	return n;
+}
+
+int main(void)
+{
+	/* short inputs are all literals */
+	{
+		memcpy(in, "abc", 3);
+		for (size_t len = 0; len <= 3; len++)
+			ASSERT(roundtrip(len) == len + 1);
+	}
+
+	/* repeats shrink, also when the match overlaps itself */
+	{
+		memset(in, 'x', 1000);
+		ASSERT(roundtrip(1000) < 20);
+		for (int i = 0; i < 1000; i++)
+			in[i] = "ab c"[i % 4];
+		ASSERT(roundtrip(1000) < 20);
+	}
+
+	/* a typical history block */
+	{
+		size_t len = 0;
+
+		for (int i = 0; len < 4000; i++)
+			len += sprintf((char *)in + len, "%c%cdrwxr-xr-x 2 root root 4096 Oct 17 file%d", 40, ' ', i);
+		ASSERT(roundtrip(len) < len / 2);
+	}
+
+	/* random data does not grow beyond the bound, long literal runs */
+	{
+		srand(1);
+		for (size_t i = 0; i < sizeof(in); i++)
+			in[i] = rand();
+		roundtrip(sizeof(in));
+		roundtrip(15);
+		roundtrip(15 + 255);
+		roundtrip(15 + 255 + 1);
+	}
+
+	/* long matches, far offsets */
+	{
+		for (size_t i = 0; i < 70000; i++)
+			in[i] = rand();
+		memcpy(in + 70000, in + 100, 20000);
+		memcpy(in + 90000, in + 90000 - 65535, 10000);
+		roundtrip(100000);
+	}
+
+	/* corrupt or truncated input is refused, never overruns */
+	{
+		size_t n;
+
+		memset(in, 'x', 1000);
+		memcpy(in + 500, "hello world", 11);
+		n = lz_compress(in, 1000, packed);
+		ASSERT(lz_decompress(packed, n, out, 999) == -1);
+		for (size_t i = 1; i < n; i++)
+			lz_decompress(packed, i, out, 1000);
+		for (size_t i = 0; i < n; i++) {
+			unsigned char c = packed[i];
+
+			for (int b = 0; b < 8; b++) {
+				packed[i] = c ^ 1 << b;
+				lz_decompress(packed, n, out, 1000);
+			}
+			packed[i] = c;
+		}
+		/* an offset before the start of the output */
+		memcpy(packed, "\x10" "a" "\x02\x00", 4);
+		ASSERT(lz_decompress(packed, 4, out, 1000) == -1);
+		memcpy(packed, "\x10" "a" "\x01\x00", 4);
+		ASSERT(lz_decompress(packed, 4, out, 1000) == 5);
+		ASSERT(memcmp(out, "aaaaa", 5) == 0);
+	}
+
+	return 0;
+}
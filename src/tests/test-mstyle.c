@@ -0,0 +1,126 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../image.h"
+#include "signature.h"
+#include "macros.h"
+
+SIGNATURE_CHECK(mstyle_intern, uint32_t, (const struct mchar *));
+SIGNATURE_CHECK(mstyle_gc, void, (void (*)(void (*)(uint32_t *, int))));
+
+/* the only line the collector gets to see */
+static uint32_t line[8];
+
+static void walk(void (*fn)(uint32_t *, int))
+{
+	fn(line, 8);
+}
+
+static struct mchar colored(uint32_t fg)
+{
+	struct mchar mc = { 'x', 0, 0, 0, 0, fg, 0 };
+
+	return mc;
+}
+
+int main(void)
+{
+	/* the default rendition is index 0 and needs no table entry */
+	{
+		struct mchar mc = { 'a', 0, 0, 0, 0, 0, 0 };
+
+		ASSERT(mstyle_of(&mc) == 0);
+		ASSERT(mstyle_intern(&mc) == 0);
+		ASSERT(mstyle_match(0, &mc));
+	}
+
+	/* equal renditions share an index, the image does not matter */
+	{
+		struct mchar a = { 'a', 1, 0, 0, 3, 4, 0 };
+		struct mchar b = { 'b', 1, 0, 0, 3, 4, 0 };
+		struct mchar c = { 'a', 1, 0, 0, 3, 5, 0 };
+		uint32_t sa = mstyle_of(&a), sc = mstyle_of(&c);
+
+		ASSERT(sa != 0 && sc != 0 && sa != sc);
+		ASSERT(mstyle_of(&b) == sa);
+		ASSERT(mstyle_of(&c) == sc);
+		ASSERT(mstyle_of(&a) == sa);
+		ASSERT(mstyles[sa].attr == 1 && mstyles[sa].colorbg == 3 && mstyles[sa].colorfg == 4);
+		ASSERT(mstyle_match(sa, &b) && !mstyle_match(sa, &c));
+	}
+
+	/* many renditions all come back the same */
+	{
+		static uint32_t idx[3000];
+
+		for (uint32_t i = 0; i < 3000; i++) {
+			struct mchar mc = colored(0x1000000 | i);
+
+			idx[i] = mstyle_of(&mc);
+		}
+		for (uint32_t i = 0; i < 3000; i++) {
+			struct mchar mc = colored(0x1000000 | i);
+
+			ASSERT(mstyle_of(&mc) == idx[i]);
+			ASSERT(mstyles[idx[i]].colorfg == (0x1000000 | i));
+		}
+		ASSERT(!mstyle_gcdue);
+	}
+
+	/* collection is asked for once the table fills up */
+	{
+		for (uint32_t i = 0; !mstyle_gcdue; i++) {
+			struct mchar mc = colored(0x2000000 | i);
+
+			ASSERT(i < 4096);
+			mstyle_of(&mc);
+		}
+	}
+
+	/* collection keeps what the lines use and renumbers it */
+	{
+		struct mchar a = colored(0x2000010), b = colored(0x1000020);
+		uint32_t sa = mstyle_of(&a), sb = mstyle_of(&b), s;
+
+		for (int i = 0; i < 8; i++)
+			line[i] = i & 1 ? sa : sb;
+		line[7] = 0;
+		mstyle_gc(walk);
+		ASSERT(!mstyle_gcdue);
+		ASSERT(line[7] == 0);
+		ASSERT(line[0] != line[1] && line[0] != 0 && line[1] != 0);
+		ASSERT(line[0] < 3 && line[1] < 3);
+		for (int i = 0; i < 7; i++)
+			ASSERT(mstyle_match(line[i], i & 1 ? &a : &b));
+
+		/* the survivors are still found, new styles go after them */
+		ASSERT(mstyle_of(&a) == line[1]);
+		ASSERT(mstyle_of(&b) == line[0]);
+		a = colored(0x3000000);
+		s = mstyle_of(&a);
+		ASSERT(s == 3);
+		ASSERT(mstyle_of(&b) == line[0]);
+		ASSERT(mstyle_of(&a) == s);
+	}
+
+	return 0;
+}
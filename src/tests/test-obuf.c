@@ -0,0 +1,153 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../obuf.h"
+#include "signature.h"
+#include "macros.h"
+
+SIGNATURE_CHECK(obuf_grow, int, (OutBuf *));
+SIGNATURE_CHECK(obuf_len, size_t, (const OutBuf *));
+SIGNATURE_CHECK(obuf_iov, int, (const OutBuf *, struct iovec *, int, size_t));
+SIGNATURE_CHECK(obuf_consume, void, (OutBuf *, size_t));
+SIGNATURE_CHECK(obuf_free, void, (OutBuf *));
+
+/* same as AddChar in display.h */
+static void putch(OutBuf *ob, char c)
+{
+	if (--ob->free <= 0)
+		ASSERT(obuf_grow(ob) == 0);
+	*ob->wp++ = c;
+}
+
+/* gather everything queued, like writev() would see it */
+static size_t gather(const OutBuf *ob, char *buf, size_t max)
+{
+	struct iovec iov[64];
+	size_t len = 0;
+	int n = obuf_iov(ob, iov, 64, max);
+
+	for (int i = 0; i < n; i++) {
+		memcpy(buf + len, iov[i].iov_base, iov[i].iov_len);
+		len += iov[i].iov_len;
+	}
+	return len;
+}
+
+int main(void)
+{
+	/* an empty buffer has nothing to write */
+	{
+		OutBuf ob = { 0 };
+		struct iovec iov[4];
+		ASSERT(obuf_len(&ob) == 0);
+		ASSERT(obuf_iov(&ob, iov, 4, 100) == 0);
+		obuf_consume(&ob, 10);
+		ASSERT(obuf_len(&ob) == 0);
+		obuf_free(&ob);
+	}
+
+	/* data spanning several segments comes out in order */
+	{
+		OutBuf ob = { 0 };
+		static char out[OBUF_SEGSIZE * 4];
+		size_t n = OBUF_SEGSIZE * 3 + 17;
+
+		for (size_t i = 0; i < n; i++)
+			putch(&ob, 'a' + i % 23);
+		ASSERT(obuf_len(&ob) == n);
+		ASSERT(gather(&ob, out, sizeof(out)) == n);
+		for (size_t i = 0; i < n; i++)
+			ASSERT(out[i] == (char)('a' + i % 23));
+		obuf_free(&ob);
+		ASSERT(obuf_len(&ob) == 0);
+	}
+
+	/* iovecs respect the byte limit */
+	{
+		OutBuf ob = { 0 };
+		struct iovec iov[8];
+
+		for (int i = 0; i < OBUF_SEGSIZE * 2; i++)
+			putch(&ob, 'x');
+		ASSERT(obuf_iov(&ob, iov, 8, 10) == 1);
+		ASSERT(iov[0].iov_len == 10);
+		ASSERT(obuf_iov(&ob, iov, 1, OBUF_SEGSIZE * 2) == 1);
+		obuf_free(&ob);
+	}
+
+	/* partial consumption across segment boundaries */
+	{
+		OutBuf ob = { 0 };
+		static char out[OBUF_SEGSIZE * 4];
+		size_t n = OBUF_SEGSIZE * 2 + 100, done = 0;
+
+		for (size_t i = 0; i < n; i++)
+			putch(&ob, 'A' + i % 26);
+		while (obuf_len(&ob)) {
+			size_t len = obuf_len(&ob);
+			size_t step = len < 1000 ? len : 1000;
+			ASSERT(gather(&ob, out, step) == step);
+			for (size_t i = 0; i < step; i++)
+				ASSERT(out[i] == (char)('A' + (done + i) % 26));
+			obuf_consume(&ob, step);
+			done += step;
+			ASSERT(obuf_len(&ob) == n - done);
+		}
+		ASSERT(done == n);
+
+		/* the buffer is reused after draining */
+		putch(&ob, 'z');
+		ASSERT(obuf_len(&ob) == 1);
+		ASSERT(gather(&ob, out, 10) == 1 && out[0] == 'z');
+		obuf_free(&ob);
+	}
+
+	/* interleaved filling and draining */
+	{
+		OutBuf ob = { 0 };
+		static char out[OBUF_SEGSIZE * 4];
+		size_t in = 0, done = 0;
+
+		for (int round = 0; round < 50; round++) {
+			for (int i = 0; i < 777; i++, in++)
+				putch(&ob, in % 251);
+			size_t len = gather(&ob, out, 500 + round * 31);
+			for (size_t i = 0; i < len; i++)
+				ASSERT((unsigned char)out[i] == (done + i) % 251);
+			obuf_consume(&ob, len);
+			done += len;
+			ASSERT(obuf_len(&ob) == in - done);
+		}
+		obuf_free(&ob);
+	}
+
+	/* allocation failure is reported */
+	{
+		OutBuf ob = { 0 };
+		ASSERT_GCC(FAILLOC(obuf_grow(&ob)) == -1);
+		ASSERT(obuf_len(&ob) == 0);
+		obuf_free(&ob);
+	}
+
+	return 0;
+}
@@ -0,0 +1,100 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../sgr.h"
+#include "signature.h"
+#include "macros.h"
+
+SIGNATURE_CHECK(sgr_encode, int, (const SGR *, const struct mstyle *, const struct mstyle *, char *));
+
+/* an xterm: dim, underline, bold, reverse, standout as reverse, blink */
+static SGR xterm = { { 2, 4, 1, 7, 7, 5 }, SGR_OFF | SGR_DEFAULT | SGR_BRIGHT | SGR_INDEXED };
+
+#define IDX(c)		(0x01000000 | (c))
+#define RGB(r, g, b)	(0x02000000 | (r) << 16 | (g) << 8 | (b))
+
+/* whether going from f to t gives exactly s */
+static bool encodes(const SGR *sgr, uint32_t fattr, uint32_t ffg, uint32_t fbg,
+		    uint32_t tattr, uint32_t tfg, uint32_t tbg, const char *s)
+{
+	struct mstyle f = { fattr, 0, 0, fbg, ffg };
+	struct mstyle t = { tattr, 0, 0, tbg, tfg };
+	char buf[SGRMAX + 1];
+	int n;
+
+	memset(buf, 'x', sizeof(buf));
+	n = sgr_encode(sgr, &f, &t, buf);
+	ASSERT(n >= 0 && n < SGRMAX);
+	buf[n] = 0;
+	return STREQ(buf, s);
+}
+
+int main(void)
+{
+	/* nothing to do, or nothing the terminal would show */
+	{
+		ASSERT(encodes(&xterm, A_BD, IDX(1), 0, A_BD, IDX(1), 0, ""));
+		ASSERT(encodes(&xterm, A_RV | A_SO, 0, 0, A_RV, 0, 0, ""));
+		ASSERT(encodes(&xterm, 0, 0, 0, 0, RGB(1, 2, 3), 0, ""));
+	}
+
+	/* attributes and colors go into one sequence */
+	{
+		ASSERT(encodes(&xterm, 0, 0, 0, A_BD | A_US, IDX(1), IDX(4), "\033[1;4;31;44m"));
+		ASSERT(encodes(&xterm, A_BD, IDX(1), 0, A_BD, IDX(2), IDX(9), "\033[32;101m"));
+		ASSERT(encodes(&xterm, 0, 0, 0, 0, IDX(200), IDX(16), "\033[38;5;200;48;5;16m"));
+		ASSERT(encodes(&xterm, A_BD, IDX(3), 0, A_BD, 0, 0, "\033[39m"));
+	}
+
+	/* switching off picks the shorter of a reset and single parameters */
+	{
+		ASSERT(encodes(&xterm, A_BD, IDX(1), IDX(2), 0, 0, 0, "\033[m"));
+		ASSERT(encodes(&xterm, A_BD | A_US, 0, 0, A_US, 0, 0, "\033[22m"));
+		ASSERT(encodes(&xterm, A_BD | A_DI, 0, 0, A_DI, 0, 0, "\033[;2m"));
+		ASSERT(encodes(&xterm, A_BD | A_DI, IDX(1), IDX(2), A_DI, IDX(1), IDX(2), "\033[22;2m"));
+		ASSERT(encodes(&xterm, A_BL | A_US, IDX(7), 0, A_US, IDX(7), 0, "\033[25m"));
+	}
+
+	/* without 22-29 or 39 and 49 everything is set again after a reset */
+	{
+		SGR plain = { { 2, 4, 1, 7, 7, 5 }, 0 };
+
+		ASSERT(encodes(&plain, A_BD | A_US, IDX(1), 0, A_US, IDX(1), 0, "\033[;4;31m"));
+		ASSERT(encodes(&plain, A_BD, IDX(1), 0, A_BD, 0, 0, "\033[;1m"));
+		ASSERT(encodes(&plain, 0, 0, 0, 0, IDX(9), IDX(100), ""));
+		ASSERT(encodes(&plain, 0, 0, 0, A_SO, IDX(6), 0, "\033[7;36m"));
+	}
+
+	/* 24 bit colors only where the terminal takes them */
+	{
+		SGR direct = xterm;
+
+		direct.flags |= SGR_DIRECT;
+		ASSERT(encodes(&direct, 0, 0, 0, 0, RGB(1, 2, 3), RGB(255, 0, 128),
+			       "\033[38;2;1;2;3;48;2;255;0;128m"));
+		ASSERT(encodes(&direct, A_DI | A_US | A_BD | A_RV | A_BL, RGB(255, 255, 255), RGB(255, 255, 255),
+			       A_DI | A_US, RGB(254, 254, 254), RGB(254, 254, 254),
+			       "\033[;2;4;38;2;254;254;254;48;2;254;254;254m"));
+	}
+
+	return 0;
+}
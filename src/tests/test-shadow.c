@@ -0,0 +1,235 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../shadow.h"
+#include "signature.h"
+#include "macros.h"
+
+SIGNATURE_CHECK(shadow_resize, int, (Shadow *, int, int));
+SIGNATURE_CHECK(shadow_free, void, (Shadow *));
+SIGNATURE_CHECK(shadow_forget, void, (Shadow *, int, int));
+SIGNATURE_CHECK(shadow_known, bool, (const Shadow *, int, int));
+SIGNATURE_CHECK(shadow_line, struct mline *, (Shadow *, int));
+SIGNATURE_CHECK(shadow_put, void, (Shadow *, int, int, const struct mchar *));
+SIGNATURE_CHECK(shadow_putstr, void, (Shadow *, int, int, const char *, int, const struct mchar *));
+SIGNATURE_CHECK(shadow_fill, void, (Shadow *, int, int, int, const struct mchar *));
+SIGNATURE_CHECK(shadow_setline, void, (Shadow *, int, const struct mline *));
+SIGNATURE_CHECK(shadow_scroll, void, (Shadow *, int, int, int, const struct mchar *));
+SIGNATURE_CHECK(shadow_scrollcols, void, (Shadow *, int, int, int, int, int, const struct mchar *));
+SIGNATURE_CHECK(shadow_gen, uint64_t, (const Shadow *, int));
+SIGNATURE_CHECK(shadow_setgen, void, (Shadow *, int, uint64_t));
+SIGNATURE_CHECK(shadow_run, int, (const struct mline *, const struct mline *, int, int));
+
+static struct mchar blank = { ' ', 0, 0, 0, 0, 0, 0 };
+
+/* Fill line y with character c, which makes it known. */
+static void setchar(Shadow *sh, int y, int c)
+{
+	struct mchar mc = blank;
+
+	mc.image = c;
+	shadow_fill(sh, 0, sh->width - 1, y, &mc);
+}
+
+int main(void)
+{
+	/* a fresh shadow knows nothing */
+	{
+		Shadow sh = { 0 };
+		ASSERT(shadow_resize(&sh, 10, 4) == 0);
+		ASSERT(sh.width == 10 && sh.height == 4);
+		ASSERT(!shadow_known(&sh, 0, 3));
+		ASSERT(shadow_line(&sh, 0) == NULL);
+		shadow_free(&sh);
+		ASSERT(sh.width == 0 && sh.mem == NULL);
+	}
+
+	/* only complete lines become known, single cells update them */
+	{
+		Shadow sh = { 0 };
+		struct mchar mc = blank;
+		struct mline *ml;
+
+		ASSERT(shadow_resize(&sh, 10, 4) == 0);
+		shadow_fill(&sh, 0, 8, 1, &blank);
+		ASSERT(!shadow_known(&sh, 1, 1));
+		shadow_fill(&sh, -3, 20, 1, &blank);
+		ASSERT(shadow_known(&sh, 1, 1));
+		mc.image = 'x';
+		mc.colorbg = 4;
+		shadow_put(&sh, 3, 1, &mc);
+		shadow_put(&sh, 10, 1, &mc);
+		ASSERT((ml = shadow_line(&sh, 1)) != NULL);
+		ASSERT(ml->image[3] == 'x' && mline_style(ml, 3)->colorbg == 4);
+		ASSERT(ml->image[2] == ' ' && mline_style(ml, 2)->colorbg == 0);
+		shadow_forget(&sh, 0, 1);
+		ASSERT(shadow_line(&sh, 1) == NULL);
+		shadow_free(&sh);
+	}
+
+	/* strings take the rendition and are clipped at the right margin */
+	{
+		Shadow sh = { 0 };
+		struct mchar mc = blank;
+
+		ASSERT(shadow_resize(&sh, 6, 2) == 0);
+		setchar(&sh, 0, '.');
+		mc.attr = 1;
+		mc.colorfg = 3;
+		shadow_putstr(&sh, 3, 0, "abcdef", 6, &mc);
+		ASSERT(sh.lines[0].image[2] == '.' && mline_style(&sh.lines[0], 2)->attr == 0);
+		ASSERT(sh.lines[0].image[3] == 'a' && sh.lines[0].image[5] == 'c');
+		ASSERT(mline_style(&sh.lines[0], 4)->attr == 1 && mline_style(&sh.lines[0], 5)->colorfg == 3);
+		ASSERT(shadow_known(&sh, 0, 0));
+		shadow_free(&sh);
+	}
+
+	/* setline copies a whole line */
+	{
+		Shadow sh = { 0 };
+		Shadow src = { 0 };
+
+		ASSERT(shadow_resize(&sh, 5, 2) == 0);
+		ASSERT(shadow_resize(&src, 5, 2) == 0);
+		setchar(&src, 0, 'a');
+		shadow_setline(&sh, 1, &src.lines[0]);
+		ASSERT(shadow_known(&sh, 1, 1) && !shadow_known(&sh, 0, 0));
+		for (int x = 0; x < 5; x++)
+			ASSERT(sh.lines[1].image[x] == 'a');
+		shadow_free(&src);
+		shadow_free(&sh);
+	}
+
+	/* scrolling moves lines within the region only */
+	{
+		Shadow sh = { 0 };
+
+		ASSERT(shadow_resize(&sh, 3, 5) == 0);
+		for (int y = 0; y < 5; y++)
+			setchar(&sh, y, '0' + y);
+		shadow_scroll(&sh, 1, 3, 1, &blank);
+		ASSERT(sh.lines[0].image[0] == '0');
+		ASSERT(sh.lines[1].image[0] == '2');
+		ASSERT(sh.lines[2].image[0] == '3');
+		ASSERT(sh.lines[3].image[0] == ' ' && shadow_known(&sh, 3, 3));
+		ASSERT(sh.lines[4].image[0] == '4');
+		shadow_scroll(&sh, 0, 4, -2, NULL);
+		ASSERT(!shadow_known(&sh, 0, 1) && shadow_known(&sh, 2, 4));
+		ASSERT(sh.lines[2].image[0] == '0');
+		ASSERT(sh.lines[3].image[0] == '2');
+		ASSERT(sh.lines[4].image[0] == '3');
+		shadow_scroll(&sh, 0, 4, 100, &blank);
+		ASSERT(shadow_known(&sh, 0, 4));
+		for (int y = 0; y < 5; y++)
+			ASSERT(sh.lines[y].image[0] == ' ');
+		shadow_free(&sh);
+	}
+
+	/* with margins only the columns between them move */
+	{
+		Shadow sh = { 0 };
+
+		ASSERT(shadow_resize(&sh, 4, 4) == 0);
+		for (int y = 0; y < 4; y++) {
+			setchar(&sh, y, '0' + y);
+			shadow_setgen(&sh, y, 10 + y);
+		}
+		shadow_scrollcols(&sh, 1, 2, 0, 3, 1, &blank);
+		ASSERT(shadow_known(&sh, 0, 3) && shadow_gen(&sh, 0) == 0);
+		ASSERT(sh.lines[0].image[0] == '0' && sh.lines[0].image[1] == '1');
+		ASSERT(sh.lines[0].image[2] == '1' && sh.lines[0].image[3] == '0');
+		ASSERT(sh.lines[3].image[1] == ' ' && sh.lines[3].image[3] == '3');
+		shadow_forget(&sh, 0, 0);
+		shadow_scrollcols(&sh, 1, 2, 0, 2, -1, NULL);
+		ASSERT(!shadow_known(&sh, 0, 1) && shadow_known(&sh, 2, 3));
+		ASSERT(sh.lines[2].image[1] == '2' && sh.lines[2].image[0] == '2');
+		shadow_scrollcols(&sh, 0, 3, 0, 3, 1, &blank);	/* full width */
+		ASSERT(!shadow_known(&sh, 0, 0) && shadow_known(&sh, 1, 3));
+		ASSERT(sh.lines[1].image[0] == '2' && sh.lines[1].image[1] == '2');
+		shadow_free(&sh);
+	}
+
+	/* generations move with scrolled lines and go with any other change */
+	{
+		Shadow sh = { 0 };
+
+		ASSERT(shadow_resize(&sh, 4, 4) == 0);
+		for (int y = 0; y < 4; y++) {
+			setchar(&sh, y, 'a' + y);
+			shadow_setgen(&sh, y, 10 + y);
+		}
+		ASSERT(shadow_gen(&sh, 2) == 12);
+		shadow_scroll(&sh, 0, 3, 1, &blank);
+		ASSERT(shadow_gen(&sh, 0) == 11 && shadow_gen(&sh, 2) == 13);
+		ASSERT(shadow_gen(&sh, 3) == 0);
+		shadow_put(&sh, 1, 0, &blank);
+		ASSERT(shadow_gen(&sh, 0) == 0 && shadow_gen(&sh, 1) == 12);
+		shadow_putstr(&sh, 0, 1, "x", 1, &blank);
+		ASSERT(shadow_gen(&sh, 1) == 0);
+		shadow_forget(&sh, 2, 2);
+		ASSERT(shadow_gen(&sh, 2) == 0);
+		shadow_setgen(&sh, 2, 5);
+		ASSERT(shadow_gen(&sh, 2) == 0);	/* unknown lines have none */
+		shadow_setline(&sh, 2, &sh.lines[0]);
+		ASSERT(shadow_gen(&sh, 2) == 0);
+		shadow_free(&sh);
+	}
+
+	/* runs of equal cells end at the last one that needs drawing */
+	{
+		Shadow sh = { 0 };
+		struct mchar mc = blank;
+
+		ASSERT(shadow_resize(&sh, 20, 3) == 0);
+		setchar(&sh, 0, '-');
+		setchar(&sh, 1, '-');
+		setchar(&sh, 2, ' ');
+		mc.image = 'x';
+		shadow_put(&sh, 10, 1, &mc);
+		/* a single cell that changes is not a run */
+		ASSERT(shadow_run(&sh.lines[1], &sh.lines[0], 10, 19) == 1);
+		ASSERT(shadow_run(&sh.lines[0], &sh.lines[1], 10, 19) == 1);
+		/* the cells that are right before the last wrong one go with it */
+		shadow_put(&sh, 14, 1, &mc);
+		ASSERT(shadow_run(&sh.lines[1], &sh.lines[0], 10, 19) == 5);
+		ASSERT(shadow_run(&sh.lines[2], &sh.lines[0], 0, 19) == 20);
+		ASSERT(shadow_run(&sh.lines[2], &sh.lines[0], 0, 7) == 8);
+		/* a change of rendition ends the run */
+		mc.image = '-';
+		mc.attr = 1;
+		shadow_put(&sh, 5, 0, &mc);
+		ASSERT(shadow_run(&sh.lines[2], &sh.lines[0], 0, 19) == 5);
+		ASSERT(shadow_run(&sh.lines[2], &sh.lines[0], 6, 19) == 14);
+		shadow_free(&sh);
+	}
+
+	/* allocation failure leaves an empty shadow */
+	{
+		Shadow sh = { 0 };
+		ASSERT_GCC(FAILLOC(shadow_resize(&sh, 80, 24)) == -1);
+		ASSERT(sh.width == 0 && sh.mem == NULL);
+		shadow_free(&sh);
+	}
+
+	return 0;
+}
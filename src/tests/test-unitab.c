@@ -0,0 +1,87 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "../unitab.h"
+#include "signature.h"
+#include "macros.h"
+
+SIGNATURE_CHECK(unitab, int, (int));
+
+int main(void)
+{
+	/* narrow */
+	{
+		ASSERT(unitab('a') == 0);
+		ASSERT(unitab(0xa0) == 0);
+		ASSERT(unitab(0x00ad) == UNI_AMBIGUOUS);	/* soft hyphen takes a cell */
+		ASSERT(unitab(0x0410) == UNI_AMBIGUOUS);
+		ASSERT(unitab(0x00e9) == UNI_AMBIGUOUS);
+		ASSERT(unitab(0xfffd) == UNI_AMBIGUOUS);
+		ASSERT(unitab(0x2500) == UNI_AMBIGUOUS);
+		ASSERT(unitab(0xff61) == 0);	/* halfwidth katakana */
+	}
+
+	/* wide, including emoji and unassigned ideographs */
+	{
+		ASSERT(unitab(0x1100) == UNI_WIDE);
+		ASSERT(unitab(0x3000) == UNI_WIDE);
+		ASSERT(unitab(0x4e00) == UNI_WIDE);
+		ASSERT(unitab(0x9fff) == UNI_WIDE);
+		ASSERT(unitab(0xac00) == UNI_WIDE);
+		ASSERT(unitab(0xff01) == UNI_WIDE);
+		ASSERT(unitab(0x1f600) == UNI_WIDE);
+		ASSERT(unitab(0x1f680) == UNI_WIDE);
+		ASSERT(unitab(0x2fffd) == UNI_WIDE);
+		ASSERT(unitab(0x3fffd) == UNI_WIDE);
+		ASSERT(unitab(0x303f) == 0);
+	}
+
+	/* combining */
+	{
+		ASSERT(unitab(0x0300) == UNI_COMB);
+		ASSERT(unitab(0x0301) == UNI_COMB);	/* ambiguous, but has no width */
+		ASSERT(unitab(0x0488) == UNI_COMB);
+		ASSERT(unitab(0x200b) == UNI_COMB);
+		ASSERT(unitab(0x1160) == UNI_COMB);
+		ASSERT(unitab(0x11ff) == UNI_COMB);
+		ASSERT(unitab(0xfe0f) == UNI_COMB);
+		ASSERT(unitab(0x302a) == (UNI_WIDE | UNI_COMB));
+		ASSERT(unitab(0xe0100) == UNI_COMB);
+	}
+
+	/* private use is ambiguous, outside Unicode is nothing */
+	{
+		ASSERT(unitab(0xe000) == UNI_AMBIGUOUS);
+		ASSERT(unitab(0x10fffd) == UNI_AMBIGUOUS);
+		ASSERT(unitab(0x10ffff) == 0);
+		ASSERT(unitab(0x110000) == 0);
+		ASSERT(unitab(0x7fffff) == 0);
+		ASSERT(unitab(-1) == 0);
+	}
+
+	/* ambiguous and combining exclude each other */
+	{
+		for (int c = 0; c <= 0x10ffff; c++)
+			ASSERT((unitab(c) & (UNI_AMBIGUOUS | UNI_COMB)) != (UNI_AMBIGUOUS | UNI_COMB));
+	}
+
+	return 0;
+}
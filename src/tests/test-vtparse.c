@@ -0,0 +1,131 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "../vtparse.h"
+#include "signature.h"
+#include "macros.h"
+
+SIGNATURE_CHECK(vtparse, int, (int, int));
+SIGNATURE_CHECK(vtparse_collect, int, (int, int));
+
+static bool is(int state, int c, int action, int next)
+{
+	int e = vtparse(state, c);
+
+	return VT_ACTION(e) == action && VT_STATE(e) == next;
+}
+
+int main(void)
+{
+	/* every entry is a valid action and state */
+	{
+		ASSERT(VTC_MAX <= VTC_ROW);
+		ASSERT(PRIN4 < 1 << (16 - VTA_BITS));
+		for (int s = LIT; s <= PRIN4; s++)
+			for (int c = 0; c < 0x110000; c += c < 256 ? 1 : 0x1000) {
+				int e = vtparse(s, c);
+				ASSERT(VT_ACTION(e) < VTA_MAX);
+				ASSERT(VT_STATE(e) <= PRIN4);
+			}
+	}
+
+	/* text and controls */
+	{
+		ASSERT(is(LIT, 'a', VTA_PRINT, LIT));
+		ASSERT(is(LIT, ' ', VTA_PRINT, LIT));
+		ASSERT(is(LIT, 0x7f, VTA_PRINT, LIT));
+		ASSERT(is(LIT, 0xe9, VTA_PRINT, LIT));
+		ASSERT(is(LIT, 0x65e5, VTA_PRINT, LIT));
+		ASSERT(is(LIT, '\n', VTA_EXEC, LIT));
+		ASSERT(is(LIT, '\f', VTA_EXEC, LIT));
+		ASSERT(is(LIT, 0, VTA_EXEC, LIT));
+		ASSERT(is(LIT, 033, VTA_ESCAPE, ESC));
+		ASSERT(is(LIT, 0x9b, VTA_C1, LIT));
+		ASSERT(is(LIT, 0x9c, VTA_C1, LIT));
+	}
+
+	/* escape sequences */
+	{
+		ASSERT(is(ESC, '[', VTA_CSIENTRY, CSI));
+		ASSERT(is(ESC, '(', VTA_ESCCOLLECT, ESC));
+		ASSERT(is(ESC, ' ', VTA_ESCCOLLECT, ESC));
+		ASSERT(is(ESC, '7', VTA_ESCDISPATCH, LIT));
+		ASSERT(is(ESC, 'c', VTA_ESCDISPATCH, LIT));
+		ASSERT(is(ESC, '\\', VTA_ESCDISPATCH, LIT));
+		ASSERT(is(ESC, '\r', VTA_EXEC, LIT));
+		ASSERT(is(ESC, 033, VTA_REDO, LIT));
+		ASSERT(is(ESC, 0x18, VTA_REDO, LIT));
+		ASSERT(is(ESC, 'x' | 0x80, VTA_REDO, LIT));
+		ASSERT(is(CSI, '4', VTA_PARAM, CSI));
+		ASSERT(is(CSI, ':', VTA_NEXTPARAM, CSI));
+		ASSERT(is(CSI, '?', VTA_CSICOLLECT, CSI));
+		ASSERT(is(CSI, '$', VTA_CSICOLLECT, CSI));
+		ASSERT(is(CSI, '\b', VTA_EXEC, CSI));
+		ASSERT(is(CSI, 'm', VTA_CSIDISPATCH, LIT));
+		ASSERT(is(CSI, '[', VTA_CSIDISPATCH, LIT));
+		ASSERT(is(CSI, 033, VTA_REDO, LIT));
+		ASSERT(is(CSI, 0x7f, VTA_REDO, LIT));
+	}
+
+	/* a private marker can be followed by an intermediate, as in DECRQM */
+	{
+		ASSERT(vtparse_collect(0, '?') == '?');
+		ASSERT(vtparse_collect(0, '$') == '$');
+		ASSERT(vtparse_collect('?', '$') == ('?' << 8 | '$'));
+		ASSERT(vtparse_collect('>', ' ') == ('>' << 8 | ' '));
+		ASSERT(vtparse_collect('$', '?') == -1);
+		ASSERT(vtparse_collect('?', '?') == -1);
+		ASSERT(vtparse_collect('$', '$') == -1);
+		ASSERT(vtparse_collect('?' << 8 | '$', '$') == -1);
+		ASSERT(vtparse_collect(-1, '$') == -1);
+	}
+
+	/* control strings */
+	{
+		const char starts[] = "]_P^!\"k";
+
+		for (int i = 0; starts[i]; i++)
+			ASSERT(is(ESC, starts[i], VTA_STRSTART, ASTR));
+		ASSERT(is(ASTR, 'x', VTA_STRPUT, ASTR));
+		ASSERT(is(ASTR, 005, VTA_STRPUT, ASTR));
+		ASSERT(is(ASTR, 007, VTA_STRCTL, ASTR));
+		ASSERT(is(ASTR, 0x9c, VTA_STRST, ASTR));
+		ASSERT(is(ASTR, 0, VTA_NONE, ASTR));
+		ASSERT(is(ASTR, 033, VTA_NONE, STRESC));
+		ASSERT(is(STRESC, '\\', VTA_STREND, LIT));
+		ASSERT(is(STRESC, 033, VTA_STRESC, STRESC));
+		ASSERT(is(STRESC, 'x', VTA_STRESC, ASTR));
+	}
+
+	/* printer mode ends only at CSI 4 i */
+	{
+		ASSERT(is(PRIN, 'x', VTA_PRINTPUT, PRIN));
+		ASSERT(is(PRIN, 033, VTA_NONE, PRINESC));
+		ASSERT(is(PRINESC, '[', VTA_NONE, PRINCSI));
+		ASSERT(is(PRINESC, 'x', VTA_PRINTREPLAY, PRIN));
+		ASSERT(is(PRINCSI, '4', VTA_NONE, PRIN4));
+		ASSERT(is(PRINCSI, '5', VTA_PRINTREPLAY, PRIN));
+		ASSERT(is(PRIN4, 'i', VTA_PRINTEND, LIT));
+		ASSERT(is(PRIN4, 'h', VTA_PRINTREPLAY, PRIN));
+	}
+
+	return 0;
+}
@@ -0,0 +1,47 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#ifndef SCREEN_UNITAB_H
+#define SCREEN_UNITAB_H
+
+#include <stdint.h>
+
+/*
+ * Character properties for the terminal width of Unicode code points,
+ * looked up in constant time in the tables unitab.sh generates from the
+ * data in unicode/.
+ */
+
+#define UNI_WIDE	1	/* East Asian Wide or Fullwidth */
+#define UNI_AMBIGUOUS	2	/* East Asian Ambiguous, wide with cjkwidth */
+#define UNI_COMB	4	/* combines with the character before */
+
+extern const uint8_t unitab_level1[272];
+extern const uint8_t unitab_level2[][32];
+extern const uint8_t unitab_level3[][128];
+
+/* UNI_* flags of code point c */
+static inline int unitab(int c)
+{
+	if ((unsigned int)c < 0xa1 || (unsigned int)c > 0x10ffff)
+		return 0;	/* ASCII and Latin-1 controls have no flags */
+	return unitab_level3[unitab_level2[unitab_level1[c >> 12]][c >> 7 & 31]][c & 127];
+}
+
+#endif /* SCREEN_UNITAB_H */
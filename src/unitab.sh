@@ -0,0 +1,129 @@
+#! /bin/sh
+#
+# Generate unitab.c, the character width tables, from the Unicode data
+# in unicode/. Every code point gets a few UNI_* flags (see unitab.h),
+# stored in three levels: 4096 code point planes, 128 code point blocks
+# and the blocks themselves, where equal blocks and block lists are
+# shared.
+
+if test -z "$AWK"; then
+  AWK=awk
+fi
+if test -z "$srcdir"; then
+  srcdir=.
+fi
+
+LC_ALL=C
+export LC_ALL
+
+rm -f unitab.c
+$AWK '
+function hex(s,    i, n) {
+	n = 0
+	for (i = 1; i <= length(s); i++)
+		n = n * 16 + index("0123456789ABCDEF", toupper(substr(s, i, 1))) - 1
+	return n
+}
+function range(s) {
+	if (split(s, r, /\.\./) == 1)
+		r[2] = r[1]
+	lo = hex(r[1])
+	hi = hex(r[2])
+}
+function set(f,    c) {
+	for (c = lo; c <= hi; c++)
+		flag[c] = f
+}
+FILENAME ~ /EastAsianWidth/ && /^# @missing:/ {
+	sub(/;/, " ")
+	if ($4 == "W" || $4 == "F") {
+		range($3)
+		set(1)
+	}
+	next
+}
+FILENAME ~ /EastAsianWidth/ && /^[0-9A-F]/ {
+	sub(/[ \t]*#.*/, "")
+	split($1, e, /;/)
+	range(e[1])
+	set(e[2] == "W" || e[2] == "F" ? 1 : e[2] == "A" ? 2 : 0)
+	next
+}
+FILENAME ~ /DerivedGeneralCategory/ && /^[0-9A-F]/ {
+	range($1)
+	if ($3 == "Mn" || $3 == "Me" || ($3 == "Cf" && lo != 173))
+		comb[++ncomb] = lo " " hi
+	next
+}
+END {
+	# Hangul medial vowels and final consonants join the initial one
+	comb[++ncomb] = 4448 " " 4607
+	for (i = 1; i <= ncomb; i++) {
+		split(comb[i], r, " ")
+		for (c = r[1] + 0; c <= r[2] + 0; c++) {
+			f = c in flag ? flag[c] : 0
+			if (f == 2)
+				f = 0	# ambiguous only if it has a width
+			flag[c] = f + 4
+		}
+	}
+
+	nblocks = nplanes = 0
+	for (p = 0; p < 272; p++) {
+		list = ""
+		for (b = 0; b < 32; b++) {
+			s = ""
+			base = p * 4096 + b * 128
+			for (c = base; c < base + 128; c++)
+				s = s (c in flag ? flag[c] : 0) ","
+			if (!(s in block)) {
+				block[s] = nblocks
+				blocks[nblocks++] = s
+			}
+			list = list block[s] ","
+		}
+		if (!(list in plane)) {
+			plane[list] = nplanes
+			planes[nplanes++] = list
+		}
+		level1[p] = plane[list]
+	}
+	if (nblocks > 256 || nplanes > 256) {
+		print "unitab.sh: too many blocks" > "/dev/stderr"
+		exit 1
+	}
+
+	print "/*"
+	print " * This file is automagically created from the files in unicode/ by unitab.sh"
+	print " * -- DO NOT EDIT"
+	print " */"
+	print ""
+	print "#include \"unitab.h\""
+	print ""
+	printf "const uint8_t unitab_level1[272] = {"
+	for (p = 0; p < 272; p++)
+		printf "%s%d", (p % 16 ? ", " : p ? ",\n\t" : "\n\t"), level1[p]
+	print "\n};"
+	print ""
+	printf "const uint8_t unitab_level2[][32] = {\n"
+	for (i = 0; i < nplanes; i++) {
+		n = split(planes[i], v, ",")
+		printf "\t{"
+		for (j = 1; j < n; j++)
+			printf "%s%d", (j == 1 ? "" : j % 16 == 1 ? ",\n\t " : ", "), v[j]
+		print "},"
+	}
+	print "};"
+	print ""
+	printf "const uint8_t unitab_level3[][128] = {\n"
+	for (i = 0; i < nblocks; i++) {
+		n = split(blocks[i], v, ",")
+		printf "\t{"
+		for (j = 1; j < n; j++)
+			printf "%s%d", (j == 1 ? "" : j % 32 == 1 ? ",\n\t " : ", "), v[j]
+		print "},"
+	}
+	print "};"
+}
+' ${srcdir}/unicode/EastAsianWidth.txt ${srcdir}/unicode/DerivedGeneralCategory.txt > unitab.c || { rm -f unitab.c; exit 1; }
+chmod a-w unitab.c
@@ -0,0 +1,311 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#include "config.h"
+
+#include "vtparse.h"
+
+/*
+ * The dispatch tables for WriteString. They follow the structure of the
+ * DEC compatible parser diagrams, restricted to the states and actions
+ * screen has always had: sequences screen does not know are dropped the
+ * same way, control strings end at ST (OSC also at any control but ^E)
+ * and printer mode passes everything through until CSI 4 i.
+ */
+
+/* Entries not listed are VTC_HIGH. */
+const uint8_t vtparse_class[256] = {
+	/* 0x00 */ VTC_NUL, VTC_CTL, VTC_CTL, VTC_CTL, VTC_CTL, VTC_ENQ, VTC_CTL, VTC_EXEC,
+	/* 0x08 */ VTC_EXEC, VTC_EXEC, VTC_EXEC, VTC_EXEC, VTC_CTL, VTC_EXEC, VTC_EXEC, VTC_EXEC,
+	/* 0x10 */ VTC_CTL, VTC_CTL, VTC_CTL, VTC_CTL, VTC_CTL, VTC_CTL, VTC_CTL, VTC_CTL,
+	/* 0x18 */ VTC_CTL, VTC_CTL, VTC_CTL, VTC_ESC, VTC_CTL, VTC_CTL, VTC_CTL, VTC_CTL,
+	/* 0x20 */ VTC_SP, VTC_BANG, VTC_DQUOTE, VTC_INTER, VTC_INTER, VTC_INTER, VTC_INTER, VTC_INTER,
+	/* 0x28 */ VTC_INTER, VTC_INTER, VTC_INTER, VTC_INTER, VTC_INTER, VTC_INTER, VTC_INTER, VTC_INTER,
+	/* 0x30 */ VTC_DIGIT, VTC_DIGIT, VTC_DIGIT, VTC_DIGIT, VTC_FOUR, VTC_DIGIT, VTC_DIGIT, VTC_DIGIT,
+	/* 0x38 */ VTC_DIGIT, VTC_DIGIT, VTC_SEP, VTC_SEP, VTC_PRIV, VTC_PRIV, VTC_PRIV, VTC_PRIV,
+	/* 0x40 */ VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL,
+	/* 0x48 */ VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL,
+	/* 0x50 */ VTC_P, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL,
+	/* 0x58 */ VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_LBRACKET, VTC_BSLASH, VTC_RBRACKET, VTC_CARET, VTC_UNDERSCORE,
+	/* 0x60 */ VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL,
+	/* 0x68 */ VTC_FINAL, VTC_I, VTC_FINAL, VTC_K, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL,
+	/* 0x70 */ VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL,
+	/* 0x78 */ VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_FINAL, VTC_DEL,
+	/* 0x80 */ VTC_C1, VTC_C1, VTC_C1, VTC_C1, VTC_C1, VTC_C1, VTC_C1, VTC_C1,
+	/* 0x88 */ VTC_C1, VTC_C1, VTC_C1, VTC_C1, VTC_C1, VTC_C1, VTC_C1, VTC_C1,
+	/* 0x90 */ VTC_C1, VTC_C1, VTC_C1, VTC_C1, VTC_C1, VTC_C1, VTC_C1, VTC_C1,
+	/* 0x98 */ VTC_C1, VTC_C1, VTC_C1, VTC_C1, VTC_ST, VTC_C1, VTC_C1, VTC_C1,
+};
+
+#define E(a, s)	((s) << VTA_BITS | VTA_##a)
+
+const uint16_t vtparse_table[PRIN4 + 1][VTC_ROW] = {
+	[LIT] = {
+		[VTC_HIGH] = E(PRINT, LIT),
+		[VTC_NUL] = E(EXEC, LIT),
+		[VTC_EXEC] = E(EXEC, LIT),
+		[VTC_CTL] = E(EXEC, LIT),
+		[VTC_ENQ] = E(EXEC, LIT),
+		[VTC_ESC] = E(ESCAPE, ESC),
+		[VTC_SP] = E(PRINT, LIT),
+		[VTC_BANG] = E(PRINT, LIT),
+		[VTC_DQUOTE] = E(PRINT, LIT),
+		[VTC_INTER] = E(PRINT, LIT),
+		[VTC_DIGIT] = E(PRINT, LIT),
+		[VTC_FOUR] = E(PRINT, LIT),
+		[VTC_SEP] = E(PRINT, LIT),
+		[VTC_PRIV] = E(PRINT, LIT),
+		[VTC_FINAL] = E(PRINT, LIT),
+		[VTC_P] = E(PRINT, LIT),
+		[VTC_LBRACKET] = E(PRINT, LIT),
+		[VTC_BSLASH] = E(PRINT, LIT),
+		[VTC_RBRACKET] = E(PRINT, LIT),
+		[VTC_CARET] = E(PRINT, LIT),
+		[VTC_UNDERSCORE] = E(PRINT, LIT),
+		[VTC_I] = E(PRINT, LIT),
+		[VTC_K] = E(PRINT, LIT),
+		[VTC_DEL] = E(PRINT, LIT),
+		[VTC_C1] = E(C1, LIT),
+		[VTC_ST] = E(C1, LIT),
+	},
+	[ESC] = {
+		[VTC_HIGH] = E(REDO, LIT),
+		[VTC_NUL] = E(REDO, LIT),
+		[VTC_EXEC] = E(EXEC, LIT),
+		[VTC_CTL] = E(REDO, LIT),
+		[VTC_ENQ] = E(REDO, LIT),
+		[VTC_ESC] = E(REDO, LIT),
+		[VTC_SP] = E(ESCCOLLECT, ESC),
+		[VTC_BANG] = E(STRSTART, ASTR),
+		[VTC_DQUOTE] = E(STRSTART, ASTR),
+		[VTC_INTER] = E(ESCCOLLECT, ESC),
+		[VTC_DIGIT] = E(ESCDISPATCH, LIT),
+		[VTC_FOUR] = E(ESCDISPATCH, LIT),
+		[VTC_SEP] = E(ESCDISPATCH, LIT),
+		[VTC_PRIV] = E(ESCDISPATCH, LIT),
+		[VTC_FINAL] = E(ESCDISPATCH, LIT),
+		[VTC_P] = E(STRSTART, ASTR),
+		[VTC_LBRACKET] = E(CSIENTRY, CSI),
+		[VTC_BSLASH] = E(ESCDISPATCH, LIT),
+		[VTC_RBRACKET] = E(STRSTART, ASTR),
+		[VTC_CARET] = E(STRSTART, ASTR),
+		[VTC_UNDERSCORE] = E(STRSTART, ASTR),
+		[VTC_I] = E(ESCDISPATCH, LIT),
+		[VTC_K] = E(STRSTART, ASTR),
+		[VTC_DEL] = E(REDO, LIT),
+		[VTC_C1] = E(REDO, LIT),
+		[VTC_ST] = E(REDO, LIT),
+	},
+	[ASTR] = {
+		[VTC_HIGH] = E(STRPUT, ASTR),
+		[VTC_NUL] = E(NONE, ASTR),
+		[VTC_EXEC] = E(STRCTL, ASTR),
+		[VTC_CTL] = E(STRCTL, ASTR),
+		[VTC_ENQ] = E(STRPUT, ASTR),
+		[VTC_ESC] = E(NONE, STRESC),
+		[VTC_SP] = E(STRPUT, ASTR),
+		[VTC_BANG] = E(STRPUT, ASTR),
+		[VTC_DQUOTE] = E(STRPUT, ASTR),
+		[VTC_INTER] = E(STRPUT, ASTR),
+		[VTC_DIGIT] = E(STRPUT, ASTR),
+		[VTC_FOUR] = E(STRPUT, ASTR),
+		[VTC_SEP] = E(STRPUT, ASTR),
+		[VTC_PRIV] = E(STRPUT, ASTR),
+		[VTC_FINAL] = E(STRPUT, ASTR),
+		[VTC_P] = E(STRPUT, ASTR),
+		[VTC_LBRACKET] = E(STRPUT, ASTR),
+		[VTC_BSLASH] = E(STRPUT, ASTR),
+		[VTC_RBRACKET] = E(STRPUT, ASTR),
+		[VTC_CARET] = E(STRPUT, ASTR),
+		[VTC_UNDERSCORE] = E(STRPUT, ASTR),
+		[VTC_I] = E(STRPUT, ASTR),
+		[VTC_K] = E(STRPUT, ASTR),
+		[VTC_DEL] = E(STRPUT, ASTR),
+		[VTC_C1] = E(STRPUT, ASTR),
+		[VTC_ST] = E(STRST, ASTR),
+	},
+	[STRESC] = {
+		[VTC_HIGH] = E(STRESC, ASTR),
+		[VTC_NUL] = E(STRESC, ASTR),
+		[VTC_EXEC] = E(STRESC, ASTR),
+		[VTC_CTL] = E(STRESC, ASTR),
+		[VTC_ENQ] = E(STRESC, ASTR),
+		[VTC_ESC] = E(STRESC, STRESC),
+		[VTC_SP] = E(STRESC, ASTR),
+		[VTC_BANG] = E(STRESC, ASTR),
+		[VTC_DQUOTE] = E(STRESC, ASTR),
+		[VTC_INTER] = E(STRESC, ASTR),
+		[VTC_DIGIT] = E(STRESC, ASTR),
+		[VTC_FOUR] = E(STRESC, ASTR),
+		[VTC_SEP] = E(STRESC, ASTR),
+		[VTC_PRIV] = E(STRESC, ASTR),
+		[VTC_FINAL] = E(STRESC, ASTR),
+		[VTC_P] = E(STRESC, ASTR),
+		[VTC_LBRACKET] = E(STRESC, ASTR),
+		[VTC_BSLASH] = E(STREND, LIT),
+		[VTC_RBRACKET] = E(STRESC, ASTR),
+		[VTC_CARET] = E(STRESC, ASTR),
+		[VTC_UNDERSCORE] = E(STRESC, ASTR),
+		[VTC_I] = E(STRESC, ASTR),
+		[VTC_K] = E(STRESC, ASTR),
+		[VTC_DEL] = E(STRESC, ASTR),
+		[VTC_C1] = E(STRESC, ASTR),
+		[VTC_ST] = E(STRESC, ASTR),
+	},
+	[CSI] = {
+		[VTC_HIGH] = E(REDO, LIT),
+		[VTC_NUL] = E(REDO, LIT),
+		[VTC_EXEC] = E(EXEC, CSI),
+		[VTC_CTL] = E(REDO, LIT),
+		[VTC_ENQ] = E(REDO, LIT),
+		[VTC_ESC] = E(REDO, LIT),
+		[VTC_SP] = E(CSICOLLECT, CSI),
+		[VTC_BANG] = E(CSICOLLECT, CSI),
+		[VTC_DQUOTE] = E(CSICOLLECT, CSI),
+		[VTC_INTER] = E(CSICOLLECT, CSI),
+		[VTC_DIGIT] = E(PARAM, CSI),
+		[VTC_FOUR] = E(PARAM, CSI),
+		[VTC_SEP] = E(NEXTPARAM, CSI),
+		[VTC_PRIV] = E(CSICOLLECT, CSI),
+		[VTC_FINAL] = E(CSIDISPATCH, LIT),
+		[VTC_P] = E(CSIDISPATCH, LIT),
+		[VTC_LBRACKET] = E(CSIDISPATCH, LIT),
+		[VTC_BSLASH] = E(CSIDISPATCH, LIT),
+		[VTC_RBRACKET] = E(CSIDISPATCH, LIT),
+		[VTC_CARET] = E(CSIDISPATCH, LIT),
+		[VTC_UNDERSCORE] = E(CSIDISPATCH, LIT),
+		[VTC_I] = E(CSIDISPATCH, LIT),
+		[VTC_K] = E(CSIDISPATCH, LIT),
+		[VTC_DEL] = E(REDO, LIT),
+		[VTC_C1] = E(REDO, LIT),
+		[VTC_ST] = E(REDO, LIT),
+	},
+	[PRIN] = {
+		[VTC_HIGH] = E(PRINTPUT, PRIN),
+		[VTC_NUL] = E(PRINTPUT, PRIN),
+		[VTC_EXEC] = E(PRINTPUT, PRIN),
+		[VTC_CTL] = E(PRINTPUT, PRIN),
+		[VTC_ENQ] = E(PRINTPUT, PRIN),
+		[VTC_ESC] = E(NONE, PRINESC),
+		[VTC_SP] = E(PRINTPUT, PRIN),
+		[VTC_BANG] = E(PRINTPUT, PRIN),
+		[VTC_DQUOTE] = E(PRINTPUT, PRIN),
+		[VTC_INTER] = E(PRINTPUT, PRIN),
+		[VTC_DIGIT] = E(PRINTPUT, PRIN),
+		[VTC_FOUR] = E(PRINTPUT, PRIN),
+		[VTC_SEP] = E(PRINTPUT, PRIN),
+		[VTC_PRIV] = E(PRINTPUT, PRIN),
+		[VTC_FINAL] = E(PRINTPUT, PRIN),
+		[VTC_P] = E(PRINTPUT, PRIN),
+		[VTC_LBRACKET] = E(PRINTPUT, PRIN),
+		[VTC_BSLASH] = E(PRINTPUT, PRIN),
+		[VTC_RBRACKET] = E(PRINTPUT, PRIN),
+		[VTC_CARET] = E(PRINTPUT, PRIN),
+		[VTC_UNDERSCORE] = E(PRINTPUT, PRIN),
+		[VTC_I] = E(PRINTPUT, PRIN),
+		[VTC_K] = E(PRINTPUT, PRIN),
+		[VTC_DEL] = E(PRINTPUT, PRIN),
+		[VTC_C1] = E(PRINTPUT, PRIN),
+		[VTC_ST] = E(PRINTPUT, PRIN),
+	},
+	[PRINESC] = {
+		[VTC_HIGH] = E(PRINTREPLAY, PRIN),
+		[VTC_NUL] = E(PRINTREPLAY, PRIN),
+		[VTC_EXEC] = E(PRINTREPLAY, PRIN),
+		[VTC_CTL] = E(PRINTREPLAY, PRIN),
+		[VTC_ENQ] = E(PRINTREPLAY, PRIN),
+		[VTC_ESC] = E(PRINTREPLAY, PRIN),
+		[VTC_SP] = E(PRINTREPLAY, PRIN),
+		[VTC_BANG] = E(PRINTREPLAY, PRIN),
+		[VTC_DQUOTE] = E(PRINTREPLAY, PRIN),
+		[VTC_INTER] = E(PRINTREPLAY, PRIN),
+		[VTC_DIGIT] = E(PRINTREPLAY, PRIN),
+		[VTC_FOUR] = E(PRINTREPLAY, PRIN),
+		[VTC_SEP] = E(PRINTREPLAY, PRIN),
+		[VTC_PRIV] = E(PRINTREPLAY, PRIN),
+		[VTC_FINAL] = E(PRINTREPLAY, PRIN),
+		[VTC_P] = E(PRINTREPLAY, PRIN),
+		[VTC_LBRACKET] = E(NONE, PRINCSI),
+		[VTC_BSLASH] = E(PRINTREPLAY, PRIN),
+		[VTC_RBRACKET] = E(PRINTREPLAY, PRIN),
+		[VTC_CARET] = E(PRINTREPLAY, PRIN),
+		[VTC_UNDERSCORE] = E(PRINTREPLAY, PRIN),
+		[VTC_I] = E(PRINTREPLAY, PRIN),
+		[VTC_K] = E(PRINTREPLAY, PRIN),
+		[VTC_DEL] = E(PRINTREPLAY, PRIN),
+		[VTC_C1] = E(PRINTREPLAY, PRIN),
+		[VTC_ST] = E(PRINTREPLAY, PRIN),
+	},
+	[PRINCSI] = {
+		[VTC_HIGH] = E(PRINTREPLAY, PRIN),
+		[VTC_NUL] = E(PRINTREPLAY, PRIN),
+		[VTC_EXEC] = E(PRINTREPLAY, PRIN),
+		[VTC_CTL] = E(PRINTREPLAY, PRIN),
+		[VTC_ENQ] = E(PRINTREPLAY, PRIN),
+		[VTC_ESC] = E(PRINTREPLAY, PRIN),
+		[VTC_SP] = E(PRINTREPLAY, PRIN),
+		[VTC_BANG] = E(PRINTREPLAY, PRIN),
+		[VTC_DQUOTE] = E(PRINTREPLAY, PRIN),
+		[VTC_INTER] = E(PRINTREPLAY, PRIN),
+		[VTC_DIGIT] = E(PRINTREPLAY, PRIN),
+		[VTC_FOUR] = E(NONE, PRIN4),
+		[VTC_SEP] = E(PRINTREPLAY, PRIN),
+		[VTC_PRIV] = E(PRINTREPLAY, PRIN),
+		[VTC_FINAL] = E(PRINTREPLAY, PRIN),
+		[VTC_P] = E(PRINTREPLAY, PRIN),
+		[VTC_LBRACKET] = E(PRINTREPLAY, PRIN),
+		[VTC_BSLASH] = E(PRINTREPLAY, PRIN),
+		[VTC_RBRACKET] = E(PRINTREPLAY, PRIN),
+		[VTC_CARET] = E(PRINTREPLAY, PRIN),
+		[VTC_UNDERSCORE] = E(PRINTREPLAY, PRIN),
+		[VTC_I] = E(PRINTREPLAY, PRIN),
+		[VTC_K] = E(PRINTREPLAY, PRIN),
+		[VTC_DEL] = E(PRINTREPLAY, PRIN),
+		[VTC_C1] = E(PRINTREPLAY, PRIN),
+		[VTC_ST] = E(PRINTREPLAY, PRIN),
+	},
+	[PRIN4] = {
+		[VTC_HIGH] = E(PRINTREPLAY, PRIN),
+		[VTC_NUL] = E(PRINTREPLAY, PRIN),
+		[VTC_EXEC] = E(PRINTREPLAY, PRIN),
+		[VTC_CTL] = E(PRINTREPLAY, PRIN),
+		[VTC_ENQ] = E(PRINTREPLAY, PRIN),
+		[VTC_ESC] = E(PRINTREPLAY, PRIN),
+		[VTC_SP] = E(PRINTREPLAY, PRIN),
+		[VTC_BANG] = E(PRINTREPLAY, PRIN),
+		[VTC_DQUOTE] = E(PRINTREPLAY, PRIN),
+		[VTC_INTER] = E(PRINTREPLAY, PRIN),
+		[VTC_DIGIT] = E(PRINTREPLAY, PRIN),
+		[VTC_FOUR] = E(PRINTREPLAY, PRIN),
+		[VTC_SEP] = E(PRINTREPLAY, PRIN),
+		[VTC_PRIV] = E(PRINTREPLAY, PRIN),
+		[VTC_FINAL] = E(PRINTREPLAY, PRIN),
+		[VTC_P] = E(PRINTREPLAY, PRIN),
+		[VTC_LBRACKET] = E(PRINTREPLAY, PRIN),
+		[VTC_BSLASH] = E(PRINTREPLAY, PRIN),
+		[VTC_RBRACKET] = E(PRINTREPLAY, PRIN),
+		[VTC_CARET] = E(PRINTREPLAY, PRIN),
+		[VTC_UNDERSCORE] = E(PRINTREPLAY, PRIN),
+		[VTC_I] = E(PRINTEND, LIT),
+		[VTC_K] = E(PRINTREPLAY, PRIN),
+		[VTC_DEL] = E(PRINTREPLAY, PRIN),
+		[VTC_C1] = E(PRINTREPLAY, PRIN),
+		[VTC_ST] = E(PRINTREPLAY, PRIN),
+	},
+};
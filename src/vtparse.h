@@ -0,0 +1,120 @@
+/* This file is part of GNU screen.
+ *
+ * GNU screen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (see the file COPYING); if not, see
+ * <http://www.gnu.org/licenses>.
+ *
+ ****************************************************************
+ */
+
+#ifndef SCREEN_VTPARSE_H
+#define SCREEN_VTPARSE_H
+
+#include <stdint.h>
+
+#include "ansi.h"
+
+/*
+ * Table driven dispatch for the WriteString state machine. Every input
+ * character falls into a class, and vtparse_table maps the parser state
+ * and that class to an action and the state to continue in. The new
+ * state is stored before the action runs, so actions that switch state
+ * themselves (StringStart, PrintStart, ...) override it.
+ */
+
+enum vt_class {
+	VTC_HIGH,		/* 0xa0 and up, including decoded UTF-8 */
+	VTC_NUL,		/* ^@ */
+	VTC_EXEC,		/* controls handled by Special() */
+	VTC_CTL,		/* other C0 controls */
+	VTC_ENQ,		/* ^E, kept in OSC strings */
+	VTC_ESC,		/* ^[ */
+	VTC_SP,			/* ' ' */
+	VTC_BANG,		/* '!' */
+	VTC_DQUOTE,		/* '"' */
+	VTC_INTER,		/* '#' - '/' */
+	VTC_DIGIT,		/* '0' - '9' but '4' */
+	VTC_FOUR,		/* '4' */
+	VTC_SEP,		/* ':' ';' */
+	VTC_PRIV,		/* '<' - '?' */
+	VTC_FINAL,		/* '@' - '~' not listed below */
+	VTC_P,			/* 'P' */
+	VTC_LBRACKET,		/* '[' */
+	VTC_BSLASH,		/* '\\' */
+	VTC_RBRACKET,		/* ']' */
+	VTC_CARET,		/* '^' */
+	VTC_UNDERSCORE,		/* '_' */
+	VTC_I,			/* 'i' */
+	VTC_K,			/* 'k' */
+	VTC_DEL,		/* 0x7f */
+	VTC_C1,			/* 0x80 - 0x9f but ST */
+	VTC_ST,			/* 0x9c */
+	VTC_MAX
+};
+
+enum vt_action {
+	VTA_NONE,		/* only change state */
+	VTA_PRINT,		/* put a graphic character */
+	VTA_EXEC,		/* execute a control */
+	VTA_REDO,		/* abort the sequence, retry in LIT */
+	VTA_ESCAPE,		/* start an escape sequence */
+	VTA_C1,			/* 8-bit control, or graphic if C1 is off */
+	VTA_ESCCOLLECT,		/* intermediate of an escape sequence */
+	VTA_ESCDISPATCH,	/* final of an escape sequence */
+	VTA_CSIENTRY,		/* start reading CSI arguments */
+	VTA_PARAM,		/* argument digit */
+	VTA_NEXTPARAM,		/* argument separator */
+	VTA_CSICOLLECT,		/* intermediate or private marker */
+	VTA_CSIDISPATCH,	/* final of a CSI sequence */
+	VTA_STRSTART,		/* start a control string */
+	VTA_STRPUT,		/* add to the control string */
+	VTA_STRCTL,		/* control in a string, ends an OSC */
+	VTA_STRST,		/* 8-bit ST, ends the string if C1 is on */
+	VTA_STREND,		/* ESC \ */
+	VTA_STRESC,		/* ESC in a string that did not end it */
+	VTA_PRINTPUT,		/* printer mode data */
+	VTA_PRINTREPLAY,	/* printer mode data that looked like CSI 4 i */
+	VTA_PRINTEND,		/* CSI 4 i */
+	VTA_MAX
+};
+
+#define VTA_BITS	5
+#define VTC_ROW		32	/* VTC_MAX rounded up, for cheap indexing */
+
+extern const uint8_t vtparse_class[256];
+extern const uint16_t vtparse_table[PRIN4 + 1][VTC_ROW];
+
+/* Table entry for character c (a byte or a decoded code point) in state. */
+static inline int vtparse(int state, int c)
+{
+	return vtparse_table[state][(unsigned int)c < 256 ? vtparse_class[c] : VTC_HIGH];
+}
+
+/*
+ * Intermediate of a CSI sequence once c is collected into it: the first
+ * character as it is, a private marker followed by an intermediate, as
+ * "?$" of DECRQM, as marker << 8 | c, and -1 for anything else.
+ */
+static inline int vtparse_collect(int intermediate, int c)
+{
+	if (!intermediate)
+		return c;
+	if (intermediate >= '<' && intermediate <= '?' && c >= ' ' && c <= '/')
+		return intermediate << 8 | c;
+	return -1;
+}
+
+#define VT_ACTION(e)	((e) & ((1 << VTA_BITS) - 1))
+#define VT_STATE(e)	((e) >> VTA_BITS)
+
+#endif /* SCREEN_VTPARSE_H */
@@ -45,6 +45,7 @@
 #include "fileio.h"
 #include "help.h"
 #include "input.h"
+#include "linepool.h"
 #include "mark.h"
 #include "misc.h"
 #include "process.h"
@@ -71,6 +72,7 @@ static void pseu_readev_fn(Event *, void *);
 static void pseu_writeev_fn(Event *, void *);
 static void win_silenceev_fn(Event *, void *);
 static void win_destroyev_fn(Event *, void *);
+static void win_syncev_fn(Event *, void *);
 
 static int OpenDevice(char **, int, int *, char **);
 static int ForkWindow(Window *, char **, char *);
@@ -139,8 +141,6 @@ struct NewWindow nwin_default = {
 
 struct NewWindow nwin_options;
 
-static int const_IOSIZE = IOSIZE;
-static int const_one = 1;
 
 void nwin_compose(struct NewWindow *def, struct NewWindow *new, struct NewWindow *res)
 {
@@ -211,6 +211,7 @@ static void WinProcess(char **bufpp, size_t *lenp)
 {
 	int l2 = 0, f, *ilen, l = *lenp, trunc;
 	char *ibuf;
+	Event *wev;
 
 	fore = (Window *)flayer->l_data;
 
@@ -250,11 +251,13 @@ static void WinProcess(char **bufpp, size_t *lenp)
 		ibuf = fore->w_pwin->p_inbuf;
 		ilen = &fore->w_pwin->p_inlen;
 		f = sizeof(fore->w_pwin->p_inbuf) - *ilen;
+		wev = &fore->w_pwin->p_writeev;
 	} else {
 		/* we send the user input to the window */
 		ibuf = fore->w_inbuf;
 		ilen = &fore->w_inlen;
 		f = sizeof(fore->w_inbuf) - *ilen;
+		wev = &fore->w_writeev;
 	}
 
 	if (l > f)
@@ -277,6 +280,7 @@ static void WinProcess(char **bufpp, size_t *lenp)
 		}
 #endif
 		*ilen += l2;
+		evunblock(wev);
 		*bufpp += l;
 		*lenp -= l;
 		return;
@@ -316,7 +320,7 @@ static void WinRedisplayLine(int y, int from, int to, int isblank)
 	if (from == 0 && y > 0 && fore->w_mlines[y - 1].image[fore->w_width] == 0)
 		LCDisplayLineWrap(&fore->w_layer, &fore->w_mlines[y], y, from, to, isblank);
 	else
-		LCDisplayLine(&fore->w_layer, &fore->w_mlines[y], y, from, to, isblank);
+		LCDisplayRow(&fore->w_layer, &fore->w_mlines[y], WinRowGen(fore, y), y, from, to, isblank);
 }
 
 static void WinClearLine(int y, int xs, int xe, int bce)
@@ -613,7 +617,7 @@ int MakeWindow(struct NewWindow *newwin)
 	p->w_readev.data = p->w_writeev.data = (char *)p;
 	p->w_readev.handler = win_readev_fn;
 	p->w_writeev.handler = win_writeev_fn;
-	p->w_writeev.condpos = &p->w_inlen;
+	evblock(&p->w_writeev);		/* nothing to write yet */
 	evenq(&p->w_readev);
 	evenq(&p->w_writeev);
 	p->w_paster.pa_slowev.type = EV_TIMEOUT;
@@ -629,6 +633,9 @@ int MakeWindow(struct NewWindow *newwin)
 	p->w_destroyev.type = EV_TIMEOUT;
 	p->w_destroyev.data = 0;
 	p->w_destroyev.handler = win_destroyev_fn;
+	p->w_syncev.type = EV_TIMEOUT;
+	p->w_syncev.data = (char *)p;
+	p->w_syncev.handler = win_syncev_fn;
 
 	SetForeWindow(p);
 	Activate(p->w_norefresh);
@@ -798,6 +805,7 @@ void FreeWindow(Window *window)
 	evdeq(&window->w_silenceev);
 	evdeq(&window->w_zombieev);
 	evdeq(&window->w_destroyev);
+	evdeq(&window->w_syncev);
 	FreePaster(&window->w_paster);
 	free((char *)window);
 }
@@ -1227,7 +1235,7 @@ int winexec(char **av)
 	pwin->p_readev.data = pwin->p_writeev.data = (char *)w;
 	pwin->p_readev.handler = pseu_readev_fn;
 	pwin->p_writeev.handler = pseu_writeev_fn;
-	pwin->p_writeev.condpos = &pwin->p_inlen;
+	evblock(&pwin->p_writeev);
 	if (pwin->p_fdpat & (F_PFRONT << F_PSHIFT * 2 | F_PFRONT << F_PSHIFT))
 		evenq(&pwin->p_readev);
 	evenq(&pwin->p_writeev);
@@ -1257,8 +1265,7 @@ void FreePseudowin(Window *w)
 		close(pwin->p_ptyfd);
 	evdeq(&pwin->p_readev);
 	evdeq(&pwin->p_writeev);
-	if (w->w_readev.condneg == &pwin->p_inlen)
-		w->w_readev.condpos = w->w_readev.condneg = 0;
+	evunblock(&w->w_readev);
 	evenq(&w->w_readev);
 	free((char *)pwin);
 	w->w_pwin = NULL;
@@ -1319,25 +1326,45 @@ static void paste_slowev_fn(Event *event, void *data)
 	}
 }
 
+/*
+ * The readers of a window block themselves when the window can't take
+ * more output, this lets them check again.
+ */
+void WakeWindow(Window *p)
+{
+	p->w_waitdisp = 0;
+	evunblock(&p->w_readev);
+	if (p->w_pwin)
+		evunblock(&p->w_pwin->p_readev);
+}
+
 static int muchpending(Window *p, Event *event)
 {
 	for (Canvas *cv = p->w_layer.l_cvlist; cv; cv = cv->c_lnext) {
 		display = cv->c_display;
 		if (D_status == STATUS_ON_WIN && !D_status_bell) {
 			/* wait 'til status is gone */
-			event->condpos = &const_one;
-			event->condneg = (int *)&D_status;
+			p->w_waitdisp = display;
+			D_waitwins = true;
+			evblock(event);
 			return 1;
 		}
 		if (D_blocked)
 			continue;
-		if (D_obufp - D_obuf > D_obufmax + D_blocked_fuzz) {
+		if (obuf_len(&D_obuf) > (size_t)(D_obufmax + D_blocked_fuzz)) {
+			if (D_framedrop && D_lagging) {
+				DropPending();
+				continue;
+			}
 			if (D_nonblock == 0) {
 				D_blocked = 1;
 				continue;
 			}
-			event->condpos = &D_obuffree;
-			event->condneg = &D_obuflenmax;
+			if (!timerisset(&D_waitstart))
+				GetTime(&D_waitstart);
+			p->w_waitdisp = display;
+			D_waitwins = true;
+			evblock(event);
 			if (D_nonblock > 0 && !D_blockedev.queued) {
 				SetTimeout(&D_blockedev, D_nonblock);
 				evenq(&D_blockedev);
@@ -1362,8 +1389,7 @@ static void win_readev_fn(Event *event, void *data)
 	if (wtop) {
 		size = IOSIZE - p->w_pwin->p_inlen;
 		if (size <= 0) {
-			event->condpos = &const_IOSIZE;
-			event->condneg = &p->w_pwin->p_inlen;
+			evblock(event);	/* until pseu_writeev_fn drained p_inbuf */
 			return;
 		}
 	}
@@ -1371,12 +1397,9 @@ static void win_readev_fn(Event *event, void *data)
 		return;
 	if (!p->w_zdisplay)
 		if (p->w_blocked) {
-			event->condpos = &const_one;
-			event->condneg = &p->w_blocked;
+			evblock(event);
 			return;
 		}
-	if (event->condpos)
-		event->condpos = event->condneg = 0;
 
 	if ((len = p->w_outlen)) {
 		p->w_outlen = 0;
@@ -1421,6 +1444,7 @@ static void win_readev_fn(Event *event, void *data)
 	if (wtop) {
 		memmove(p->w_pwin->p_inbuf + p->w_pwin->p_inlen, bp, len);
 		p->w_pwin->p_inlen += len;
+		evunblock(&p->w_pwin->p_writeev);
 	}
 
 	LayPause(&p->w_layer, 1);
@@ -1460,6 +1484,11 @@ static void win_writeev_fn(Event *event, void *data)
 
 		if ((p->w_inlen -= len))
 			memmove(p->w_inbuf, p->w_inbuf + len, p->w_inlen);
+		/* there is room again for whoever fills w_inbuf */
+		if (p->w_pwin)
+			evunblock(&p->w_pwin->p_readev);
+		if (p->w_zdisplay)
+			evunblock(&p->w_zdisplay->d_readev);
 	}
 	if (p->w_paster.pa_pastelen && !p->w_slowpaste) {
 		struct paster *pa = &p->w_paster;
@@ -1467,6 +1496,8 @@ static void win_writeev_fn(Event *event, void *data)
 		if (flayer)
 			DoProcess(p, &pa->pa_pasteptr, &pa->pa_pastelen, pa);
 	}
+	if (!p->w_inlen)
+		evblock(event);
 	return;
 }
 
@@ -1482,20 +1513,16 @@ static void pseu_readev_fn(Event *event, void *data)
 	if (ptow) {
 		size = IOSIZE - p->w_inlen;
 		if (size <= 0) {
-			event->condpos = &const_IOSIZE;
-			event->condneg = &p->w_inlen;
+			evblock(event);	/* until win_writeev_fn drained w_inbuf */
 			return;
 		}
 	}
 	if (p->w_layer.l_cvlist && muchpending(p, event))
 		return;
 	if (p->w_blocked) {
-		event->condpos = &const_one;
-		event->condneg = &p->w_blocked;
+		evblock(event);
 		return;
 	}
-	if (event->condpos)
-		event->condpos = event->condneg = 0;
 
 	if ((len = p->w_outlen)) {
 		p->w_outlen = 0;
@@ -1517,6 +1544,7 @@ static void pseu_readev_fn(Event *event, void *data)
 	if (ptow) {
 		memmove(p->w_inbuf + p->w_inlen, buf, len);
 		p->w_inlen += len;
+		evunblock(&p->w_writeev);
 	}
 	WriteString(p, buf, len);
 	return;
@@ -1528,12 +1556,15 @@ static void pseu_writeev_fn(Event *event, void *data)
 	struct pseudowin *pw = p->w_pwin;
 	int len;
 
-	if (pw->p_inlen == 0)
-		return;
-	if ((len = write(event->fd, pw->p_inbuf, pw->p_inlen)) <= 0)
-		len = pw->p_inlen;	/* dead pseudo */
-	if ((p->w_pwin->p_inlen -= len))
-		memmove(p->w_pwin->p_inbuf, p->w_pwin->p_inbuf + len, p->w_pwin->p_inlen);
+	if (pw->p_inlen) {
+		if ((len = write(event->fd, pw->p_inbuf, pw->p_inlen)) <= 0)
+			len = pw->p_inlen;	/* dead pseudo */
+		if ((p->w_pwin->p_inlen -= len))
+			memmove(p->w_pwin->p_inbuf, p->w_pwin->p_inbuf + len, p->w_pwin->p_inlen);
+		evunblock(&p->w_readev);
+	}
+	if (!pw->p_inlen)
+		evblock(event);
 }
 
 static void win_silenceev_fn(Event *event, void *data)
@@ -1566,6 +1597,36 @@ static void win_destroyev_fn(Event *event, void *data)
 	WindowDied(p, p->w_exitstatus, 1);
 }
 
+static void win_syncev_fn(Event *event, void *data)
+{
+	(void)data; /* unused */
+
+	WinSyncUpdate((Window *)event->data, false);
+}
+
+/*
+ * Start or end a synchronized update of p, DEC private mode 2026. While
+ * it lasts the displays only note what changes in p, and draw it in one
+ * go when it ends or after SYNCTIMEOUT at the latest.
+ */
+void WinSyncUpdate(Window *p, bool on)
+{
+	Display *olddisplay = display;
+
+	if (p->w_sync == on)
+		return;
+	p->w_sync = on;
+	if (on) {
+		SetTimeout(&p->w_syncev, SYNCTIMEOUT);
+		evenq(&p->w_syncev);
+		return;
+	}
+	evdeq(&p->w_syncev);
+	for (display = displays; display; display = display->d_next)
+		DisplayFrame();
+	display = olddisplay;
+}
+
 static int zmodem_parse(Window *p, char *bp, int len)
 {
 	char *b2 = bp;
@@ -1600,7 +1661,7 @@ static int zmodem_parse(Window *p, char *bp, int len)
 				if (i < len) {
 					zmodem_abort(p, 0);
 					D_blocked = 0;
-					D_readev.condpos = D_readev.condneg = 0;
+					evunblock(&D_readev);
 					while (len-- > 0)
 						AddChar(*bp++);
 					Flush(0);
@@ -1674,11 +1735,10 @@ static void zmodem_found(Window *p, int send, char *bp, int len)
 		ZmodemPage();
 		display = d;
 		evdeq(&D_blockedev);
-		D_readev.condpos = &const_IOSIZE;
-		D_readev.condneg = &p->w_inlen;
 		ClearAll();
 		GotoPos(0, 0);
 		SetRendition(&mchar_blank);
+		DisplayForget();
 		AddStr("Zmodem active\r\n\r\n");
 		AddStr(send ? "**\030B01" : "**\030B00");
 		while (len-- > 0)
@@ -1711,7 +1771,7 @@ void zmodem_abort(Window *p, Display *d)
 	if (d) {
 		display = d;
 		D_blocked = 0;
-		D_readev.condpos = D_readev.condneg = 0;
+		evunblock(&D_readev);
 		Activate(D_fore ? D_fore->w_norefresh : 0);
 	}
 	display = olddisplay;
@@ -1835,6 +1895,7 @@ void ResetWindow(Window *win)
 	win->w_revvid = 0;
 	win->w_mouse = 0;
 	win->w_bracketed = false;
+	WinSyncUpdate(win, false);
 	win->w_cursorstyle = 0;
 	win->w_curinv = 0;
 	win->w_curvvis = 0;
@@ -1853,3 +1914,77 @@ void ResetWindow(Window *win)
 	win->w_rend = mchar_null;
 	ResetCharsets(win);
 }
+
+/*
+ * Line y of the whole image of p, see WIN. The oldest w_histcold lines
+ * come from the packed history, those it has not been filled up to yet
+ * are blank. History rows are rewrapped first if the width changed since
+ * they were stored, without memory for that they are blank.
+ */
+struct mline *WinLine(Window *p, int y)
+{
+	struct mline *ml;
+
+	if (p->w_rewrap)
+		RewrapHistory(p);
+	if (y >= p->w_histcold) {
+		ml = &p->w_hlines[y - p->w_histcold];
+		if (y < p->w_histheight && p->w_rewrap && linepool_len(ml->image) != p->w_width + 1)
+			return &mline_blank;
+		return ml;
+	}
+	y -= p->w_histcold - p->w_cold.lines;
+	if (y < 0 || !(ml = histpack_line(&p->w_cold, y, p->w_width)))
+		return &mline_blank;
+	return ml;
+}
+
+static uint64_t rowgen;		/* the last row generation handed out */
+
+/* The content of the rows ys..ye of p changed. */
+void WinTouchRows(Window *p, int ys, int ye)
+{
+	if (!p->w_rowgen)
+		return;
+	if (ys < 0)
+		ys = 0;
+	if (ye >= p->w_height)
+		ye = p->w_height - 1;
+	for (int y = ys; y <= ye; y++)
+		p->w_rowgen[y] = ++rowgen;
+}
+
+/*
+ * The rows ys..ye of p moved up by n, down if n is negative. Rows keep
+ * their generation when moving, the ones coming in are new.
+ */
+void WinScrollRows(Window *p, int ys, int ye, int n)
+{
+	int len = ye - ys + 1;
+
+	if (!p->w_rowgen || n == 0)
+		return;
+	if (n >= len || -n >= len) {
+		WinTouchRows(p, ys, ye);
+		return;
+	}
+	if (n > 0) {
+		memmove(p->w_rowgen + ys, p->w_rowgen + ys + n, (len - n) * sizeof(uint64_t));
+		WinTouchRows(p, ye - n + 1, ye);
+	} else {
+		memmove(p->w_rowgen + ys - n, p->w_rowgen + ys, (len + n) * sizeof(uint64_t));
+		WinTouchRows(p, ys, ys - n - 1);
+	}
+}
+
+/*
+ * The generation of row y of p. It changes whenever the content of the
+ * row does and is never given to other content, so a display line drawn
+ * from it is still up to date as long as both keep theirs. 0 if unknown.
+ */
+uint64_t WinRowGen(Window *p, int y)
+{
+	if (!p->w_rowgen || y < 0 || y >= p->w_height)
+		return 0;
+	return p->w_rowgen[y];
+}
@@ -40,6 +40,7 @@
 #include "screen.h"
 #include "layer.h"
 #include "display.h"
+#include "histpack.h"
 
 struct NewWindow {
 	int	StartAt;	/* where to start the search for the slot */
@@ -119,6 +120,8 @@ struct pseudowin {
 
 
 /* definitions for wlocktype */
+#define SYNCTIMEOUT	500	/* ms a synchronized update may hold the displays */
+
 #define WLOCK_OFF	0	/* all in w_userbits can write */
 #define WLOCK_AUTO	1	/* who selects first, can write */
 #define WLOCK_ON	2	/* user writes even if deselected */
@@ -142,6 +145,7 @@ struct Window {
 	struct pseudowin *w_pwin;	/* ptr to pseudo */
 	Display *w_pdisplay;		/* display for printer relay */
 	Display *w_lastdisp;		/* where the last input was made */
+	Display *w_waitdisp;		/* display we wait for before reading */
 	uint16_t w_number;		/* window number */
 	Event w_readev;
 	Event w_writeev;
@@ -218,12 +222,18 @@ struct Window {
 	char	 w_xtermosc[4][MAXSTR];	/* special xterm/rxvt escapes */
 	int	 w_mouse;		/* mouse mode 0,9,1000 */
 	bool	 w_bracketed;		/* bracketed paste mode */
+	bool	 w_sync;		/* synchronized update, mode 2026 */
 	int	 w_cursorstyle;		/* cursor style */
 
 	int	 w_slowpaste;		/* do careful writes to the window */
-	int	 w_histheight;		/* all histbases are malloced with width * histheight */
-	int	 w_histidx;		/* 0 <= histidx < histheight; where we insert lines */
-	struct	 mline *w_hlines;	/* history buffer */
+	int	 w_histheight;		/* lines of history, w_histcold of them packed */
+	struct	 mline *w_hlines;	/* newest part of the history, oldest line first, w_mlines follow */
+	struct	 mline *w_rows;		/* the rows w_hlines and w_mlines move along */
+	int	 w_nrows;		/* number of rows allocated */
+	int	 w_histcold;		/* lines of history before w_hlines */
+	HistPack w_cold;		/* those of them that have been filled */
+	bool	 w_rewrap;		/* rows of w_hlines may be of another width, see WinLine */
+	uint64_t *w_rowgen;		/* generations of the w_mlines, see WinRowGen */
 	struct	 paster w_paster;	/* paste info */
 	pid_t	 w_pid;			/* process at the other end of ptyfd */
 	pid_t	 w_deadpid;		/* saved w_pid of a process that closed the ptyfd to us */
@@ -260,11 +270,17 @@ struct Window {
 		int    height;
 		int    histheight;
 		struct mline *hlines;
-		int    histidx;
+		struct mline *rows;
+		int    nrows;
+		int    histcold;
+		bool   rewrap;
+		HistPack cold;
+		uint64_t *rowgen;
 		struct cursor cursor;
 	} w_alt;
 
 	Event w_destroyev;		/* window destroy event */
+	Event w_syncev;			/* ends a synchronized update that takes too long */
 	int w_exitstatus;
 	bool w_miflag;
 };
@@ -304,11 +320,10 @@ struct Window {
  * WIN gives us a reference to line y of the *whole* image
  * where line 0 is the oldest line in our history.
  * y must be in whole image coordinate system, not in display.
+ * The oldest w_histcold lines come from the packed history.
  */
 
-#define WIN(y) ((y < fore->w_histheight) ? \
-      &fore->w_hlines[(fore->w_histidx + y) % fore->w_histheight] \
-    : &fore->w_mlines[y - fore->w_histheight])
+#define WIN(y) WinLine(fore, y)
 
 #define Layer2Window(l) ((Window *)(l)->l_bottom->l_data)
 
@@ -326,6 +341,12 @@ void  CloseDevice (Window *);
 void  zmodem_abort(Window *, Display *);
 void  WindowDied (Window *, int, int);
 void  ResetWindow (Window *);
+void  WakeWindow (Window *);
+struct mline *WinLine (Window *, int);
+void  WinTouchRows (Window *, int, int);
+void  WinScrollRows (Window *, int, int, int);
+uint64_t WinRowGen (Window *, int);
+void  WinSyncUpdate (Window *, bool);
 #ifndef HAVE_EXECVPE
 #include <unistd.h>
 #endif
@@ -546,7 +546,7 @@ char *MakeWinMsgEv(WinMsgBuf *winmsg, char *str, Window *win,
 		Panic(0, "%s", strnomem);
 
 	tick = 0;
-	gettimeofday(&now, NULL);
+	GetTime(&now);
 	for (char *s = str; *s; s++) {
 		if (*s != chesc) {
 			if ((chesc == '%') && (*s == '^')) {
@@ -658,12 +658,15 @@ char *MakeWinMsgEv(WinMsgBuf *winmsg, char *str, Window *win,
 		ev->timeout.tv_usec = 0;
 	}
 	if (ev && tick) {
-		now.tv_usec = 100000;
+		struct timeval wall;
+		int timo;
+		/* fire 100ms after the next wall clock tick */
+		gettimeofday(&wall, NULL);
 		if (tick == 1)
-			now.tv_sec++;
+			timo = 1000;
 		else
-			now.tv_sec += tick - (now.tv_sec % tick);
-		ev->timeout = now;
+			timo = (tick - wall.tv_sec % tick) * 1000;
+		SetTimeout(ev, timo + 100 - wall.tv_usec / 1000);
 	}
 
 	free(cond);